@@ -7,6 +7,10 @@
 #include "Class.h"
 #include "Character.h"
 #include "Game.h"
+#include "EntityHandle.h"
+
+class SnapshotWriter;
+class SnapshotReader;
 
 class PurchasableSlot
 {
@@ -135,7 +139,7 @@ class BaseManager
 	// the Owner Party is the party which created this base. This is generally the player's Party, although this may change in future.
 	std::vector<int> ownerPartyID;
 
-	int nextBaseID;
+	EntityAllocator baseIDs;
 
 	int shellGenerate(); // just creates all the internal structures for the next party, with nothing added in
 
@@ -170,6 +174,7 @@ public:
 	int GetBaseAt(int x, int y);
 	int GetBaseOwner(int baseID)
 	{
+		RCK_CHECK_ENTITY(baseIDs, baseID);
 		return ownerPartyID[baseID];
 	}
 
@@ -194,8 +199,8 @@ public:
 
 	std::string GetBaseType(int baseID);
 	
-	int GetBaseX(int baseID) { return baseXPos[baseID]; }
-	int GetBaseY(int baseID) { return baseYPos[baseID]; }
+	int GetBaseX(int baseID) { RCK_CHECK_ENTITY(baseIDs, baseID); return baseXPos[baseID]; }
+	int GetBaseY(int baseID) { RCK_CHECK_ENTITY(baseIDs, baseID); return baseYPos[baseID]; }
 	void SetBaseX(int baseID, int xpos) { baseXPos[baseID] = xpos; }
 	void SetBaseY(int baseID, int ypos) { baseYPos[baseID] = ypos; }
 
@@ -206,6 +211,11 @@ public:
 	
 	void DumpBase(int partyID);
 
+	// snapshot (see Snapshot.h)
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+
+	static constexpr const char* LogCategory = "Base Manager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 
 	bool TurnHandler(int entityID, double time);
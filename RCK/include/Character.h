@@ -4,9 +4,12 @@
 #include <jsoncons/json_type_traits_macros.hpp>
 #include <jsoncons_ext/csv/csv.hpp>
 #include <fstream>
+#include <list>
 #include "Class.h"
 #include "Game.h"
 #include "Conditions.h"
+#include "Symbols.h"
+#include "EntityHandle.h"
 
 // Characters in ACKS are defined by a wide variety of values, but a few of them are absolutely universal.
 // The universal ones include Hit Points, Hit Dice (which is determined in a variety of ways - level for levelled PCs/NPCs, or HD for monsters),
@@ -18,6 +21,8 @@
 
 class ACKSClass;
 class MortalEffect;
+class SnapshotWriter;
+class SnapshotReader;
 
 class Statistic
 {
@@ -155,6 +160,7 @@ const std::string CapabilityNames[] = {
 class CharacterManager
 {
 	std::map<std::string, int> CharacteristicTags;
+	std::vector<std::pair<SymbolID, int>> CharacteristicTagIDs; // same again by tag ID, for the tag cache
 
 	std::vector<int> AbilityBonuses;
 	std::vector<float> PrimeReqMultiplier; // the multiplier on bonus XP for prime requisites
@@ -162,7 +168,9 @@ class CharacterManager
 	
 	/***/
 
-	int nextCharacterIndex = 0;
+	// Characters are never removed at the moment (the dead stay on the books), so every ID here is live and the generations stay at 0.
+	// It's here so character IDs can be checked and held as handles like everything else.
+	EntityAllocator characterIDs;
 	// each Character ID has a vector of Characteristics, numbered based on the loaded data
 	std::vector<std::vector<int>> pcCharacteristics;
 	std::vector<int> pcClass;
@@ -172,7 +180,9 @@ class CharacterManager
 	std::vector<int> pcExperience;
 	std::vector<int> pcCurrentArmourClass;
 
-	std::vector<std::map<std::string, int>> pcCollectedTags;
+	std::vector<std::vector<int>> pcTagValues; // total for each tag, indexed by tag SymbolID. Tags interned after the last update read as 0.
+
+	std::vector<SymbolID> saveTags; // "Saves:<type>" for each SaveType
 
 	std::vector<std::string> pcName;
 
@@ -198,8 +208,15 @@ class CharacterManager
 	std::vector<unsigned long long> pcCapabilityFlags;
 
 	std::vector<std::vector<std::pair<int, int>>> pcConditions;
+	std::vector<ConditionMask> pcConditionMasks; // expanded (includes and all), rebuilt whenever pcConditions changes
 	std::vector<std::vector<MortalEffect*>> pcMortalWounds;
 
+	// movement cache. Load is kept up to date as items come and go; the class and speed are worked out when first asked for
+	// after anything that could change them. -1 means "work it out again" (load is -1 after a snapshot load, before the items are back)
+	std::vector<long long> pcLoadUnits;		// WEIGHT_UNITS_PER_STONE per stone
+	std::vector<int> pcEncumbranceClass;
+	std::vector<int> pcSpeed;
+
 	// LOADED DATA from Jsons
 
 	CharacteristicData cd;
@@ -214,6 +231,7 @@ class CharacterManager
 	void UpdateCapabilities(int characterID);
 
 	int GetEncumbranceClass(int characterID);
+	long long GetLoadUnits(int characterID);
 
 public:
 	CharacterManager(CharacteristicData& _cd) : cd(_cd)
@@ -225,7 +243,7 @@ public:
 
 		for (unsigned long long i=0; i < CAPABILITY_MAX; i++)
 		{
-			CapabilityLookup[CapabilityNames[i]] = 1ULL << i;
+			Symbols().Intern(CapabilityNames[i]);
 		}
 	}
 	
@@ -233,7 +251,7 @@ public:
 	static CharacterManager* LoadCharacteristics();
 
 	// accessors
-	std::string getCharacterName(int id) { return pcName[id]; }
+	std::string getCharacterName(int id) { RCK_CHECK_ENTITY(characterIDs, id); return pcName[id]; }
 	const ACKSClass* getCharacterClass(int id);
 
 	int getCharacterTotalHitPoints(int id) { return pcTotalHitPoints[id]; }
@@ -251,8 +269,7 @@ public:
 	bool getCharacterCapabilityFlag(int id, CapabilityFlags capability) { return pcCapabilityFlags[id] & capability; }
 	bool getCharacterCapabilityFlag(int id, std::string capabilityName)
 	{
-		unsigned long long c = CapabilityLookup[capabilityName];
-		return getCharacterCapabilityFlag(id, (CapabilityFlags)c);
+		return getCharacterCapabilityFlag(id, (CapabilityFlags)CapabilityFromName(capabilityName));
 	}
 
 	std::string getCharacterDomainAction(int id);
@@ -265,6 +282,7 @@ public:
 
 	bool getCharacterHasCondition(int id, int condition);
 	bool getCharacterHasCondition(int id, std::string condition);
+	void UpdateConditionMask(int id);
 
 	void setCharacterCurrentHitPoints(int id, int value) { pcCurrentHitPoints[id] = value; }
 
@@ -273,11 +291,20 @@ public:
 	int AbilityBonus(int characteristicValue);
 	int GetStatisticIndex(std::string name)
 	{
-		return StatisticLookup[name];
+		std::map<std::string, int>::const_iterator it = StatisticLookup.find(name);
+		return it != StatisticLookup.end() ? it->second : 0;
 	}
 
+	// the CapabilityFlags bit for a name from CapabilityNames, 0 if there isn't one
+	static unsigned long long CapabilityFromName(const std::string& name);
+
 	void UpdateTagCache(int characterID);
-	int getTagValue(int characterID, std::string tag);
+	int getTagValue(int characterID, SymbolID tag)
+	{
+		const std::vector<int>& tags = pcTagValues[characterID];
+		return tag >= 0 && tag < (SymbolID)tags.size() ? tags[tag] : 0;
+	}
+	int getTagValue(int characterID, std::string tag) { return getTagValue(characterID, Symbols().Find(tag)); }
 
 	// Generators
 	void BaseGenerate();
@@ -308,12 +335,21 @@ public:
 	int RemoveInventoryItem(int characterID, int inventoryID);		// returns item ID
 
 
-	std::list<int> GetInventory(int characterID)
+	const std::list<int>& GetInventory(int characterID)
 	{
 		return pcInventory[characterID];
 	}
 
+	// call when something that affects the load limits changes. For now that's only the load itself - conditions and mortal wounds
+	// don't change what a character can carry.
+	void InvalidateEncumbrance(int characterID)
+	{
+		pcEncumbranceClass[characterID] = -1;
+		pcSpeed[characterID] = -1;
+	}
+
 	int UpdateCurrentAttackValue(int characterID, bool missile);
+	int UpdateCurrentSaveValue(int characterID, int saveType);
 	int UpdateCurrentSaveValue(int characterID, std::string save);
 
 	// update and return current value
@@ -328,6 +364,8 @@ public:
 	int GetPlayerX(int characterID) { return pcXPos[characterID]; }
 	int GetPlayerY(int characterID) { return pcYPos[characterID]; }
 	int GetPlayerMap(int characterID) { return pcMapID[characterID]; }
+	int GetCharacterCount() { return (int)pcXPos.size(); }
+	bool CharacterExists(int id) { return characterIDs.IsLive(id); }
 	void SetPlayerX(int characterID, int xpos) { pcXPos[characterID] = xpos; }
 	void SetPlayerY(int characterID, int ypos) { pcYPos[characterID] = ypos; }
 	void SetPlayerMap(int characterID, int map) { pcMapID[characterID] = map; }
@@ -348,12 +386,15 @@ public:
 	void AddMortalEffect(int id, MortalEffect* effect);
 
 	std::map<std::string, int> behaviourLookup;
-	std::map<std::string, unsigned long long> CapabilityLookup;
 
 	int SelectBehaviour(int entityID);
 	void SetBehaviour(int entityID, int behaviourType);
 	void SetBehaviour(int entityID, std::string behaviour) { SetBehaviour(entityID, behaviourLookup[behaviour]); }
 
+	// snapshot (see Snapshot.h)
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+
 	void DumpCharacter(int characterID);
 	
 	std::string DumpProficiencyCache(int characterID);
@@ -361,10 +402,12 @@ public:
 	std::string DumpConditions(int characterID);
 	std::string DumpCapabilities(int characterID);
 
+	static constexpr const char* LogCategory = "CharacterManager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 
 	std::vector<int> GetCharactersOnMap(int mapID);
 	std::vector<int> GetTaggedCharactersOnMap(int mapID, std::string tag, bool value);
+	std::vector<int> GetConditionCharactersOnMap(int mapID, int condition, bool value);
 	std::vector<int> GetConditionCharactersOnMap(int mapID, std::string condition, bool value);
 
 	// system handlers
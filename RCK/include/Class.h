@@ -5,6 +5,7 @@
 #include <jsoncons_ext/csv/csv.hpp>
 #include <fstream>
 #include "Character.h"
+#include "Symbols.h"
 
 // ACKS Classes are rather fungible, being based upon a generation system taken from the Player's Handbook.
 // I've gone down the route of creating them distinctly for this RL. However, I've attempted to keep the data structures relatively flexible
@@ -16,6 +17,17 @@
 
 extern std::string saveTypes[];
 
+// same order as saveTypes
+enum SaveType
+{
+	SAVE_PETRIFICATION_PARALYSIS,
+	SAVE_POISON_DEATH,
+	SAVE_BLAST_BREATH,
+	SAVE_STAFFS_WANDS,
+	SAVE_SPELLS,
+	SAVE_MAX
+};
+
 class LevelledChartColumn
 {
 	std::string Name_;
@@ -97,7 +109,7 @@ public:
 	const std::vector<std::string> FightingStyles() const { return FightingStyles_; }
 
 	const std::vector<LevelledChartColumn> LevelledChartColumns() const { return LevelledChartColumns_;  }
-	const std::vector<LevelledAbility> LevelledAbilities() const { return LevelledAbilities_; }
+	const std::vector<LevelledAbility>& LevelledAbilities() const { return LevelledAbilities_; }
 
 	std::vector<int> LevelXPValues;
 	std::vector<std::string> LevelTitles;
@@ -106,7 +118,13 @@ public:
 
 	std::vector<int> PrimeReqIdx;
 	
-	std::map<std::string, std::vector<int>> LevelTagBonuses; // compiled list of tags per level
+	std::vector<std::pair<SymbolID, std::vector<int>>> LevelTagBonuses; // compiled list of tags per level
+
+	// resolved once the class is loaded
+	std::vector<SymbolID> LevelledAbilityTags;		// tag for each of LevelledAbilities
+	unsigned long long CapabilityFlags = 0;			// every "Capability:" levelled ability, as CapabilityFlags
+	int AttackProgressionIdx = -1;					// into the AdvancementStore
+	int SaveProgressionIdx = -1;
 };
 JSONCONS_ALL_GETTER_CTOR_TRAITS_DECL(ACKSClass, Name, LevelChart, AttackProgression, SaveProgression, SpellProgression, HitDie, PrimeRequisites, ArmourProficiencies, WeaponProficiencies, FightingStyles, LevelledChartColumns, LevelledAbilities)
 
@@ -126,9 +144,11 @@ class AdvancementStore
 {
 	
 public:
-	
-	std::map<std::string, std::map<std::string, std::vector<int>>> SaveLookup; // SaveType, then Class, then level
-	std::map<std::string, std::vector<int>> AttackBonusLookup; // Class, then Level
+	static const int MONSTER_PROGRESSION = 0; // first column of advancement.csv. Monsters attack by hit dice and have no save table of their own
+
+	std::vector<std::string> ProgressionNames; // from the header of advancement.csv
+	std::vector<std::vector<int>> AttackBonuses; // Progression, then Level
+	std::vector<std::vector<int>> Saves[SAVE_MAX]; // SaveType, then Progression, then level
 
 	AdvancementStore()
 	{
@@ -136,6 +156,14 @@ public:
 	}
 
 	void LoadAdvancementSets();
+
+	int GetProgressionIndex(const std::string& name) const; // -1 if there's no such progression
+
+	const std::vector<int>& GetAttackBonuses(int progression) const { return AttackBonuses[progression]; }
+	const std::vector<int>& GetSaves(int saveType, int progression) const { return Saves[saveType][progression]; }
+
+	// by name, for anything that isn't in a hurry. Unknown progressions get an empty table.
+	const std::vector<int>& GetAttackBonuses(const std::string& progression) const;
 };
 
 class ClassManager
@@ -4,8 +4,15 @@
 #include <jsoncons/json_type_traits_macros.hpp>
 #include <jsoncons_ext/csv/csv.hpp>
 #include <fstream>
+
+// A set of conditions, one bit per condition index. The data has nine, so 64 leaves plenty of room for spells.
+// Up here, ahead of the includes, because Character.h needs it and is pulled in through Class.h
+typedef unsigned long long ConditionMask;
+const int CONDITION_MASK_BITS = 64;
+
 #include "Class.h"
 #include "Game.h"
+#include "Symbols.h"
 
 // ACKS Conditions were rather loose in the core rules but specified and defined in AXIOMS 6 (What's Your Condition)
 // As well as granting buffs and penalties to various things, they also specify a range of capabilities that are allowed or disallowed by the condition
@@ -142,6 +149,10 @@ public:
 	const std::vector<SpecialPenalty> SpecialPenalties() {
 		return SpecialPenalties_;
 	}
+
+	// SpecialPenalties resolved at load: "Capability:" penalties become flags to take away, the rest are tag values
+	std::vector<std::pair<SymbolID, int>> PenaltyTags;
+	unsigned long long PenaltyCapabilities = 0;
 };
 
 JSONCONS_ALL_GETTER_CTOR_TRAITS_DECL(MortalEffect, Code, PlayerText, MonsterText, DoubleTo, SpecialPenalties)
@@ -223,6 +234,7 @@ public:
 		return mortalstore.GetRoll(severity, d6);
 	}
 
+	static constexpr const char* LogCategory = "Mortal Wound Manager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 };
 
@@ -246,6 +258,7 @@ class ConditionManager
 
 	std::map<std::string, int> NameLookup; // reverse name to index
 	std::vector<std::vector<int>> Includes;
+	std::vector<ConditionMask> Closures; // each condition's own bit plus everything it includes, all the way down
 	
 	// loaded data from JSONCons
 	ConditionData cd;
@@ -258,7 +271,15 @@ public:
 
 	static ConditionManager* LoadConditions();
 
-	int GetConditionIndex(std::string s) { return NameLookup[s]; }
+	// -1 if there's no such condition
+	int GetConditionIndex(const std::string& s) const
+	{
+		auto it = NameLookup.find(s);
+		return it == NameLookup.end() ? -1 : it->second;
+	}
+
+	// resolved at load, for the checks that happen every frame
+	int UnconsciousIndex = -1;
 
 	std::string GetNameFromIndex(int index) { return Names[index]; }
 
@@ -266,10 +287,19 @@ public:
 	// Unconscious includes Helpless, Blinded and Deafened
 	// Held includes Helpless
 	// We are checking to see if someone is Helpless, but the character will not automatically get the Helpless condition added, so we need a secondary lookup
-	// the Inclusions vec contains a list of every included condition, so we check the includes for every condition we know we have.
+	// The closure of the includes is worked out at load, so an entity just keeps the OR of the closures of what it holds (its
+	// expanded mask) and "are they Helpless" is a single AND against that.
 	bool HasCondition(std::vector<int>& conditions, int findVal);
 
+	static ConditionMask ConditionBit(int index) { return index < 0 || index >= CONDITION_MASK_BITS ? 0 : 1ULL << index; }
+	static bool MaskHasCondition(ConditionMask expanded, int index) { return (expanded & ConditionBit(index)) != 0; }
+
+	ConditionMask GetClosure(int index) const { return Closures[index]; }
+	ConditionMask ExpandConditions(const std::vector<int>& held) const;
+	ConditionMask ExpandConditions(const std::vector<std::pair<int, int>>& held) const; // the characters' (condition, time) list
+
 	std::string GetRecovery(int index) { return Recovery[index]; }
 
+	static constexpr const char* LogCategory = "Condition Manager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 };
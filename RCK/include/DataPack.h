@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <jsoncons/json.hpp>
+#include <jsoncons_ext/csv/csv.hpp>
+#include <jsoncons_ext/cbor/cbor.hpp>
+
+// Precompiled data pack.
+// Every launch StartGame reads the JSON and CSV files in RCK/scripts, and every one of them has to be tokenised and parsed before the
+// loaders can copy it into their Sets. The data compiler (-compile-data) does that parsing offline: it reads every data file once,
+// checks the cross references between them (class charts, advancement tables, statistic names), and writes the parsed documents
+// as CBOR into a single pack file. At startup the pack is read in one go and the loaders decode straight from it.
+//
+// Each entry remembers when its source was last modified. If a source file has been edited since the pack was built, the loaders
+// quietly use the text file instead, so editing the scripts without recompiling still works - it's just slower.
+// The pack uses the snapshot container (Snapshot.h) for the file itself.
+
+struct DataPackEntry
+{
+	int64_t sourceTime = -1;		// modified time of the source when the pack was built
+	std::vector<uint8_t> cbor;
+};
+
+class DataPack
+{
+	std::unordered_map<std::string, DataPackEntry> entries;
+	std::atomic<int> staleCount{ 0 };		// the loaders can run on several threads at once
+
+	// what the loaders use: the open pack's entry for filename, if it has an up to date one
+	static const std::vector<uint8_t>* FindLoaded(const std::string& filename);
+
+public:
+	static const uint32_t DATA_PACK_VERSION = 1;
+	static const char* DEFAULT_PACK;
+
+	bool Open(std::string filename);
+	size_t GetEntryCount() const { return entries.size(); }
+	int GetStaleCount() const { return staleCount; }
+
+	// the compiled document for source, or NULL if there isn't one or the source has been edited since the pack was built
+	const std::vector<uint8_t>* Find(const std::string& source);
+
+	// -1 if the file isn't there
+	static int64_t GetModifiedTime(const std::string& filename);
+
+	// offline: parse and check every data file and write the pack. Returns false (having logged why) if anything is broken.
+	static bool Compile(std::string packFilename);
+
+	// times StartGame from the text files and from the pack. Run with -benchmark-startup.
+	static void BenchmarkStartup(int repeats);
+
+	// these replace decode_json/decode_csv in the loaders: from the pack if it's there and fresh, otherwise from the text file
+	template<typename T>
+	static T LoadJson(const std::string& filename)
+	{
+		const std::vector<uint8_t>* compiled = FindLoaded(filename);
+		if (compiled != NULL)
+			return jsoncons::cbor::decode_cbor<T>(*compiled);
+
+		std::ifstream is(filename);
+		return jsoncons::decode_json<T>(is);
+	}
+
+	// false (and an empty table) if the file doesn't exist. header works like csv_options::assume_header - the first row becomes the keys for the rest.
+	static bool LoadCsv(const std::string& filename, bool header, jsoncons::ojson& out);
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "OutputLog.h"
+
+// Entity IDs and the handles that go with them.
+// The managers still hand out plain int IDs - they're indices into the managers' columns, and everything from the map grid to the
+// time list stores them. What this adds is somewhere for a manager to give IDs back: a released ID goes onto a free list and
+// the next entity created takes its slot, so the columns (and every scan over them) grow with the live population rather than with
+// everything that's ever existed.
+//
+// The catch with reusing IDs is that something holding on to an old one would quietly start pointing at the newcomer. So each slot
+// has a generation, bumped every time it's released, and an EntityHandle is an ID plus the generation it was taken at. Anything that
+// keeps a reference to an entity across turns (rather than just looking it up and using it) should keep a handle, and check it's
+// still valid before using it.
+//
+// In debug builds the managers also check IDs on the way in (RCK_CHECK_ENTITY), and log an error for one that's been released.
+
+struct EntityHandle
+{
+	int id = -1;
+	uint32_t generation = 0;
+
+	EntityHandle() { }
+	EntityHandle(int _id, uint32_t _generation) : id(_id), generation(_generation) { }
+
+	bool IsNull() const { return id < 0; }
+	bool operator==(const EntityHandle& other) const { return id == other.id && generation == other.generation; }
+	bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+};
+
+class EntityAllocator
+{
+	std::vector<uint32_t> generations;	// per slot, bumped on each release
+	std::vector<char> live;
+	std::deque<int> freeSlots;			// oldest release first, so a freed ID sits out as long as possible before it comes back
+	int reservedSlots = 0;
+	int liveCount = 0;
+
+public:
+	// IDs below reserved are never handed out (placeholders and the like)
+	explicit EntityAllocator(int reserved = 0) { Clear(reserved); }
+
+	int Allocate()
+	{
+		int id;
+		if (!freeSlots.empty())
+		{
+			id = freeSlots.front();
+			freeSlots.pop_front();
+		}
+		else
+		{
+			id = (int)generations.size();
+			generations.push_back(0);
+			live.push_back(0);
+		}
+		live[id] = 1;
+		liveCount++;
+		return id;
+	}
+
+	// false if the ID wasn't live
+	bool Release(int id)
+	{
+		if (!IsLive(id))
+			return false;
+		live[id] = 0;
+		generations[id]++;
+		freeSlots.push_back(id);
+		liveCount--;
+		return true;
+	}
+
+	bool IsLive(int id) const { return id >= 0 && id < (int)live.size() && live[id] != 0; }
+
+	// a null handle if the ID isn't live
+	EntityHandle GetHandle(int id) const { return IsLive(id) ? EntityHandle(id, generations[id]) : EntityHandle(); }
+	bool IsValid(const EntityHandle& h) const { return IsLive(h.id) && generations[h.id] == h.generation; }
+
+	// one past the highest ID ever handed out - what the columns need to be sized to
+	int GetCapacity() const { return (int)generations.size(); }
+	int GetLiveCount() const { return liveCount; }
+
+	void Clear(int reserved)
+	{
+		reservedSlots = reserved;
+		generations.assign(reserved, 0);
+		live.assign(reserved, 0);
+		freeSlots.clear();
+		liveCount = 0;
+	}
+
+	// logs (under the caller's category) and returns false if the ID isn't live. Used through RCK_CHECK_ENTITY.
+	bool Check(int id, const char* category, const char* function) const
+	{
+		if (IsLive(id))
+			return true;
+		std::string reason = (id >= reservedSlots && id < (int)live.size()) ? " has been released" : " was never handed out";
+		RCK_LOG_ERROR(category, std::string(function) + ": ID " + std::to_string(id) + reason);
+		return false;
+	}
+
+	// W and R are the snapshot writer/reader (Snapshot.h)
+	template<typename W>
+	void Save(W& w) const
+	{
+		w.Write(reservedSlots);
+		w.Write(generations);
+		w.Write(live);
+		w.Write(freeSlots);
+	}
+
+	template<typename R>
+	void Load(R& r)
+	{
+		r.Read(reservedSlots);
+		r.Read(generations);
+		r.Read(live);
+		r.Read(freeSlots);
+		liveCount = 0;
+		for (char l : live)
+			liveCount += l ? 1 : 0;
+	}
+};
+
+// for use inside the managers, like DEBUG_LOG - picks up the class's LogCategory. Compiled out of release builds.
+#ifdef NDEBUG
+#define RCK_CHECK_ENTITY(allocator, id) ((void)0)
+#else
+#define RCK_CHECK_ENTITY(allocator, id) ((void)(allocator).Check((id), LogCategory, __FUNCTION__))
+#endif
@@ -1,4 +1,5 @@
 #pragma once
+#include <memory>
 #include "Class.h"
 #include "Character.h"
 #include "Maps.h"
@@ -24,6 +25,10 @@ class ConditionManager;
 class MortalWoundManager;
 class PartyManager;
 class BaseManager;
+struct HeadlessSummary;
+class DataPack;
+class SessionJournal;
+class JobSystem;
 
 enum ManagerType
 {
@@ -130,7 +135,20 @@ class Game
 	std::vector<int> GetTargetedEntities();
 
 	void SpawnLevel(int mapID, int spawnPointX, int spawnPointY);
+	void LiftPartyOffMap(); // everyone SpawnLevel puts down, taken back off the current map
 	void QuitGame();
+
+	// running totals for the headless summary
+	int charactersFallen = 0;
+	int characterDeaths = 0;
+	int mobsFallen = 0;
+
+	bool HeadlessPlayerTurn(int playerMode, const std::string& script, size_t& scriptPosition);
+
+	SessionJournal* journal = nullptr; // set when recording (see Journal.h)
+	uint32_t randomSeed = 0;
+	int loaderThreads = 0;
+	int workerThreads = 0;
 	
 public:
 	Game()
@@ -142,6 +160,31 @@ public:
 	void ClearGame();
 	void CreateMenu();
 	void CreateTestGame();
+	bool CreateEncounter(std::string filename); // headless scenario from a JSON file (see Headless.h)
+
+	// runs the current game with no window until maxTurns player turns have passed or the fight is over
+	HeadlessSummary RunHeadless(int maxTurns, int playerMode, std::string script = "");
+
+	// replays a recorded session with no window, checking the state hash at every checkpoint. Returns false if it went out of step.
+	bool ReplayJournal(SessionJournal* replay);
+
+	// journal support. SeedRandom has to be called before StartGame so that everything random comes from the one seed.
+	void SeedRandom(uint32_t seed);
+	uint32_t GetRandomSeed() { return randomSeed; }
+
+	// threads StartGame loads the managers on. 0 = one per core, 1 = all on the calling thread
+	void SetLoaderThreads(int threads) { loaderThreads = threads; }
+	// threads in the job system (see JobSystem.h), same rule - 1 runs every job inline. Results don't depend on it, only the speed.
+	void SetWorkerThreads(int threads);
+	void SetJournal(SessionJournal* j) { journal = j; }
+	uint64_t StateHash();
+
+	// whole game state to/from a binary snapshot file (see Snapshot.h). Load after StartGame, since the loaded data isn't in the snapshot.
+	bool SaveSnapshot(std::string filename, bool compress = true);
+	bool LoadSnapshot(std::string filename);
+
+	// builds a world with entityCount monsters and times saving and loading it, raw and compressed. Run with -benchmark-snapshot.
+	void BenchmarkSnapshot(int entityCount);
 	
 	bool TargetHandler(int entityID, int returnCode);
 	void TriggerTargeting(int targetingMode, int returnManager, int returnCode, int range = -1, int size = 1, bool allies = false, bool enemies = false , std::vector<int>& targets = std::vector<int>());
@@ -156,6 +199,7 @@ public:
 	void UpdateLookText(int x, int y);
 	void AddActionLogText(std::string term, bool clear = false);
 
+	static constexpr const char* LogCategory = "Game"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 
 	void RenderCharacterSheet();
@@ -208,6 +252,9 @@ public:
 	MortalWoundManager* mMortalManager;
 	PartyManager* mPartyManager;
 	BaseManager* mBaseManager;
+
+	DataPack* mDataPack = nullptr;	// precompiled scripts, if there's a pack (see DataPack.h)
+	JobSystem* mJobs = nullptr;		// for anything that splits across the cores mid-game, created by StartGame
 	
 	TCODConsole* sampleConsole;
 
@@ -218,6 +265,7 @@ public:
 	TCODConsole* inventoryShot = nullptr;
 
 	TCODRandom* randomiser = TCODRandom::getInstance();
+	std::unique_ptr<TCODRandom> seededRandomiser;	// what randomiser points at once SeedRandom has been called
 };
 
 extern Game* gGame;
\ No newline at end of file
@@ -1,7 +1,11 @@
 #pragma once
 
-#include <list>
+#include <vector>
 #include "OutputLog.h"
+#include "SchedulerTrace.h"
+
+class SnapshotWriter;
+class SnapshotReader;
 /**
  * Time is the largest change we're making to the ACKS rules.
  * Since classic Roguelikes work on a system of moves more driven by impulse-movements rather than strict turn taking, concepts like Initiative do not make sense.
@@ -53,24 +57,84 @@ struct GameDateTime
 };
 
 
+// A single scheduled activation.
+// Times are stored as absolute game time (seconds since the TimeManager started), so nothing in the queue has to be touched when the clock moves.
+// The TimeManager converts them back into "time from now" when it hands them to the TurnHandlers.
+struct ScheduledEvent
+{
+	long double time;
+	int entity;
+	int manager;
+	unsigned long long sequence; // insertion order, so entities due at the same moment go in the order they were scheduled
+};
+
+class EventQueue
+{
+	// An indexed 4-ary min-heap. All of the events live in one contiguous array (no more walking three lists in lockstep),
+	// and the slot table tells us where any (manager, entity) pair currently sits so we can reschedule or remove it in O(log n).
+	// 4 children per node keeps the tree shallow and each set of siblings sits next to each other in memory, which is cheaper than a binary heap for sift-downs.
+
+	static const int ARITY = 4;
+
+	std::vector<ScheduledEvent> heap;
+	std::vector<std::vector<int>> slots; // slots[manager][entity] is the heap index of that entity, or -1 if it isn't scheduled
+	std::vector<int> scratch; // reused stack for CollectDue
+	unsigned long long nextSequence = 0;
+
+	bool Before(const ScheduledEvent& a, const ScheduledEvent& b) const
+	{
+		return a.time < b.time || (a.time == b.time && a.sequence < b.sequence);
+	}
+
+	int& Slot(int entityID, int manager);
+	void Place(int index, const ScheduledEvent& e);
+	void SiftUp(int index);
+	void SiftDown(int index);
+
+public:
+	// inserts the entity, or moves it if it's already scheduled
+	void Schedule(int entityID, int manager, long double time);
+	bool Remove(int entityID, int manager);
+	void Clear();
+
+	bool Contains(int entityID, int manager);
+	bool Empty() const { return heap.empty(); }
+	int Size() const { return (int)heap.size(); }
+
+	const ScheduledEvent& Top() const { return heap.front(); }
+	void Pop();
+
+	// every event due at or before the given time, in the order they should fire.
+	// The due events always form a subtree hanging off the root, so we only visit those (plus their immediate children) rather than the whole heap.
+	void CollectDue(long double time, std::vector<ScheduledEvent>& out);
+
+	// raw heap order - sort it if you need it in time order
+	const std::vector<ScheduledEvent>& Entries() const { return heap; }
+
+	// the heap goes out as-is (it's already in heap order), and the slot table is rebuilt from it on the way back in
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+};
+
 class TimeManager
 {
 	// The time manager maintains the lists of activity counts
-	// The primary table is a sorted queue of entity IDs, with the time until they next tick, sorted by time (ascending)
-	// When we advance time, we decrement the queue by the length of time of the lowest entity.
+	// The primary table is a priority queue of entity IDs, keyed by the (absolute) time they next tick.
+	// When we advance time we pull off everything due in the window, and the clock simply moves on - the queue never needs to be decremented.
 	// We store a "round" function for each entity (the player one returns the control to the user). This completes the current action and then decides on the entity's next move.
 
-	std::list<long double> times;
-	std::list<int> entities;
-	std::list<int> managers;
+	EventQueue schedule;
 
 	void EmplaceEntity(int entityID, int manager, long double time);
 
 	// In addition to the turn handling time management, we also need to handle larger-scale timing events.
 	// This is done primarily by the Managers. We count the standing time and inform all the Managers when important time periods pass: Rounds, Turns, Hours, Days, Weeks and Months.
 	long double masterTime;
-	
-	const bool debugMode = true;
+
+	// opt-in binary trace of everything the scheduler does (see SchedulerTrace.h). Costs one branch per event when it's off.
+	SchedulerTrace trace;
+
+	unsigned long long eventsFired = 0; // turns handed out since startup
 	
 public:
 	TimeManager();;
@@ -82,16 +146,34 @@ public:
 	void DeregisterEntities();
 	
 	void SetEntityTime(int entityID, int manager, long double time);
+	void DeregisterEntity(int entityID, int manager);
 
+	static constexpr const char* LogCategory = "TimeManager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 
 	void DumpTimeToLog(OutputLog* log);
 	void DumpTimeToFile(std::string filename);
 
+	bool EnableTrace(std::string filename);
+	// for a manager that's handed a batch of turns at once, to mark where each one starts and ends. time is relative to the start
+	// of the advance, the same as the TurnHandlers get it.
+	void TraceTurn(TraceEventType type, int manager, int entityID, long double time)
+	{
+		if (trace.IsOpen())
+			trace.Record(type, manager, entityID, masterTime, masterTime + time);
+	}
+
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+
 	long double GetRunningTime();
+	unsigned long long GetEventCount() { return eventsFired; }
 
 	GameDateTime GetCalendarTime();
 
+	// times schedule/reschedule/advance/remove on a standalone queue and prints the results. Run with -benchmark-scheduler.
+	static void BenchmarkScheduler(int entityCount);
+
 	static long double GetTimePeriodInSeconds(TIME_PERIOD period)
 	{
 		return time_periods[(int)period];
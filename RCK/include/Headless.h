@@ -0,0 +1,80 @@
+#pragma once
+#include <jsoncons/json.hpp>
+#include <jsoncons/json_type_traits_macros.hpp>
+#include <string>
+#include <vector>
+
+// Headless mode: runs the game logic with no window and no keyboard, as fast as it will go.
+// The managers load through Game::StartGame as normal, then a scenario is set up (the test game, or an encounter from a JSON file)
+// and the selected character is driven by a simple policy while the TimeManager runs everyone else's turns.
+// Run with -headless (see main.cpp for the options).
+
+enum HEADLESS_PLAYER
+{
+	HP_HUNT = 0,	// walk to the nearest hostile monster and hit it until nothing hostile is left standing
+	HP_IDLE,		// never act, just let the clock run (measures the AI on its own)
+	HP_SCRIPT,		// replay a string of moves: '0'-'7' are move directions (as MapManager::shift), '.' waits. Loops when it runs out.
+	HP_MAX
+};
+
+const std::string HeadlessPlayerNames[] = { "hunt", "idle", "script" };
+
+// one monster (or a group of identical monsters) placed by an encounter file
+class EncounterMonster
+{
+	std::string Template_;
+	int X_;
+	int Y_;
+	int Count_;		// more than one spreads them out around (X,Y)
+
+public:
+	EncounterMonster(const std::string& Template, const int X, const int Y, const int Count) : Template_(Template), X_(X), Y_(Y), Count_(Count)
+	{}
+
+	const std::string& Template() const { return Template_; }
+	const int X() const { return X_; }
+	const int Y() const { return Y_; }
+	const int Count() const { return Count_; }
+};
+JSONCONS_ALL_GETTER_CTOR_TRAITS_DECL(EncounterMonster, Template, X, Y, Count)
+
+// a single map with the test party dropped on it and some monsters to fight.
+// Layout uses the same text as Game::CreateTestGame: '.' ground, '#' wall, 'T' tree, and outdoor maps are offset hex rows.
+class EncounterDefinition
+{
+	std::string Name_;
+	bool Outdoor_;
+	std::vector<std::string> Layout_;
+	int SpawnX_;
+	int SpawnY_;
+	std::vector<EncounterMonster> Monsters_;
+
+public:
+	EncounterDefinition(const std::string& Name, const bool Outdoor, const std::vector<std::string>& Layout, const int SpawnX, const int SpawnY, const std::vector<EncounterMonster>& Monsters) :
+		Name_(Name), Outdoor_(Outdoor), Layout_(Layout), SpawnX_(SpawnX), SpawnY_(SpawnY), Monsters_(Monsters)
+	{}
+
+	const std::string& Name() const { return Name_; }
+	const bool Outdoor() const { return Outdoor_; }
+	const std::vector<std::string>& Layout() const { return Layout_; }
+	const int SpawnX() const { return SpawnX_; }
+	const int SpawnY() const { return SpawnY_; }
+	const std::vector<EncounterMonster>& Monsters() const { return Monsters_; }
+};
+JSONCONS_ALL_GETTER_CTOR_TRAITS_DECL(EncounterDefinition, Name, Outdoor, Layout, SpawnX, SpawnY, Monsters)
+
+// what happened during a headless run
+struct HeadlessSummary
+{
+	int turns = 0;						// player turns taken
+	long double gameTime = 0.0L;		// game seconds that passed
+	unsigned long long events = 0;		// turns the TimeManager handed out to everyone else
+	int charactersFallen = 0;
+	int characterDeaths = 0;
+	int mobsFallen = 0;
+	bool resolved = false;				// nothing hostile left standing (or the party went down)
+	double wallSeconds = 0.0;
+
+	double EventsPerSecond() const { return wallSeconds > 0.0 ? events / wallSeconds : 0.0; }
+	std::string ToString() const;
+};
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <bitset>
 #include <jsoncons/json.hpp>
 #include <jsoncons_ext/jsonpath/json_query.hpp>
 #include <jsoncons/json_type_traits_macros.hpp>
 #include "Class.h"
 #include "OutputLog.h"
+#include "EntityHandle.h"
+
+class SnapshotWriter;
+class SnapshotReader;
 
 // ACKS item manager
 // Items in ACKS are largely divided into gear (magical or otherwise) and loot (with goods as a subgroup of loot)
@@ -160,6 +165,50 @@ public:
 };
 JSONCONS_ALL_GETTER_CTOR_TRAITS_DECL(DecorationSet, Decorations)
 
+// Tags the engine itself looks for. They're registered first so their bit is fixed; the tags only the data uses get the bits after them at load.
+enum ItemTags
+{
+	ITEM_TAG_WEAPON,
+	ITEM_TAG_MISSILE,
+	ITEM_TAG_ARMOUR,
+	ITEM_TAG_SHIELD,
+	ITEM_TAG_ONE_HANDED,
+	ITEM_TAG_TWO_HANDED,
+	ITEM_TAG_LIGHT,
+	ITEM_TAG_GRAB,
+	ITEM_TAG_BOWS,
+	ITEM_TAG_CROSSBOWS,
+	ITEM_TAG_ENGINE_MAX
+};
+
+const std::string ItemTagNames[] = { "Weapon", "Missile", "Armour", "Shield", "One-Handed", "Two-Handed", "Light", "Grab", "Bows", "Crossbows" };
+
+// Weights as fixed point, in 1/720720ths of a stone. 720720 divides by everything from 1 to 16,
+// so sixths, eighths and sixteenths of a stone all add up exactly.
+const long long WEIGHT_UNITS_PER_STONE = 720720;
+
+// equipment.json uses 20-odd distinct tags, so this is plenty
+const int ITEM_TAG_BITS = 128;
+typedef std::bitset<ITEM_TAG_BITS> ItemTagMask;
+
+enum RANGES
+{
+	SHORT_RANGE = 0,
+	MEDIUM_RANGE,
+	LONG_RANGE,
+	RANGE_MAX
+};
+
+// Everything attack and AC resolution wants from an item, worked out once when the item is generated (or loaded)
+struct ItemProfile
+{
+	int ACBonus = 0;					// from the "AC|n" tag
+	int DamageDieOneHand = 6;			// d6, d4 for Light, d2 for Grab
+	int DamageDieTwoHands = 10;			// d10, d8 for One-Handed (bastard) weapons held in both. Bows and crossbows are d6 either way
+	bool HasRange = false;
+	int Range[RANGE_MAX] = { 0, 0, 0 };	// band limits, from ranges.csv
+};
+
 // generated item
 struct ItemSet
 {
@@ -172,16 +221,12 @@ struct ItemSet
 	std::vector<int> WeightDen;								// weight denominator
 	std::vector<int> WeightNum;								// weight numerator
 
-	int nextID = 800;
-	// int nextID = 0;
-};
+	// compiled from Tags - not saved, rebuilt on snapshot load
+	std::vector<ItemTagMask> TagMasks;
+	std::vector<ItemProfile> Profiles;
 
-enum RANGES
-{
-	SHORT_RANGE = 0,
-	MEDIUM_RANGE,
-	LONG_RANGE,
-	RANGE_MAX
+	// the first 800 IDs are never handed out.
+	EntityAllocator ids = EntityAllocator(800);
 };
 
 class ItemManager
@@ -195,21 +240,24 @@ class ItemManager
 	
 	std::map<std::string, int> reverseTemplateDictionary;
 	std::map<std::string, int> reverseDecorationDictionary;
-	
-	int getRangePenalty(std::string tag, int range);
+
+	std::map<std::string, int> tagLookup; // tag name to bit
+	std::vector<std::string> tagNames;
+
+	int RegisterTag(const std::string& tag);
+	void CompileItem(int id); // fills in TagMasks and Profiles from Tags
+	void ResizeColumns(); // to fit every ID the allocator has handed out
 
 public:
 	ItemManager(TemplateSet& _items, DecorationSet& _decorations, std::map<std::string, std::vector<int>> _ranges, std::vector<int> _rangePenalties) : itemTemplates(_items), decorations(_decorations), rangeDictionary(_ranges), rangePenalties(_rangePenalties)
 	{
 		
-		items.Visual.resize(items.nextID);
-		items.Name.resize(items.nextID);
-		items.ShortDescription.resize(items.nextID);
-		items.LongDescription.resize(items.nextID);
-		items.Value.resize(items.nextID);
-		items.Tags.resize(items.nextID);
-		items.WeightDen.resize(items.nextID);
-		items.WeightNum.resize(items.nextID);
+		ResizeColumns();
+
+		for (int i = 0; i < ITEM_TAG_ENGINE_MAX; i++)
+		{
+			RegisterTag(ItemTagNames[i]);
+		}
 	}
 
 	static ItemManager* LoadItemTemplates();
@@ -219,19 +267,33 @@ public:
 	int GenerateItemFromTemplate(std::string name);
 	int GenerateItemFromTemplate(int templateID);
 
+	bool ItemExists(int id) const { return items.ids.IsLive(id); }
+	int GetLiveItemCount() const { return items.ids.GetLiveCount(); }
+
 	int getRangePenalty(int id, int range);
 	int getMaxRange(int id);
 	
 	// accessors
-	std::string getName(int id) { return items.Name[id]; }
+	std::string getName(int id) { RCK_CHECK_ENTITY(items.ids, id); return items.Name[id]; }
 	std::string getVisual(int id) { return items.Visual[id]; }
 	std::string getShortDescription(int id) { return items.ShortDescription[id]; }
 	std::string getLongDescription(int id) { return items.LongDescription[id]; }
 	int getValue(int id) { return items.Value[id]; }
 	int getWeightDen(int id) { return items.WeightDen[id]; }
 	int getWeightNum(int id) { return items.WeightNum[id]; }
+	long long getWeightUnits(int id) { return items.WeightNum[id] * WEIGHT_UNITS_PER_STONE / items.WeightDen[id]; }
 	
-	bool hasTag(int id, std::string tag);
+	// -1 if no item template uses the tag
+	int GetTagIndex(const std::string& tag) const
+	{
+		auto it = tagLookup.find(tag);
+		return it == tagLookup.end() ? -1 : it->second;
+	}
+
+	bool hasTag(int id, int tag) const { return tag >= 0 && items.TagMasks[id].test(tag); }
+	bool hasTag(int id, std::string tag) const { return hasTag(id, GetTagIndex(tag)); }
+
+	const ItemProfile& getProfile(int id) const { RCK_CHECK_ENTITY(items.ids, id); return items.Profiles[id]; }
 
 	std::vector<std::string>& getTags(int id) { return items.Tags[id]; }
 	
@@ -239,5 +301,10 @@ public:
 	double getWeight(std::vector<int> items);
 	double getWeight(std::list<int> items);
 
+	// snapshot (see Snapshot.h)
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+
+	static constexpr const char* LogCategory = "ItemManager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 };
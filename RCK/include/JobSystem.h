@@ -0,0 +1,153 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Job system, owned by the Game (gGame->mJobs). Anything mid-game that wants to spread work over the cores - the mob decide phase,
+// distance field rebuilds, and whatever else turns up in the AI, map or generation code - goes through here rather than starting
+// threads of its own.
+//
+// There's a fixed set of workers, each with its own queue. A worker takes jobs off the back of its own queue (newest first, so
+// what it just split off is still warm in its cache) and when that's empty it steals from the front of someone else's. The thread
+// that created the system counts as worker 0: it has a queue too, and while it waits on a job it runs jobs rather than sitting idle.
+// Waiting inside a job does the same, so jobs can split themselves up further.
+//
+// With one thread the system is inline: Submit runs the job there and then, and ParallelFor runs its chunks in order on the caller.
+// Same jobs, same code, no threads - handy for debugging, and for checking that something gives the same answer with and without.
+//
+// Jobs run whenever and wherever, so they must only read shared state, or write to their own slot of an output array. Anything
+// that has to happen in a particular order (moves, attacks, the random number generator) belongs back on the main thread.
+// Submit and Wait are for the main thread and for jobs - from any other thread, Submit just runs the job there and then.
+// (The "main thread" is whichever created the system, as long as it didn't already belong to another one.)
+
+// Per-worker bump allocator for scratch space inside a job. Everything a job allocates is given back when it finishes, and the
+// memory is kept for the next job, so after the first few turns nothing in here ever calls new. Plain old data only - nothing
+// gets destructed.
+class ScratchArena
+{
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+	struct Block
+	{
+		std::unique_ptr<char[]> memory;
+		size_t size = 0;
+	};
+
+	std::vector<Block> blocks;
+	size_t block = 0;		// the block we're allocating from
+	size_t offset = 0;		// and how far into it
+
+public:
+	struct Marker
+	{
+		size_t block;
+		size_t offset;
+	};
+
+	void* Allocate(size_t bytes, size_t align);
+
+	template<typename T>
+	T* AllocateArray(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "ScratchArena never runs destructors");
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// everything allocated after the marker was taken is given back by Rewind
+	Marker GetMarker() const { return Marker{ block, offset }; }
+	void Rewind(const Marker& m) { block = m.block; offset = m.offset; }
+
+	size_t GetCapacity() const;
+};
+
+struct JobContext
+{
+	int worker;				// 0 is the thread that created the system
+	ScratchArena& scratch;	// the worker's own, rewound when the job finishes
+};
+
+// shared between a handle and the jobs it's waiting on
+struct JobState
+{
+	std::atomic<int> pending;
+	std::mutex lock;
+	std::exception_ptr firstError;	// from the first of the jobs to throw, rethrown by Wait
+
+	explicit JobState(int count) : pending(count) { }
+};
+
+// What Submit gives back, to Wait on. Copyable; a default-constructed one counts as done.
+class JobHandle
+{
+	friend class JobSystem;
+	std::shared_ptr<JobState> state;
+
+public:
+	bool IsDone() const { return !state || state->pending.load() == 0; }
+};
+
+class JobSystem
+{
+	struct Job
+	{
+		std::function<void(JobContext&)> run;
+		std::shared_ptr<JobState> state;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex lock;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues;	// one per thread, caller's included
+	std::vector<std::unique_ptr<ScratchArena>> arenas;	// the same
+	std::vector<std::thread> workers;
+
+	std::atomic<int> queued{ 0 };		// jobs sitting in any queue
+	std::mutex sleepLock;
+	std::condition_variable wake;		// idle workers wait on this for a job to turn up
+	bool stopping = false;
+
+	std::atomic<int> jobsRun{ 0 };
+	std::atomic<int> jobsStolen{ 0 };
+
+	void WorkerLoop(int worker);
+	void Push(int worker, Job job);
+	bool TakeJob(int worker, Job& out);
+	void RunJob(int worker, Job& job);
+	static void Execute(Job& job, JobContext& context);	// runs it, and counts it done even if it throws
+	int CurrentWorker() const;			// -1 for a thread that isn't one of ours
+
+public:
+	// threadCount 0 = one per core. 1 = inline, everything on the calling thread in the order it was asked for.
+	explicit JobSystem(int threadCount = 0);
+	~JobSystem();
+
+	// the calling thread counts as one
+	int GetThreadCount() const { return (int)workers.size() + 1; }
+	bool IsInline() const { return workers.empty(); }
+
+	JobHandle Submit(std::function<void(JobContext&)> run);
+
+	// runs other jobs until the handle's are done, so it's fine to call from inside a job. If any of them threw, the first exception
+	// is rethrown here once they've all finished.
+	void Wait(const JobHandle& handle);
+
+	// calls fn(begin, end, context) for chunks of at most grain indices until [0, count) is covered, then returns. The chunks run as jobs,
+	// so fn can Submit or ParallelFor further work of its own. An exception from fn comes out of here, after every chunk has finished.
+	void ParallelFor(int count, int grain, const std::function<void(int, int, JobContext&)>& fn);
+
+	int GetJobsRun() const { return jobsRun.load(); }
+	int GetJobsStolen() const { return jobsStolen.load(); }
+	// scratch memory held across all the workers
+	size_t GetScratchBytes() const;
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "libtcod.hpp"
+
+// Session journal.
+// Everything random in the game comes out of Game::randomiser, so if we know the seed and every key the player pressed (in order),
+// we can play the whole session again without a window and end up in exactly the same place. The journal records just that:
+// the seed up front, then one record per key press the game handled, tagged with the game time it was handled at.
+// Every so many keys it also writes a checkpoint holding a hash of the game state (Game::StateHash), so a replay can tell exactly
+// where it stopped matching the original run.
+//
+// Record with -record <file> (and optionally -seed <n>), replay with -replay <file>. Because a replay does the same work as the
+// original session every time, any recorded session doubles as a repeatable benchmark.
+
+enum JournalRecordType
+{
+	JOURNAL_KEY = 0,		// a key press, handed to MenuGameHandleKeyboard or MainGameHandleKeyboard
+	JOURNAL_CHECKPOINT,		// state hash after the given number of keys
+	JOURNAL_MAX
+};
+
+enum JournalKeyFlags
+{
+	JKF_PRESSED = 1,
+	JKF_LALT = 2,
+	JKF_LCTRL = 4,
+	JKF_LMETA = 8,
+	JKF_RALT = 16,
+	JKF_RCTRL = 32,
+	JKF_RMETA = 64,
+	JKF_SHIFT = 128
+};
+
+struct JournalRecord
+{
+	uint64_t keyIndex;		// number of keys handled before this one (for a checkpoint, the number handled so far)
+	uint64_t hash;			// checkpoint only
+	double gameTime;		// master time when the key was handled / checkpoint taken
+	int32_t vk;
+	int32_t c;
+	uint8_t type;
+	uint8_t flags;			// JournalKeyFlags
+	uint16_t reserved;
+	uint32_t reserved2;
+};
+
+struct JournalFileHeader
+{
+	char magic[8];			// "RCKJRNL\0"
+	uint32_t version;
+	uint32_t recordSize;
+	uint32_t seed;
+	uint32_t checkpointInterval;	// in keys
+};
+
+class SessionJournal
+{
+	std::fstream file;
+	JournalFileHeader header;
+	bool recording = false;
+	uint64_t keyCount = 0;
+
+public:
+	static const uint32_t JOURNAL_VERSION = 1;
+
+	~SessionJournal() { Close(); }
+
+	bool OpenForRecord(std::string filename, uint32_t seed, uint32_t checkpointInterval);
+	bool OpenForReplay(std::string filename);
+	void Close();
+
+	bool IsRecording() const { return recording && file.is_open(); }
+
+	uint32_t GetSeed() const { return header.seed; }
+	uint32_t GetCheckpointInterval() const { return header.checkpointInterval; }
+	uint64_t GetKeyCount() const { return keyCount; }
+
+	// call after the game has handled the key. Writes a checkpoint too if one is due.
+	void RecordKey(const TCOD_key_t& key, long double gameTime);
+	bool CheckpointDue() const { return header.checkpointInterval > 0 && keyCount > 0 && keyCount % header.checkpointInterval == 0; }
+	void RecordCheckpoint(uint64_t hash, long double gameTime);
+
+	// replay: the next record in the file, false at the end
+	bool ReadNext(JournalRecord& record);
+
+	static TCOD_key_t ToKey(const JournalRecord& record);
+};
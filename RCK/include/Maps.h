@@ -9,6 +9,7 @@
 #include <list>
 #include <queue>
 #include <string>
+#include <unordered_map>
 #include <jsoncons/json.hpp>
 #include <jsoncons_ext/jsonpath/json_query.hpp>
 #include <jsoncons/json_type_traits_macros.hpp>
@@ -16,6 +17,9 @@
 #include <fstream>
 #include "OutputLog.h"
 
+class SnapshotWriter;
+class SnapshotReader;
+
 // sample screen size
 #define SAMPLE_SCREEN_WIDTH 46
 #define SAMPLE_SCREEN_HEIGHT 20
@@ -67,6 +71,18 @@ enum LocalContentTypes
 	CONTENT_MAX
 };
 
+// movement cost multiplier for walking into a cell with that content (only matters where the cell is walkable at all)
+static unsigned char content_move_cost[CONTENT_MAX] =
+{
+	1,	// none
+	2,	// tree - undergrowth
+	1,	// rocks
+	1,	// wall
+	1,	// stairs
+	1,	// door
+	1	// zone
+};
+
 enum MapTypes
 {
 	MAP_DUNGEON = 0,	// 1 square = 5ft
@@ -129,7 +145,8 @@ enum Ortho_Movement
 	ORTHO_UPLEFT,
 	ORTHO_DOWNLEFT,
 	ORTHO_DOWNRIGHT,
-	ORTHO_UPRIGHT
+	ORTHO_UPRIGHT,
+	ORTHO_MAX
 };
 
 
@@ -231,6 +248,15 @@ struct RegionMap
 
 // ARRAY OF STRUCTS OF ARRAYS MOFO
 // (I'm breaking with the plan a little)
+// Occupancy handles pack the manager and entity ID into one int, so a cell can say who's standing in it without asking the managers.
+// 0 is an empty cell, so the manager is stored +1. That leaves 24 bits (16 million) for IDs.
+typedef unsigned int OccupantHandle;
+const OccupantHandle OCCUPANT_NONE = 0;
+
+inline OccupantHandle PackOccupant(int manager, int entityID) { return ((OccupantHandle)(manager + 1) << 24) | ((OccupantHandle)entityID & 0xFFFFFF); }
+inline int OccupantManager(OccupantHandle h) { return (int)(h >> 24) - 1; }
+inline int OccupantID(OccupantHandle h) { return (int)(h & 0xFFFFFF); }
+
 struct Map
 {
 	TCODMap* map = NULL;
@@ -241,6 +267,28 @@ struct Map
 	int width;
 	int height;
 
+	// bumped whenever walkability or transparency changes, so anything cached against the layout (paths etc) knows to throw it away
+	unsigned int version = 0;
+	// same again for items being dropped or picked up
+	unsigned int itemVersion = 0;
+
+	// flat copy of walkability and content cost for the pathfinders, so they don't have to go through TCODMap (or a callback) per edge.
+	// 0 is closed, anything else is the multiplier for stepping into the cell.
+	std::vector<unsigned char> walkCost;
+
+	void setProperties(int x, int y, bool transparent, bool walkable)
+	{
+		map->setProperties(x, y, transparent, walkable);
+		updateWalkCost(x, y);
+	}
+
+	void updateWalkCost(int x, int y)
+	{
+		int cell = y * width + x;
+		walkCost[cell] = map->isWalkable(x, y) ? content_move_cost[content[cell]] : 0;
+		version++;
+	}
+
 	// vectors of every cell
 	
 	std::vector<std::stack<int>> items;
@@ -256,6 +304,18 @@ struct Map
 	std::vector<int> mobs;						// monsters and non-fully-fleshed NPCS, ref to MobManager, position is stored there
 	std::vector<int> characters;				// characters uncontrolled by the player, ref to CharacterManager, position is stored there
 
+	// occupancy layer, so "who's in this square?" doesn't mean asking every mob and character on the map.
+	// Each cell holds the first thing that moved in. Anything else sharing it (unconscious bodies, stacked animals etc) goes in the overflow list for that cell,
+	// and gets promoted when the first one leaves. We also remember which cell each occupant is in, so moves don't depend on the managers' positions being current.
+	std::vector<OccupantHandle> occupancy;
+	std::unordered_map<int, std::vector<OccupantHandle>> occupancyOverflow;
+	std::unordered_map<OccupantHandle, int> occupantCells;
+
+	void placeOccupant(OccupantHandle h, int x, int y);
+	bool removeOccupant(OccupantHandle h);
+	int findOccupant(int x, int y, int manager);
+	void getOccupantsAt(int x, int y, std::vector<OccupantHandle>& out);
+
 	int getCharacterAt(int x, int y);
 	void setCharacter(int x, int y, int characterID);
 	int removeCharacter(int characterID);
@@ -274,13 +334,19 @@ struct Map
 	void setContent(int x, int y, int c)
 	{
 		content[y * width + x] = c;
+		updateWalkCost(x, y);
 	}
 
 	void addItem(int x, int y, int item)
 	{
 		items[y * width + x].push(item);
+		itemVersion++;
 	}
 
+	// the TCODMap goes out as a transparent/walkable flag per cell, and is rebuilt from that on load
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+
 	std::stack<int>* getItems(int x, int y)
 	{
 		return &items[y * width + x];
@@ -298,11 +364,17 @@ struct Map
 };
 
 
+class PathPlanner;
+class VisibilityService;
+
 class MapManager : public ITCODPathCallback
 {
-	RegionMap* regionMap;
+	RegionMap* regionMap = NULL;
 	std::vector<Map*> mapStore;
 
+	PathPlanner* pathPlanner;
+	VisibilityService* visibility;
+
 	std::vector<std::vector<std::vector<std::string>>> terrain_prefabs;
 	TerrainTypeSet terrainTypes;
 
@@ -315,6 +387,12 @@ public:
 	Map* getMap(int index);
 	RegionMap* getRegionMap();
 
+	// shared path planning for everything that walks around on local maps (see Pathing.h)
+	PathPlanner* getPathPlanner() { return pathPlanner; }
+
+	// per-observer FOV and line of sight (see Visibility.h)
+	VisibilityService* getVisibility() { return visibility; }
+
 	//builds a new map, adds it to the map store, returns the id (distinct for indoor and outdoor maps)
 	int createMap(bool outdoor);
 	
@@ -367,6 +445,13 @@ public:
 	// bounds checking
 	bool isOutOfBounds(int mapID, int x, int y);
 
+	// snapshot (see Snapshot.h). Loading throws away the path planner and visibility caches, since they were built against the old maps.
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+
+	// spawns a crowd of goblins on a big empty map and times spawning, occupancy lookups and moves. Run with -benchmark-occupancy.
+	static void BenchmarkOccupancy(int mobCount);
+
 	bool isInFOV(int sourceManager, int sourceID, int targetManager, int targetID, int range = 0);
 	std::vector<int> filterByFOV(int sourceManager, int sourceID, int targetManager, std::vector<int> targets, int range = 0);
 
@@ -375,5 +460,6 @@ public:
 	bool TargetHandler(int entityID, int returnCode);
 	bool TimeHandler(int rounds, int turns, int hours, int days, int weeks, int months);
 	
+	static constexpr const char* LogCategory = "MapManager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 };
@@ -6,6 +6,12 @@
 #include <fstream>
 #include "ItemTemplate.h"
 #include "OutputLog.h"
+#include "SoaTable.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+class DistanceField;
+class JobSystem;
 
 // "Mobs" refers to creatures (in creatures.json) and to "mob" used as the generic group noun for creature groups (in mobs.json).
 // Creature groups will be in here but are currently unimplemented
@@ -133,79 +139,138 @@ public:
 };
 JSONCONS_ALL_GETTER_CTOR_TRAITS_DECL(CreatureSet, CreatureTemplates)
 
-class Creature
+// Everything every creature of a kind shares, compiled from its CreatureTemplate when the monsters load.
+// Creatures refer to this by their CreatureType rather than carrying their own copy, so a thousand goblins share one set of names,
+// attacks and behaviours.
+struct CreatureProfile
 {
-	std::string Name_;		// the name of this particular monster (in this version and for most monsters generally, this is just a copy of the monster name)
-	std::string Visual_;
-	std::string SaveAs_;
-	std::string Alignment_;
+	std::string Name;
+	std::string Visual;
+	std::string SaveAs;
+	std::string Alignment;
+
+	int HitDie = 0;			// number of HD in this case, not the die type (that's always a d8)
+	int HitDieModifier = 0;
+	int ArmourClass = 0;
+	int Morale = 0;
+	int Movement = 0;
+	int XP = 0;
+
+	std::vector<AttackType> Attacks;
+	std::map<std::string, int> AttackLookup;			// attack name to index in Attacks
+	std::vector<std::vector<int>> AttackSequences;		// resolved to indices in Attacks
+
+	std::vector<std::string> Abilities;
+	std::vector<int> Behaviours;
+};
 
-	int HitDie_;			// number of HD in this case, not the die type (that's always a d8)
-	int HitPoints_;
-	int ArmourClass_;
-	int Morale_;
-	int Movement_;
-	int XP_;
+// Columns of the MobManager's monster table (see SoaTable.h). The hot ones come first - they're what the AI, the map scans and
+// combat read every turn. The cold ones are the per-monster lists, only looked at when something is dropped, dumped or inflicted.
+enum MobColumns
+{
+	MOB_TYPE,				// index of the template/profile
+	MOB_HIT_POINTS,
+	MOB_MAX_HIT_POINTS,		// what it was spawned with, as far as resting will heal it
+	MOB_ARMOUR_CLASS,		// copied from the profile at spawn, so spells and the like can change one monster's
+	MOB_MOVEMENT,			// ditto
+	MOB_FLAGS,				// MobFlags
+	MOB_CONDITION_MASK,		// Conditions expanded through their includes (a ConditionMask)
+	MOB_BEHAVIOUR,			// -1 means no behaviour currently set
+	MOB_MAP,				// -1 when not on a map
+	MOB_X,
+	MOB_Y,
+	MOB_TARGET_ID,
+	MOB_TARGET_MANAGER,
+
+	// cold
+	MOB_CONDITIONS,			// what's actually held, WHAT DO WE GOT YO
+	MOB_EQUIPPED,			// indexed as per character equipment, not including armour
+	MOB_HELD				// just a list of items. This is what is dropped when the creature is killed.
+};
 
-	int CreatureType_;	// use this to reference things like the creature name
+enum MobFlags
+{
+	MOB_FLAG_HOSTILE = 1
+};
 
-	std::map<std::string, AttackType> Attacks_;	// we feed this out into a lookup table
-	std::vector<std::vector<std::string>> AttackSequences_;
+typedef SoaTable<int, int, int, int, int, int, unsigned long long, int, int, int, int, int, int,
+	std::vector<int>, std::vector<int>, std::vector<int>> MonsterTable;
 
-	std::vector<std::string> Abilities_;
-	std::vector<int> Behaviours_;
+// How closely the mobs on a map are simulated. Only maps with a party on them need every mob taking its own turns - everywhere
+// else the mobs are taken out of the time list and moved about in bulk by MobManager::TimeHandler, one pass over the table each
+// time, however many maps and mobs there are. See MobManager::UpdateMapDetail.
+enum MapDetail
+{
+	DETAIL_FULL = 0,	// a party is here: full tactical turns
+	DETAIL_TURN,		// nobody here, but somebody was recently: wander a step every turn (10 minutes)
+	DETAIL_DAY			// nobody here for over a day: a day's wandering and healing at once
+};
 
-	std::vector<int> ItemsEquipped; // indexed as per character equipment, not including armour
-	// Why do we not track armour? Because Monsters don't (usually) have stats.
-	// As a result, the AC is listed directly - including AC bonuses from stats and any extras from the creature's nature.
-	std::vector<int> Held; // just a vector list of items. This is what is dropped when the creature is killed.
+class MobManager;
 
-	std::vector<int> Conditions; // WHAT DO WE GOT YO
-	
-	bool hostile;
+// The part of a mob's turn that can be worked out without changing anything, done for a whole batch of mobs at once (and in
+// parallel) before any of them act. See MobManager::TurnHandler(entities, time).
+struct MobDecision
+{
+	int mapID = -1;				// the map the mob was on when it decided
+	int targetID = -1;			// target picked this turn, -1 if it didn't need one or there was nobody in sight
+	int targetManager = -1;
 
-public:
-	Creature() { }
+	int fieldType = -1;			// the distance field the step below was taken on, -1 if there isn't one
+	int fieldRebuilds = 0;		// that field's rebuild count at the time, so the commit can tell if it has changed since
+	int fieldResult = 0;		// PathResult
+	int stepX = -1;
+	int stepY = -1;
+
+	bool operator==(const MobDecision& o) const
+	{
+		return mapID == o.mapID && targetID == o.targetID && targetManager == o.targetManager && fieldType == o.fieldType && fieldRebuilds == o.fieldRebuilds
+			&& fieldResult == o.fieldResult && stepX == o.stepX && stepY == o.stepY;
+	}
+};
 
-	std::string GetName() { return Name_; }
-	std::string GetVisual() { return Visual_; }
-	std::string GetSaveAs() { return SaveAs_; }
-	std::string GetAlignment() { return Alignment_; }
+// A single monster. This is only a handle - the monster itself is a row in the MobManager's table, and everything shared by its
+// kind comes from its profile - so it's cheap to pass around by value. It stays valid for as long as the monster does.
+// Why do we not track armour? Because Monsters don't (usually) have stats.
+// As a result, the AC is listed directly - including AC bonuses from stats and any extras from the creature's nature.
+class Creature
+{
+	MobManager* manager;
+	int id;
 
-	void SetName(std::string in) { Name_ = in; }
-	void SetVisual(std::string in) { Visual_ = in; }
-	void SetSaveAs(std::string in) { SaveAs_ = in; }
-	void SetAlignment(std::string in) { Alignment_ = in; }
+	const CreatureProfile& Profile() const;
 
-	int GetHitDie() { return HitDie_; }
-	int GetHitPoints() { return HitPoints_; }
-	int GetArmourClass() { return ArmourClass_; }
-	int GetMorale() { return Morale_; }
-	int GetMovement() { return Movement_; }
-	int GetXP() { return XP_; }
-	int GetCreatureType() { return CreatureType_; }
+public:
+	Creature(MobManager* owner, int monsterID) : manager(owner), id(monsterID) { }
 
-	void SetHitDie(int in) { HitDie_ = in; }
-	void SetHitPoints(int in) { HitPoints_ = in; }
-	void SetArmourClass(int in) { ArmourClass_ = in; }
-	void SetMorale(int in) { Morale_ = in; }
-	void SetMovement(int in) { Movement_ = in; }
-	void SetXP(int in) { XP_ = in; }
+	int GetID() const { return id; }
 
-	AttackType GetAttack(std::string in) { return Attacks_[in]; }
-	std::vector<std::string>& GetAbilities() { return Abilities_; }
-	std::vector<int>& GetBehaviours() { return Behaviours_; }
-	std::vector<std::vector<std::string>>& GetAttackSequences() { return AttackSequences_; }
+	const std::string& GetName() const { return Profile().Name; }
+	const std::string& GetVisual() const { return Profile().Visual; }
+	const std::string& GetSaveAs() const { return Profile().SaveAs; }
+	const std::string& GetAlignment() const { return Profile().Alignment; }
 
-	int GetEquippedInSlot(int slot) { return ItemsEquipped[slot]; }
+	int GetHitDie() const { return Profile().HitDie; }
+	int GetHitPoints() const;
+	int GetMaxHitPoints() const;
+	int GetArmourClass() const;
+	int GetMorale() const { return Profile().Morale; }
+	int GetMovement() const;
+	int GetXP() const { return Profile().XP; }
+	int GetCreatureType() const;
 
-	void AddAttack(std::string name, int damageDie, int damageBonus);
+	void SetHitPoints(int in);
 
-	//static Creature GenerateCreature(const CreatureTemplate& ct);
-	static Creature GenerateCreature(int templateIndex);
+	const AttackType& GetAttack(int index) const { return Profile().Attacks[index]; }
+	AttackType GetAttack(std::string in) const;
+	const std::vector<std::string>& GetAbilities() const { return Profile().Abilities; }
+	const std::vector<int>& GetBehaviours() const { return Profile().Behaviours; }
+	const std::vector<std::vector<int>>& GetAttackSequences() const { return Profile().AttackSequences; }
 
-	bool IsHostile() { return hostile; }
-	void SetHostile(bool isHostile) { hostile = isHostile; }
+	int GetEquippedInSlot(int slot);
+
+	bool IsHostile() const;
+	void SetHostile(bool isHostile);
 
 	int GetCleaveCount() { return 0; } // for testing
 
@@ -214,40 +279,69 @@ public:
 	int RemoveCondition(int condition);
 	int RemoveCondition(std::string condition);
 
-	bool HasCondition(int condition) { return std::find(Conditions.begin(), Conditions.end(), condition) != Conditions.end(); }
-	bool HasCondition(std::string condition);
+	bool HasCondition(int condition) const;
+	bool HasCondition(std::string condition) const;
+	unsigned long long GetConditionMask() const;
 
-	std::vector<int> GetConditions() { return Conditions; }
+	const std::vector<int>& GetConditions() const;
 
-	bool HasAbility(std::string ability)
+	bool HasAbility(const std::string& ability) const
 	{
-		return std::find(Abilities_.begin(), Abilities_.end(), ability) != Abilities_.end();
+		const std::vector<std::string>& abilities = Profile().Abilities;
+		return std::find(abilities.begin(), abilities.end(), ability) != abilities.end();
 	}
 
-	bool IsBlocking();
+	bool IsBlocking() const;
 };
 
 
 class MobManager
 {
 	CreatureSet creatureTemplateSet;
+	std::vector<CreatureProfile> creatureProfiles; // one per template, same order
 	std::map<const std::string, int> creatureNameLookup;
-	std::vector<Creature> Monsters_;
-	std::vector<int> mapIDs;
-
-	std::vector<int> targetID;
-	std::vector<int> targetManager;
+	// one row per monster, by monster ID. Row 0 is the empty placeholder, as maps init to 0.
+	MonsterTable monsters;
 
-	std::vector<TCODPath*> paths;
+	friend class Creature;
 
-	std::vector<int> mobXPos;
-	std::vector<int> mobYPos;
-	
-	std::vector<int> currentBehaviour; // -1 means no behaviour currently set
+	int AddRow(int templateIndex, int hitPoints, int flags);
 
-	int nextMonsterIndex = 1; // starting at 1 as maps init to 0
+	// decide phase state for one map, set up once per batch for every map that has a mob in the batch
+	struct DecideMap
+	{
+		int mapID = -1;
+		std::vector<int> candidates;			// conscious characters on the map, for picking targets
+		std::vector<DistanceField*> fields;		// by DistanceFieldType, brought up to date before the decide phase
+		std::vector<int> fieldRebuilds;
+	};
+	std::vector<DecideMap> decideMaps;
+	std::vector<int> decideMapSlot;				// by map ID, index into decideMaps or -1
+	std::vector<MobDecision> decisions;
+	std::vector<EntityHandle> fallen;			// waiting on ClearFallen
+
+	void PrepareDecisions(const std::vector<int>& entities);
+	void Decide(int entityID, MobDecision& d);		// reads only - safe to run for many mobs at once
+	void DecideAll(const std::vector<int>& entities, JobSystem* jobs);	// fills in decisions, spread over the jobs if there are any
+	bool CommitTurn(int entityID, double time, const MobDecision& d);
+	int StepOnField(const MobDecision& d, int fieldType, int mapID, int ox, int oy, int& nx, int& ny); // returns a PathResult
+	// where the mob's target stands, if it's on the mob's own map. If not, the target's dropped and it comes back false.
+	bool LocateTarget(int entityID, int& x, int& y);
+
+	static const int ABSTRACT_TURN_STEPS = 3;	// wander steps per turn on a DETAIL_TURN map
+	static const int ABSTRACT_DAY_STEPS = 12;	// and per day on a DETAIL_DAY one
+	static const int MAX_ABSTRACT_DAYS = 30;	// a longer gap than this is simulated as this many days
+
+	// level of detail (see MapDetail), by map ID. Maps not in here yet are full.
+	std::vector<int> mapDetail;
+	std::vector<double> mapDemotedAt;		// when the map's last party left
+	long long abstractTurn = 0;				// the last turn since the start of the game the abstract maps have been brought up to
+
+	void PromoteMap(int mapID);
+	void DemoteMap(int mapID);
+	void SimulateAbstract(int turns, int days);
+	bool AbstractWander(int entityID, int mapID);
 
-	
 public:
 	MobManager(CreatureSet& templates) : creatureTemplateSet(templates)
 	{
@@ -257,17 +351,29 @@ public:
 		{
 			behaviourLookup[MobBehaviourNames[i]] = i;
 		}
-		Creature c;
-		EmptyCreature(c);
+		AddRow(0, 0, 0);
 	}
 
-	void EmptyCreature(Creature c);
-
 	CreatureSet& CreatureTemplates() { return creatureTemplateSet; }
 
 	int GetTemplateIndex(std::string templateName);
+	const CreatureProfile& GetProfile(int templateIndex) const { return creatureProfiles[templateIndex]; }
+
+	Creature GetMonster(int monsterID) { RCK_CHECK_ENTITY(monsters.GetIDs(), monsterID); return Creature(this, monsterID); }
+	// monster IDs run from 1 to below this. Check MonsterExists - there can be gaps where monsters have been removed.
+	int GetMonsterCount() { return monsters.IdCapacity(); }
+	int GetLiveMonsterCount() { return monsters.Size() - 1; } // not counting the placeholder
+	bool MonsterExists(int monsterID) { return monsterID > 0 && monsters.Contains(monsterID); }
+
+	// the ID is handed out again after RemoveMonster - hold one of these to notice
+	EntityHandle GetMonsterHandle(int monsterID) { return monsters.GetHandle(monsterID); }
+	bool IsValid(const EntityHandle& h) { return h.id > 0 && monsters.IsValid(h); }
 
-	Creature& GetMonster(int monsterID) { return Monsters_[monsterID]; }
+	// takes the monster off its map, out of the time list and any party, clears anyone targeting it, and frees its ID
+	void RemoveMonster(int monsterID);
+	// a monster that's been knocked out. It's removed at the end of the current batch of monster turns, or when the party changes maps
+	void MarkFallen(int monsterID);
+	void ClearFallen();
 
 	double MoveTo(int entityID, int new_x, int new_y, int currentTime);
 
@@ -278,6 +384,12 @@ public:
 
 	int GetMobX(int entityID);
 	int GetMobY(int entityID);
+	int GetMobMap(int entityID) { return monsters.Get<MOB_MAP>(entityID); }
+
+	// works out which maps have a party on them, and moves the mobs on every other map to abstract simulation (or back again).
+	// Call it whenever someone arrives on or leaves a map.
+	void UpdateMapDetail();
+	int GetMapDetail(int mapID) { return mapID >= 0 && mapID < (int)mapDetail.size() ? mapDetail[mapID] : DETAIL_FULL; }
 	
 	// factory
 	static MobManager* LoadMobData();
@@ -297,14 +409,49 @@ public:
 	std::vector<int> GetAllEnemyMonstersOnMap(int mapID, bool partyId, bool liveOnly);
 	std::vector<int> GetAllMonstersInRange(int mapID, int centerX, int centerY, int range, bool hostileOnly = false, bool liveOnly = true);
 
+	// snapshot (see Snapshot.h)
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+
+	// approximate bytes held for the monsters: the table's columns and the lists in the cold ones. Profiles not included.
+	size_t GetMonsterMemory() const;
+
+	// spawns count creatures (off-map) and reports the memory they take. Run with -benchmark-creatures.
+	static void BenchmarkCreatureMemory(int count);
+
 	// dump
 	void DumpMob(int mobID);
 	std::string DumpConditions(int mobID);
 	
+	static constexpr const char* LogCategory = "MobManager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 
+	// times the decide phase for count goblins closing on a party split over two maps, on one thread and on the job system, and checks both come up
+	// with the same decisions. Run with -benchmark-mob-turns.
+	static void BenchmarkMobTurns(int count);
+
+	// runs an hour of game time with count goblins wandering over eight maps, first with every map simulated in full and then with
+	// everything but the one we're on abstract. Run with -benchmark-map-detail.
+	static void BenchmarkMapDetail(int count);
+
 	// handlers
 	bool TurnHandler(int entityID, double time);
+	// every mob due at the same moment in one go: the decide phase runs for all of them on the job system, from the state as it is
+	// before any of them move, then they act one at a time in ID order. So the outcome doesn't depend on the number of threads.
+	// Sorts entities into ID order. Stops early if a turn interrupts - handled is how many got their turn.
+	bool TurnHandler(std::vector<int>& entities, double time, int& handled);
 	bool TargetHandler(int entityID, int returnCode); // disambiguation: targeting system in the UI, not our pathing target
 	bool TimeHandler(int rounds, int turns, int hours, int days, int weeks, int months);
-};
\ No newline at end of file
+};
+
+inline const CreatureProfile& Creature::Profile() const { return manager->GetProfile(manager->monsters.Get<MOB_TYPE>(id)); }
+inline int Creature::GetCreatureType() const { return manager->monsters.Get<MOB_TYPE>(id); }
+inline int Creature::GetHitPoints() const { return manager->monsters.Get<MOB_HIT_POINTS>(id); }
+inline void Creature::SetHitPoints(int in) { manager->monsters.Get<MOB_HIT_POINTS>(id) = in; }
+inline int Creature::GetMaxHitPoints() const { return manager->monsters.Get<MOB_MAX_HIT_POINTS>(id); }
+inline int Creature::GetArmourClass() const { return manager->monsters.Get<MOB_ARMOUR_CLASS>(id); }
+inline int Creature::GetMovement() const { return manager->monsters.Get<MOB_MOVEMENT>(id); }
+inline int Creature::GetEquippedInSlot(int slot) { return manager->monsters.Get<MOB_EQUIPPED>(id)[slot]; }
+inline bool Creature::IsHostile() const { return (manager->monsters.Get<MOB_FLAGS>(id) & MOB_FLAG_HOSTILE) != 0; }
+inline unsigned long long Creature::GetConditionMask() const { return manager->monsters.Get<MOB_CONDITION_MASK>(id); }
+inline const std::vector<int>& Creature::GetConditions() const { return manager->monsters.Get<MOB_CONDITIONS>(id); }
@@ -3,22 +3,127 @@
 #include <iostream>
 #include <fstream>
 #include <ctime>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <map>
+
+// Log levels. Messages below the runtime level (globally, or per category) are skipped before the message is even built.
+// Messages below RCK_LOG_COMPILE_LEVEL are compiled out altogether - by default that strips Trace and Debug from release (NDEBUG) builds.
+// Define RCK_LOG_COMPILE_LEVEL yourself to override it, eg RCK_LOG_COMPILE_LEVEL=2 keeps Info and up in a debug build.
+enum LogLevel
+{
+	LOG_LEVEL_TRACE = 0,
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_NONE
+};
+
+#ifndef RCK_LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define RCK_LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#else
+#define RCK_LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+// The log used to write (and flush) straight to disk on every call, which put file I/O on the game thread for every debug line.
+// Now Log() only drops the message into a fixed-size ring buffer, and a background writer thread batches the ring out to the file.
+// The ring is lock-free (any thread can log), and bounded: if the writer falls behind and the ring fills up we drop the newest messages
+// rather than block or grow, and count them so the log says how much went missing.
 
 class OutputLog
 {
+	struct LogEntry
+	{
+		std::atomic<unsigned long long> sequence; // ring slot state - tells producers and the writer whose turn it is
+		std::string source;
+		std::string message;
+	};
+
 	std::ofstream outputFile;
 
 	std::time_t previousTime;
-	
+
+	// ring buffer. Capacity is always a power of two so we can mask instead of mod
+	std::vector<LogEntry> ring;
+	unsigned long long mask;
+	std::atomic<unsigned long long> enqueuePos;
+	std::atomic<unsigned long long> dequeuePos;
+	std::atomic<unsigned long long> writtenPos; // everything before this has reached the file
+
+	std::atomic<unsigned long long> droppedCount;
+	unsigned long long reportedDropped;
+
+	// writer thread
+	bool threaded;
+	std::thread writer;
+	std::atomic<bool> stopping;
+	std::atomic<bool> flushRequested;
+
+	LogLevel minimumLevel;
+	std::map<std::string, LogLevel> categoryLevels;
+
+	void WriterLoop();
+	bool TryDequeue(std::string& source, std::string& message);
+	int DrainBatch(std::string& batch); // returns number of messages written
+	void WriteLine(std::string& batch, const std::string& source, const std::string& message);
+
 public:
 	OutputLog();
 
-	OutputLog(std::string filename);
+	// threaded = false writes synchronously on the calling thread - only for short-lived logs where spinning up a writer would cost more than it saves
+	OutputLog(std::string filename, bool threaded = true, int capacity = 8192);
 
 	~OutputLog();
-	
+
 	void Log(std::string source, std::string message);
 
+	// runtime filtering. Set these up before the game starts - they aren't guarded against other threads changing them.
+	void SetLevel(LogLevel level) { minimumLevel = level; }
+	void SetCategoryLevel(std::string category, LogLevel level) { categoryLevels[category] = level; }
+
+	// "trace", "debug", "info", "warning", "error" or "none", for the command line. False if it's none of those.
+	static bool ParseLevel(const std::string& name, LogLevel& level);
+
+	bool IsEnabled(LogLevel level, const char* category) const
+	{
+		// no overrides is the usual case, so don't pay for the lookup
+		if (categoryLevels.empty())
+			return level >= minimumLevel;
+
+		std::map<std::string, LogLevel>::const_iterator it = categoryLevels.find(category);
+		return level >= (it != categoryLevels.end() ? it->second : minimumLevel);
+	}
+
+	// blocks until everything logged so far is on disk
+	void Flush();
+
+	unsigned long long GetDroppedCount() const { return droppedCount.load(std::memory_order_relaxed); }
+
+	// makes sure gLog gets written out when we exit normally, call std::terminate, or crash with a fatal signal
+	static void InstallExitHandlers();
 };
 
-extern OutputLog* gLog;
\ No newline at end of file
+extern OutputLog* gLog;
+
+// The message argument is only evaluated if the level is enabled, so "a" + b + std::to_string(c) costs nothing when it's switched off.
+#define RCK_LOG(level, category, message) \
+	do { \
+		if ((level) >= RCK_LOG_COMPILE_LEVEL && gLog != NULL && gLog->IsEnabled((level), (category))) \
+			gLog->Log((category), (message)); \
+	} while (0)
+
+#define RCK_LOG_TRACE(category, message) RCK_LOG(LOG_LEVEL_TRACE, category, message)
+#define RCK_LOG_DEBUG(category, message) RCK_LOG(LOG_LEVEL_DEBUG, category, message)
+#define RCK_LOG_INFO(category, message) RCK_LOG(LOG_LEVEL_INFO, category, message)
+#define RCK_LOG_WARNING(category, message) RCK_LOG(LOG_LEVEL_WARNING, category, message)
+#define RCK_LOG_ERROR(category, message) RCK_LOG(LOG_LEVEL_ERROR, category, message)
+
+// a result line for the console that also goes in the log at Info - what the benchmarks and the offline tools report with
+void ReportLine(const char* category, const char* format, ...);
+
+// for use inside the managers - picks up the class's LogCategory
+#define DEBUG_LOG(message) RCK_LOG_DEBUG(LogCategory, message)
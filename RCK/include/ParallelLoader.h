@@ -0,0 +1,45 @@
+#pragma once
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Runs a set of startup jobs (the manager loaders) on a handful of threads.
+// Each job lists the jobs it needs finished first - eg the classes look up statistic indices in the CharacterManager - and
+// is only started once they're all done. Everything else runs side by side. Run() doesn't return until every job has finished,
+// so whatever the jobs set up is safe to use on the calling thread afterwards.
+//
+// Each job is timed, and Report() lists them slowest first, so it's easy to see which data file is holding up startup.
+
+struct LoaderJob
+{
+	std::string name;
+	std::function<void()> run;
+	std::vector<int> dependsOn;		// job indices
+
+	// filled in by Run
+	double startMs = 0.0;			// from the start of Run
+	double durationMs = 0.0;
+	bool finished = false;
+};
+
+class ParallelLoader
+{
+	std::vector<LoaderJob> jobs;
+	double wallMs = 0.0;
+	int threadsUsed = 0;
+
+public:
+	// returns the job's index, for use in later dependsOn lists
+	int Add(std::string name, std::function<void()> run, std::vector<int> dependsOn = std::vector<int>());
+
+	// threadCount 0 = one per core. 1 runs everything on the calling thread, in dependency order.
+	// If a job throws, anything depending on it is skipped, the rest still finish, and then the first exception is rethrown here.
+	void Run(int threadCount = 0);
+
+	const std::vector<LoaderJob>& GetJobs() const { return jobs; }
+	double GetWallMs() const { return wallMs; }
+
+	// one line per job, slowest first, then the totals
+	std::vector<std::string> Report() const;
+};
@@ -7,6 +7,10 @@
 #include "Class.h"
 #include "Character.h"
 #include "Game.h"
+#include "EntityHandle.h"
+
+class SnapshotWriter;
+class SnapshotReader;
 
 class PartyManager
 {
@@ -41,15 +45,13 @@ class PartyManager
 	std::vector<int> totalSuppliesFood; // in mandays. 
 	// std::vector<int> totalSuppliesWater; // add this later
 
-	int nextPartyID; // at some point we should make this go back to inactive entries so it doesn't inflate forever
+	EntityAllocator partyIDs; // merged-away parties give their ID back, and the next new party reuses it
 
 	int shellGenerate(); // just creates all the internal structures for the next party, with nothing added in
 
 	std::vector<int> partyXPos;
 	std::vector<int> partyYPos;
 
-	std::vector<bool> active;
-
 public:
 	PartyManager();
 	~PartyManager();
@@ -75,6 +77,9 @@ public:
 
 	void RemoveCharacter(int partyID, int entityID);
 	void RemoveAnimal(int partyID, int entityID);
+	void RemoveAnimalFromAll(int mobID); // for when the monster itself is going away
+
+	bool PartyExists(int partyID) { return partyIDs.IsLive(partyID); }
 
 	void MergeParty(int fromID, int toID); // transfer all characters and destroy original party
 
@@ -83,9 +88,9 @@ public:
 	void TransferParty(int sourcePartyID, int destinationPartyID);
 
 	// Accessors
-	std::vector<int>& getPlayerCharacters(int partyID) { return playerCharacters[partyID]; }
-	std::vector<int>& getHenchmen(int partyID) { return henchmen[partyID]; }
-	std::vector<int>& getAnimals(int partyID) { return animals[partyID]; }
+	std::vector<int>& getPlayerCharacters(int partyID) { RCK_CHECK_ENTITY(partyIDs, partyID); return playerCharacters[partyID]; }
+	std::vector<int>& getHenchmen(int partyID) { RCK_CHECK_ENTITY(partyIDs, partyID); return henchmen[partyID]; }
+	std::vector<int>& getAnimals(int partyID) { RCK_CHECK_ENTITY(partyIDs, partyID); return animals[partyID]; }
 
 	bool IsInParty(int partyID, int managerType, int entityID);
 	bool IsAPC(int partyID, int entityID);
@@ -109,8 +114,13 @@ public:
 
 	void DumpParty(int partyID);
 
+	// snapshot (see Snapshot.h)
+	void SaveSnapshot(SnapshotWriter& w);
+	bool LoadSnapshot(SnapshotReader& r);
+
 	
 	
+	static constexpr const char* LogCategory = "Party Manager"; // used by DEBUG_LOG
 	void DebugLog(std::string message);
 
 	bool TurnHandler(int entityID, double time);
@@ -0,0 +1,145 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "libtcod.hpp"
+#include "Maps.h"
+
+// Flow fields: multi-source distance maps that lots of entities can share. Rather than every pursuer running its own search toward
+// the party, we build one field of "distance to the nearest party member" per map whenever the party moves, and each pursuer just
+// steps to its lowest neighbour.
+enum DistanceFieldType
+{
+	FIELD_PARTY = 0,	// nearest conscious character on the map
+	FIELD_PLAYER,		// the currently controlled character
+	FIELD_ITEMS,		// nearest cell with items on it
+	FIELD_MAX
+};
+
+// step costs, kept as integers so ortho diagonals can cost more than straights (3:2 is close enough to root 2)
+const int STEP_COST_STRAIGHT = 2;
+const int STEP_COST_DIAGONAL = 3;
+const int FIELD_UNREACHABLE = 0x7fffffff;
+
+enum PathResult
+{
+	PATH_ARRIVED = 0,	// already at the target, nothing to do
+	PATH_STEP,			// next step is in (x,y)
+	PATH_BLOCKED,		// no route to the target
+	PATH_WAITING		// there's a route, but everywhere closer is full of other mobs right now
+};
+
+// fills in the cells next to (x,y) that you can walk into, using hex adjacency outdoors and 8-way indoors. Returns how many there are.
+int GetWalkableNeighbours(Map* m, int x, int y, int* cells, int* costs);
+
+class DistanceField
+{
+	int mapID = -1;
+	unsigned int mapVersion = 0;
+	int width = 0;
+	std::vector<int> sources;			// cells the field was built from, sorted
+	std::vector<int> distance;			// per cell, FIELD_UNREACHABLE if there's no route to any source
+	std::vector<std::pair<int, int>> open;	// (distance, cell) heap, kept around so rebuilding doesn't allocate
+
+	int rebuilds = 0;
+
+	void Relax(Map* m);
+
+public:
+	unsigned int sourceVersion = 0;		// whatever the owner uses to tell if the sources might have changed (eg Map::itemVersion)
+
+	// brings the field up to date with the given sources (cells as y * width + x). Does nothing if neither they nor the map have changed,
+	// and only relaxes outward from the new ones if sources were added but none removed.
+	void Update(int mapID, Map* m, std::vector<int>& newSources);
+
+	int GetDistance(int x, int y);
+	const std::vector<int>& GetSources() { return sources; }
+
+	// picks the neighbour of (x,y) that is closest to a source, skipping cells with a mob in them so crowds flow around each other.
+	// Returns false if nothing is closer than where we are.
+	bool Descend(Map* m, int x, int y, int& nx, int& ny);
+
+	// NextStepOnField without bringing the field up to date first. Only reads the field and the map, so any number of threads
+	// can call it at once as long as nothing is moving.
+	PathResult NextStep(Map* m, int x, int y, int& nx, int& ny);
+
+	// number of times the field has been rebuilt or extended since startup
+	int GetRebuildCount() { return rebuilds; }
+};
+
+// Path planner, owned by the MapManager.
+// Mobs used to new up a TCODPath every turn and run a full A* from scratch (and never delete the old one). Instead, each map gets
+// one set of search buffers that get reused for every query on that map, and each entity keeps its last path as a list of
+// cells. Entities walk down their cached path until either the map changes (Map::version), the target wanders out of the corridor
+// around the cached destination, or the entity gets moved off the path by something else. Only then do we search again.
+// The search itself is our own A* over Map::walkCost, with proper hex adjacency outdoors - TCODPath only knows about 8-way grids,
+// so hex maps had to reject the wrong neighbours one virtual call at a time.
+
+class PathPlanner
+{
+	// how far (in cells) the target can move from where we planned to before we bother planning again
+	static const int CORRIDOR = 2;
+
+	// A* scratch space for one map. Cells are only valid if their stamp matches the current search, so we never have to clear them.
+	struct MapPathSlot
+	{
+		std::vector<int> cost;				// best cost found to the cell so far
+		std::vector<int> parent;			// where we came from
+		std::vector<unsigned int> seen;		// stamp of the search that last reached the cell
+		std::vector<unsigned int> closed;	// stamp of the search that last expanded the cell
+		std::vector<std::pair<int, int>> open;	// (cost + heuristic, cell) heap
+		unsigned int stamp = 0;
+	};
+
+	struct CachedPath
+	{
+		int mapID = -1;
+		unsigned int mapVersion = 0;
+		int targetX = -1;
+		int targetY = -1;
+		std::vector<int> steps;	// cells (y * width + x) from the first step to the destination
+		size_t next = 0;		// the step we last handed out
+		int lastCell = -1;		// where the entity was when we handed it out
+	};
+
+	MapManager* mapManager;
+	std::vector<MapPathSlot*> slots;	// indexed by map ID, created on first use
+	std::unordered_map<OccupantHandle, CachedPath> cache;
+	std::vector<DistanceField*> fields;	// indexed by map ID * FIELD_MAX + field type, created on first use
+
+	std::vector<int> sourceScratch;
+	std::vector<std::vector<int>> batchSources;	// one per map and field for UpdateFields
+
+	MapPathSlot* GetSlot(int mapID);
+	DistanceField* FieldSlot(int mapID, int fieldType);	// created on first use, not brought up to date
+	void GatherSources(int mapID, int fieldType, DistanceField* field, std::vector<int>& out);
+	bool Plan(CachedPath& p, int mapID, int ox, int oy, int tx, int ty);
+	bool Search(Map* m, MapPathSlot* slot, int origin, int target, std::vector<int>& steps);
+
+	int searches = 0;
+
+public:
+	PathPlanner(MapManager* mm) : mapManager(mm) {}
+	~PathPlanner();
+
+	// works out where the entity should step next to get from (ox,oy) to (tx,ty), re-using its cached path where we can
+	PathResult NextStep(int manager, int entityID, int mapID, int ox, int oy, int tx, int ty, int& nx, int& ny);
+
+	// drop the entity's cached path (they've given up, died, changed behaviour etc)
+	void Forget(int manager, int entityID);
+
+	// the shared distance field of that type for the map, brought up to date first
+	DistanceField* GetField(int mapID, int fieldType);
+
+	// brings the given fields on each of the maps up to date at once, rebuilding them side by side on the job system
+	void UpdateFields(const std::vector<int>& mapIDs, const std::vector<int>& fieldTypes);
+
+	// same idea as NextStep, but heading for the nearest source of a shared field rather than a particular spot
+	PathResult NextStepOnField(int mapID, int fieldType, int ox, int oy, int& nx, int& ny);
+
+	// number of actual searches run since startup
+	int GetSearchCount() { return searches; }
+
+	// chases a wandering target with a crowd of pursuers: fresh TCODPaths every turn, through the planner, and down a shared distance field.
+	// Run with -benchmark-pathing.
+	static void BenchmarkPathing(int pursuerCount, int mapType);
+};
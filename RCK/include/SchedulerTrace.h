@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// Scheduler trace recorder.
+// Rather than rewriting a text dump of the whole turn queue every time something is scheduled, the TimeManager can (optionally)
+// append a fixed-size binary record for each scheduler event into a memory-mapped ring file. Appending is a handful of stores,
+// there's no file open/close per turn, and the OS writes the pages out for us - so the file survives even if the game crashes.
+// When the ring fills up the oldest records are overwritten.
+//
+// The trace is read back offline with ConvertTrace (run the game with -convert-trace) into either plain text or Chrome's trace
+// JSON format (load it in chrome://tracing or Perfetto).
+
+enum TraceEventType
+{
+	TRACE_SCHEDULE = 0,		// entity put into (or moved within) the queue. eventTime is when it's due
+	TRACE_FIRE,				// TurnHandler called
+	TRACE_FIRE_END,			// TurnHandler returned
+	TRACE_INTERRUPT,		// TurnHandler asked us to stop advancing
+	TRACE_DEREGISTER,		// entity removed from the queue
+	TRACE_CLEAR,			// whole queue cleared (map change)
+	TRACE_ADVANCE,			// clock moved. eventTime is the new master time
+	TRACE_MAX
+};
+
+// Every record is the same size so the ring can be indexed directly
+struct TraceRecord
+{
+	uint64_t index;			// running record number, so we can find the oldest record once the ring has wrapped
+	uint64_t wallNanos;		// real time since the trace was opened
+	double gameTime;		// master time when the event was recorded
+	double eventTime;		// the time the event refers to (see TraceEventType)
+	int32_t entity;
+	int16_t manager;
+	uint8_t type;
+	uint8_t reserved;
+};
+
+struct TraceFileHeader
+{
+	char magic[8];			// "RCKTRACE"
+	uint32_t version;
+	uint32_t recordSize;
+	uint64_t capacity;		// in records
+	uint64_t nextIndex;		// total records ever written
+};
+
+class SchedulerTrace
+{
+	TraceFileHeader* header;
+	TraceRecord* records;
+
+	void* mappedView;
+	size_t mappedSize;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+
+	uint64_t startNanos;
+
+public:
+	static const uint32_t TRACE_VERSION = 1;
+
+	SchedulerTrace();
+	~SchedulerTrace();
+
+	bool Open(std::string filename, int capacity = 1 << 16);
+	void Close();
+
+	bool IsOpen() const { return header != NULL; }
+
+	void Record(TraceEventType type, int manager, int entity, long double gameTime, long double eventTime);
+
+	// reads a trace file back and writes it as text (chrome = false) or Chrome trace JSON (chrome = true)
+	static bool ConvertTrace(std::string inputFilename, std::string outputFilename, bool chrome);
+};
@@ -0,0 +1,346 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <stack>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Binary snapshots of the whole game state (save games, and a quick way to get a big world back for benchmarking).
+// The managers already keep everything in columns, so a snapshot is just every column written one after another:
+// a length, then the contents. Columns of plain values (ints, doubles, handles) go in as one block and come back out with a single
+// memcpy - only columns of strings/containers have to be walked element by element.
+// Each manager writes a section marker first, so if the layout of one manager changes and the snapshot is stale we find out at that
+// manager rather than reading garbage for the rest of the file.
+//
+// The file is a SnapshotFileHeader followed by the payload, which is optionally deflated with zlib.
+// Loaded data (templates, classes, conditions etc) isn't saved - that comes from the scripts as usual, so load a snapshot after StartGame.
+
+enum SnapshotFlags
+{
+	SNAPSHOT_COMPRESSED = 1
+};
+
+struct SnapshotFileHeader
+{
+	char magic[8];			// "RCKSNAP\0"
+	uint32_t version;
+	uint32_t flags;			// SnapshotFlags
+	uint64_t rawSize;		// payload size before compression
+	uint64_t storedSize;	// payload size in the file
+};
+
+// lets us get at the container underneath a std::stack, so stacks can be saved as one block too
+template<typename S>
+struct StackContainer : S
+{
+	static const typename S::container_type& Get(const S& s) { return s.*(&StackContainer::c); }
+	static typename S::container_type& Get(S& s) { return s.*(&StackContainer::c); }
+};
+
+class SnapshotWriter
+{
+	std::vector<char> buffer;
+
+public:
+	static const uint32_t SNAPSHOT_VERSION = 6;
+
+	void Bytes(const void* data, size_t size)
+	{
+		size_t at = buffer.size();
+		buffer.resize(at + size);
+		if (size > 0)
+			memcpy(&buffer[at], data, size);
+	}
+
+	// four character tag marking the start of a manager's state
+	void Section(const char* tag) { Bytes(tag, 4); }
+
+	template<typename T>
+	typename std::enable_if<std::is_trivially_copyable<T>::value>::type Write(const T& value)
+	{
+		Bytes(&value, sizeof(T));
+	}
+
+	void Write(const std::string& s)
+	{
+		Write((uint64_t)s.size());
+		Bytes(s.data(), s.size());
+	}
+
+	template<typename A, typename B>
+	void Write(const std::pair<A, B>& p)
+	{
+		Write(p.first);
+		Write(p.second);
+	}
+
+	template<typename T>
+	void Write(const std::vector<T>& v)
+	{
+		Write((uint64_t)v.size());
+		if (std::is_trivially_copyable<T>::value)
+		{
+			Bytes(v.data(), v.size() * sizeof(T));
+		}
+		else
+		{
+			for (const T& e : v)
+				Write(e);
+		}
+	}
+
+	void Write(const std::vector<bool>& v)
+	{
+		Write((uint64_t)v.size());
+		for (bool b : v)
+			Write((uint8_t)b);
+	}
+
+	template<typename T>
+	void Write(const std::list<T>& l)
+	{
+		Write((uint64_t)l.size());
+		for (const T& e : l)
+			Write(e);
+	}
+
+	template<typename T>
+	void Write(const std::deque<T>& d)
+	{
+		Write((uint64_t)d.size());
+		for (const T& e : d)
+			Write(e);
+	}
+
+	template<typename T>
+	void Write(const std::set<T>& s)
+	{
+		Write((uint64_t)s.size());
+		for (const T& e : s)
+			Write(e);
+	}
+
+	template<typename K, typename V>
+	void Write(const std::map<K, V>& m)
+	{
+		Write((uint64_t)m.size());
+		for (const auto& e : m)
+		{
+			Write(e.first);
+			Write(e.second);
+		}
+	}
+
+	template<typename K, typename V>
+	void Write(const std::unordered_map<K, V>& m)
+	{
+		Write((uint64_t)m.size());
+		for (const auto& e : m)
+		{
+			Write(e.first);
+			Write(e.second);
+		}
+	}
+
+	template<typename T>
+	void Write(const std::stack<T>& s)
+	{
+		Write(StackContainer<std::stack<T>>::Get(s));
+	}
+
+	size_t Size() const { return buffer.size(); }
+
+	// writes the header and payload. compress deflates the payload with zlib (smaller, a bit slower).
+	bool SaveToFile(std::string filename, bool compress);
+};
+
+class SnapshotReader
+{
+	std::vector<char> buffer;
+	size_t position = 0;
+	bool ok = true;
+
+	const char* Take(size_t size)
+	{
+		if (!ok || size > buffer.size() - position)
+		{
+			ok = false;
+			return NULL;
+		}
+		const char* p = buffer.data() + position;
+		position += size;
+		return p;
+	}
+
+	// guards against a corrupt length asking us to allocate the world
+	bool CountFits(uint64_t count, size_t elementSize)
+	{
+		if (!ok || (elementSize > 0 && count > (buffer.size() - position) / elementSize))
+		{
+			ok = false;
+			return false;
+		}
+		return true;
+	}
+
+public:
+	bool LoadFromFile(std::string filename);
+
+	bool Ok() const { return ok; }
+	bool AtEnd() const { return position == buffer.size(); }
+
+	void Bytes(void* data, size_t size)
+	{
+		const char* p = Take(size);
+		if (p != NULL && size > 0)
+			memcpy(data, p, size);
+	}
+
+	// false (and the reader marked bad) if the next section isn't the one we expected
+	bool Section(const char* tag)
+	{
+		const char* p = Take(4);
+		if (p == NULL || memcmp(p, tag, 4) != 0)
+			ok = false;
+		return ok;
+	}
+
+	template<typename T>
+	typename std::enable_if<std::is_trivially_copyable<T>::value>::type Read(T& value)
+	{
+		Bytes(&value, sizeof(T));
+	}
+
+	void Read(std::string& s)
+	{
+		uint64_t size = 0;
+		Read(size);
+		if (!CountFits(size, 1))
+			return;
+		s.assign(Take((size_t)size), (size_t)size);
+	}
+
+	template<typename A, typename B>
+	void Read(std::pair<A, B>& p)
+	{
+		Read(p.first);
+		Read(p.second);
+	}
+
+	template<typename T>
+	void Read(std::vector<T>& v)
+	{
+		uint64_t count = 0;
+		Read(count);
+		if (!CountFits(count, std::is_trivially_copyable<T>::value ? sizeof(T) : 1))
+			return;
+		v.resize((size_t)count);
+		if (std::is_trivially_copyable<T>::value)
+		{
+			Bytes(v.data(), v.size() * sizeof(T));
+		}
+		else
+		{
+			for (T& e : v)
+				Read(e);
+		}
+	}
+
+	void Read(std::vector<bool>& v)
+	{
+		uint64_t count = 0;
+		Read(count);
+		if (!CountFits(count, 1))
+			return;
+		v.resize((size_t)count);
+		for (size_t i = 0; i < v.size(); i++)
+		{
+			uint8_t b = 0;
+			Read(b);
+			v[i] = b != 0;
+		}
+	}
+
+	template<typename T>
+	void Read(std::list<T>& l)
+	{
+		uint64_t count = 0;
+		Read(count);
+		l.clear();
+		for (uint64_t i = 0; i < count && CountFits(count - i, 1); i++)
+		{
+			l.emplace_back();
+			Read(l.back());
+		}
+	}
+
+	template<typename T>
+	void Read(std::deque<T>& d)
+	{
+		uint64_t count = 0;
+		Read(count);
+		if (!CountFits(count, std::is_trivially_copyable<T>::value ? sizeof(T) : 1))
+			return;
+		d.resize((size_t)count);
+		for (T& e : d)
+			Read(e);
+	}
+
+	template<typename T>
+	void Read(std::set<T>& s)
+	{
+		uint64_t count = 0;
+		Read(count);
+		s.clear();
+		for (uint64_t i = 0; i < count && CountFits(count - i, 1); i++)
+		{
+			T e;
+			Read(e);
+			s.insert(e);
+		}
+	}
+
+	template<typename K, typename V>
+	void Read(std::map<K, V>& m)
+	{
+		uint64_t count = 0;
+		Read(count);
+		m.clear();
+		for (uint64_t i = 0; i < count && CountFits(count - i, 1); i++)
+		{
+			K key;
+			Read(key);
+			Read(m[key]);
+		}
+	}
+
+	template<typename K, typename V>
+	void Read(std::unordered_map<K, V>& m)
+	{
+		uint64_t count = 0;
+		Read(count);
+		m.clear();
+		if (!CountFits(count, 1))
+			return;
+		m.reserve((size_t)count);
+		for (uint64_t i = 0; i < count && ok; i++)
+		{
+			K key;
+			Read(key);
+			Read(m[key]);
+		}
+	}
+
+	template<typename T>
+	void Read(std::stack<T>& s)
+	{
+		Read(StackContainer<std::stack<T>>::Get(s));
+	}
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "EntityHandle.h"
+
+// Structure-of-arrays table. Each column is its own vector, so a loop that only looks at map and position streams through those
+// and nothing else - no dragging whole objects through the cache to read two ints out of each.
+//
+// Rows are reached through IDs, and an ID keeps pointing at the same entity however the rows move about. Removing an entity swaps
+// the last row into the hole, so the columns stay dense and a full scan never has to skip dead rows. Removed IDs are handed out again
+// (see EntityHandle.h) - keep a handle rather than the bare ID if you need to notice that.
+//
+// Columns are picked out by index, which reads best with an enum:
+//   enum { POS_X, POS_Y };
+//   SoaTable<int, int> positions;
+//   int id = positions.Add(3, 4);
+//   positions.Get<POS_X>(id) = 5;
+//   for (int x : positions.Column<POS_X>()) ...       (row order, use IdOf(row) to get back to the ID)
+
+template<typename... Ts>
+class SoaTable
+{
+	std::tuple<std::vector<Ts>...> columns;
+	EntityAllocator ids;
+	std::vector<int> idToRow;	// -1 once removed
+	std::vector<int> rowToId;
+
+	// C++14, so no fold expressions: expand each pack into a dummy array instead
+	template<size_t... I>
+	void PushRow(std::index_sequence<I...>, Ts&&... values)
+	{
+		int expand[] = { 0, (std::get<I>(columns).push_back(std::forward<Ts>(values)), 0)... };
+		(void)expand;
+	}
+
+	template<size_t... I>
+	void MoveRow(std::index_sequence<I...>, int from, int to)
+	{
+		int expand[] = { 0, (std::get<I>(columns)[to] = std::move(std::get<I>(columns)[from]), 0)... };
+		(void)expand;
+	}
+
+	template<size_t... I>
+	void PopRow(std::index_sequence<I...>)
+	{
+		int expand[] = { 0, (std::get<I>(columns).pop_back(), 0)... };
+		(void)expand;
+	}
+
+	template<typename F, size_t... I>
+	void ForEachColumn(std::index_sequence<I...>, F& f)
+	{
+		int expand[] = { 0, (f(std::get<I>(columns)), 0)... };
+		(void)expand;
+	}
+
+	typedef std::index_sequence_for<Ts...> AllColumns;
+
+public:
+	template<size_t C>
+	using ColumnType = typename std::tuple_element<C, std::tuple<Ts...>>::type;
+
+	// returns the new row's ID
+	int Add(Ts... values)
+	{
+		int id = ids.Allocate();
+		if (id >= (int)idToRow.size())
+			idToRow.resize(id + 1, -1);
+		idToRow[id] = (int)rowToId.size();
+		rowToId.push_back(id);
+		PushRow(AllColumns(), std::move(values)...);
+		return id;
+	}
+
+	// swap-remove: the last row moves into the removed one's place. False if the ID wasn't there.
+	bool Remove(int id)
+	{
+		int row = RowOf(id);
+		if (row < 0)
+			return false;
+
+		int last = (int)rowToId.size() - 1;
+		if (row != last)
+		{
+			MoveRow(AllColumns(), last, row);
+			rowToId[row] = rowToId[last];
+			idToRow[rowToId[row]] = row;
+		}
+		PopRow(AllColumns());
+		rowToId.pop_back();
+		idToRow[id] = -1;
+		ids.Release(id);
+		return true;
+	}
+
+	bool Contains(int id) const { return RowOf(id) >= 0; }
+	int RowOf(int id) const { return ids.IsLive(id) ? idToRow[id] : -1; }
+	int IdOf(int row) const { return rowToId[row]; }
+
+	EntityHandle GetHandle(int id) const { return ids.GetHandle(id); }
+	bool IsValid(const EntityHandle& h) const { return ids.IsValid(h); }
+	const EntityAllocator& GetIDs() const { return ids; }
+
+	int Size() const { return (int)rowToId.size(); }
+	// one past the highest ID handed out so far
+	int IdCapacity() const { return ids.GetCapacity(); }
+
+	// whole columns, in row order
+	template<size_t C>
+	std::vector<ColumnType<C>>& Column() { return std::get<C>(columns); }
+	template<size_t C>
+	const std::vector<ColumnType<C>>& Column() const { return std::get<C>(columns); }
+
+	// one cell, by ID. The ID has to be live - debug builds stop here if it isn't.
+	template<size_t C>
+	ColumnType<C>& Get(int id) { assert(ids.IsLive(id)); return std::get<C>(columns)[RowOf(id)]; }
+	template<size_t C>
+	const ColumnType<C>& Get(int id) const { assert(ids.IsLive(id)); return std::get<C>(columns)[RowOf(id)]; }
+
+	void Reserve(size_t rows)
+	{
+		idToRow.reserve(rows);
+		rowToId.reserve(rows);
+		auto reserve = [rows](auto& column) { column.reserve(rows); };
+		ForEachColumn(AllColumns(), reserve);
+	}
+
+	void Clear()
+	{
+		ids.Clear(0);
+		idToRow.clear();
+		rowToId.clear();
+		auto clear = [](auto& column) { column.clear(); };
+		ForEachColumn(AllColumns(), clear);
+	}
+
+	// bytes held by the columns and the ID index, not counting anything the cells themselves own
+	size_t GetColumnBytes() const
+	{
+		size_t total = (idToRow.capacity() + rowToId.capacity()) * sizeof(int);
+		auto add = [&total](const auto& column) { total += column.capacity() * sizeof(column[0]); };
+		const_cast<SoaTable*>(this)->ForEachColumn(AllColumns(), add);
+		return total;
+	}
+
+	// W and R are the snapshot writer/reader (Snapshot.h), or anything else with Write/Read overloads for vectors
+	template<typename W>
+	void Save(W& w)
+	{
+		ids.Save(w);
+		w.Write(idToRow);
+		w.Write(rowToId);
+		auto write = [&w](const auto& column) { w.Write(column); };
+		ForEachColumn(AllColumns(), write);
+	}
+
+	template<typename R>
+	void Load(R& r)
+	{
+		ids.Load(r);
+		r.Read(idToRow);
+		r.Read(rowToId);
+		auto read = [&r](auto& column) { r.Read(column); };
+		ForEachColumn(AllColumns(), read);
+	}
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Interned names.
+// Tags ("Attack:Melee", "Saves:Spells", "Healing:MortalWound:Bonus"...), statistics, capabilities and class names all arrive from the
+// data files as strings. Rather than hash those strings every time the rules want a value, each distinct name gets a small dense
+// number the first time it's seen - normally while the data is loading - and the rules index flat arrays with that instead.
+// The string-taking functions are still around for the UI and scripts, they just look the name up once and carry on with the ID.
+//
+// IDs are only good for this run (the loaders intern in parallel, so the order varies), so anything saved to disk uses the names.
+
+typedef int SymbolID;
+const SymbolID SYMBOL_NONE = -1;
+
+class SymbolTable
+{
+	mutable std::mutex lock; // the loaders intern from several threads at once
+	std::unordered_map<std::string, SymbolID> ids;
+	std::vector<std::string> names;
+
+public:
+	// the name's ID, adding it if it's new
+	SymbolID Intern(const std::string& name);
+	// SYMBOL_NONE if the name has never been interned (so nothing can have a value for it)
+	SymbolID Find(const std::string& name) const;
+
+	std::string GetName(SymbolID id) const;
+	int Count() const;
+};
+
+// the one table everything shares
+SymbolTable& Symbols();
+
+// names the rules refer to directly, so the hot paths never have to look them up
+extern const SymbolID TAG_ATTACK_MELEE;
+extern const SymbolID TAG_ATTACK_MISSILE;
+extern const SymbolID TAG_DAMAGE_MELEE;
+extern const SymbolID TAG_DAMAGE_MISSILE;
+extern const SymbolID TAG_DEFENCE_AC;
+extern const SymbolID TAG_HEALING_MORTAL_WOUND_BONUS;
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "libtcod.hpp"
+#include "Maps.h"
+
+// Visibility service, owned by the MapManager.
+// Every observer (mob or character) gets its own field of view, kept as a bitset and only recomputed when the observer moves, asks for
+// a different range, or the map layout changes (Map::version). The FOV is worked out on a scratch copy of the map, so the player's
+// FOV on Map::map - the one the renderer uses - is left alone.
+// For "can A see B?" there's also a straight line-of-sight check, which is a lot cheaper than a whole FOV for a single target.
+
+class VisibilityService
+{
+	struct ObserverFOV
+	{
+		int mapID = -1;
+		unsigned int mapVersion = 0;
+		int x = -1;
+		int y = -1;
+		int range = -1;
+		std::vector<uint64_t> bits;		// one bit per cell, y * width + x
+	};
+
+	struct ScratchMap
+	{
+		TCODMap* map = NULL;
+		unsigned int version = 0;
+	};
+
+	MapManager* mapManager;
+	std::unordered_map<OccupantHandle, ObserverFOV> observers;
+	std::vector<ScratchMap> scratch;	// indexed by map ID
+
+	int computes = 0;
+
+	TCODMap* GetScratchMap(int mapID);
+
+public:
+	VisibilityService(MapManager* mm) : mapManager(mm) {}
+	~VisibilityService();
+
+	// can the observer standing at (x,y) see (tx,ty)? Uses (and refreshes if needed) the observer's cached FOV.
+	bool CanSee(int manager, int entityID, int mapID, int x, int y, int tx, int ty, int range = 0);
+
+	// Bresenham ray from (x0,y0) to (x1,y1), blocked by any opaque cell in between. range 0 means unlimited.
+	bool HasLineOfSight(int mapID, int x0, int y0, int x1, int y1, int range = 0);
+
+	// drop the observer's cached FOV (died, left the map etc)
+	void Forget(int manager, int entityID);
+
+	// number of actual FOV computations run since startup
+	int GetComputeCount() { return computes; }
+};
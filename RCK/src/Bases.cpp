@@ -1,17 +1,16 @@
 #include "Bases.h"
+#include "DataPack.h"
+#include "Snapshot.h"
 
 BaseManager* BaseManager::LoadBaseData()
 {
-	gLog->Log("Base Loader", "Started");
+	RCK_LOG_INFO("Base Loader", "Started");
 	
 	std::string baseFilename = "RCK/scripts/bases.json";
-	std::ifstream is(baseFilename);
 
-	BaseManager* output = new BaseManager(jsoncons::decode_json<BaseInfoSet>(is));
+	BaseManager* output = new BaseManager(DataPack::LoadJson<BaseInfoSet>(baseFilename));
 
-	is.close();
-
-	gLog->Log("Base Loader", "Decoded " + baseFilename);
+	RCK_LOG_INFO("Base Loader", "Decoded " + baseFilename);
 
 	// feed reverse lookup
 	for (int i = 0; i < output->baseInfoSet.BaseTypes().size(); i++)
@@ -26,26 +25,32 @@ BaseManager* BaseManager::LoadBaseData()
 		output->reverseBaseTagDictionary[it.Tag()] = i;
 	}
 	
-	output->nextBaseID = 0;
-
-	gLog->Log("Base Loader", "Completed");
+	RCK_LOG_INFO("Base Loader", "Completed");
 	
 	return output;
 }
 
 int BaseManager::shellGenerate()
 {
-	int output = nextBaseID++;
-
-	DebugLog("Generating Empty Base #" + std::to_string(output));
-
-	baseType.push_back(0); // default is camp
-	baseXPos.push_back(-1);
-	baseYPos.push_back(-1);
-	basePartyID.push_back(-1);
-	ownerPartyID.push_back(-1);
-
-	pcActiveTags.push_back({});
+	int output = baseIDs.Allocate();
+
+	DEBUG_LOG("Generating Empty Base #" + std::to_string(output));
+
+	// nothing gives a base ID back yet, but if it does the slot gets reset the same as a new one
+	int size = baseIDs.GetCapacity();
+	baseType.resize(size);
+	baseXPos.resize(size);
+	baseYPos.resize(size);
+	basePartyID.resize(size);
+	ownerPartyID.resize(size);
+	pcActiveTags.resize(size);
+
+	baseType[output] = 0; // default is camp
+	baseXPos[output] = -1;
+	baseYPos[output] = -1;
+	basePartyID[output] = -1;
+	ownerPartyID[output] = -1;
+	pcActiveTags[output].clear();
 
 	return output;
 }
@@ -70,19 +75,19 @@ std::vector<int>& BaseManager::getAnimals(int baseID)
 void BaseManager::AddPlayerCharacter(int characterID, int baseID)
 {
 	gGame->mPartyManager->AddPlayerCharacter(basePartyID[baseID], characterID);
-	DebugLog("PC (character ID #" + std::to_string(characterID) + ") added to party");
+	DEBUG_LOG("PC (character ID #" + std::to_string(characterID) + ") added to party");
 }
 
 void BaseManager::AddHenchman(int characterID, int baseID)
 {
 	gGame->mPartyManager->AddHenchman(basePartyID[baseID], characterID);
-	DebugLog("Henchman (character ID #" + std::to_string(characterID) + ") added to party");
+	DEBUG_LOG("Henchman (character ID #" + std::to_string(characterID) + ") added to party");
 }
 
 void BaseManager::AddAnimal(int mobID, int baseID)
 {
 	gGame->mPartyManager->AddAnimal(basePartyID[baseID], mobID);
-	DebugLog("Animal (mob ID #" + std::to_string(mobID) + ") added to party");
+	DEBUG_LOG("Animal (mob ID #" + std::to_string(mobID) + ") added to party");
 }
 
 void BaseManager::getBasePartyCharacters(std::vector<int>& out, int baseID)
@@ -177,7 +182,7 @@ std::string BaseManager::GetBaseType(int baseID)
 
 int BaseManager::GenerateCampAtLocation(int partyID, int basePosX, int basePosY)
 {
-	DebugLog("Creating a camp controlled by party #" + std::to_string(partyID) + " at (" + std::to_string(basePosX) + "," + std::to_string(basePosY) + ")");
+	DEBUG_LOG("Creating a camp controlled by party #" + std::to_string(partyID) + " at (" + std::to_string(basePosX) + "," + std::to_string(basePosY) + ")");
 	int output = shellGenerate();
 
 	basePartyID[output] = gGame->mPartyManager->GenerateEmptyParty(); // new PartyID
@@ -216,7 +221,7 @@ int BaseManager::GenerateCampAtLocation(int partyID, int basePosX, int basePosY)
 
 void BaseManager::DebugLog(std::string message)
 {
-	gLog->Log("Base Manager", message);
+	DEBUG_LOG(message);
 }
 
 bool BaseManager::TurnHandler(int baseID, double time)
@@ -270,7 +275,7 @@ void BaseManager::DumpBase(int baseID)
 {
 	// TODO: Dump local party
 
-	DebugLog("Dumping virtual out-party");
+	DEBUG_LOG("Dumping virtual out-party");
 	
 	for(int character : gGame->mPartyManager->getPlayerCharacters(basePartyID[baseID]))
 	{
@@ -738,4 +743,34 @@ void BaseManager::RenderBaseMenu(int xpos, int ypos)
 				RenderBaseMenu(i);
 		}
 	}
-}
\ No newline at end of file
+}
+
+void BaseManager::SaveSnapshot(SnapshotWriter& w)
+{
+	w.Section("BASE");
+	baseIDs.Save(w);
+	w.Write(baseType);
+	w.Write(basePartyID);
+	w.Write(ownerPartyID);
+	w.Write(baseXPos);
+	w.Write(baseYPos);
+	w.Write(controlPane);
+	w.Write(menuPosition);
+	w.Write(pcActiveTags);
+}
+
+bool BaseManager::LoadSnapshot(SnapshotReader& r)
+{
+	if (!r.Section("BASE"))
+		return false;
+	baseIDs.Load(r);
+	r.Read(baseType);
+	r.Read(basePartyID);
+	r.Read(ownerPartyID);
+	r.Read(baseXPos);
+	r.Read(baseYPos);
+	r.Read(controlPane);
+	r.Read(menuPosition);
+	r.Read(pcActiveTags);
+	return r.Ok();
+}
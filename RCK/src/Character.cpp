@@ -1,16 +1,16 @@
 #include "Character.h"
 #include "Class.h"
+#include "DataPack.h"
 #include "Game.h"
+#include "Snapshot.h"
 
 CharacterManager* CharacterManager::LoadCharacteristics()
 {
-	gLog->Log("Characteristic Loader","Started");
+	RCK_LOG_INFO("Characteristic Loader", "Started");
 
 	const std::string statsFilename = "RCK/scripts/statistics.json";
-	
-	std::ifstream is(statsFilename);
 
-	CharacterManager* cm = new CharacterManager(jsoncons::decode_json<CharacteristicData>(is));
+	CharacterManager* cm = new CharacterManager(DataPack::LoadJson<CharacteristicData>(statsFilename));
 
 	// resort the characteristics into a map for lookup#
 
@@ -33,20 +33,24 @@ CharacterManager* CharacterManager::LoadCharacteristics()
 		}
 	}
 
-	is.close();
+	for (const auto& kv : cm->CharacteristicTags)
+	{
+		cm->CharacteristicTagIDs.push_back(std::make_pair(Symbols().Intern(kv.first), kv.second));
+	}
 
-	gLog->Log("Characteristic Loader", "Decoded " + statsFilename);
+	for (int i = 0; i < SAVE_MAX; i++)
+	{
+		cm->saveTags.push_back(Symbols().Intern("Saves:" + saveTypes[i]));
+	}
+
+	RCK_LOG_INFO("Characteristic Loader", "Decoded " + statsFilename);
 	
 	// read the characteristic bonuses from ability_bonus.csv
 
 	const std::string abilityBonusFilename = "RCK/scripts/ability_bonus.csv";
 
-	std::ifstream cs(abilityBonusFilename);
-	
-	jsoncons::csv::csv_options options;
-	options.assume_header(true);
-
-	jsoncons::ojson j = jsoncons::csv::decode_csv<jsoncons::ojson>(cs, options);
+	jsoncons::ojson j;
+	DataPack::LoadCsv(abilityBonusFilename, true, j);
 
 	cm->AbilityBonuses.resize(19);
 	
@@ -58,15 +62,12 @@ CharacterManager* CharacterManager::LoadCharacteristics()
 		cm->AbilityBonuses[dice] = bonus;
 	}
 
-	cs.close();
-
-	gLog->Log("Characteristic Loader", "Decoded " + abilityBonusFilename);
+	RCK_LOG_INFO("Characteristic Loader", "Decoded " + abilityBonusFilename);
 
 	const std::string abilityRequisiteFilename = "RCK/scripts/ability_prime_req.csv";
 	
-	std::ifstream prs(abilityRequisiteFilename);
-
-	jsoncons::ojson jprs = jsoncons::csv::decode_csv<jsoncons::ojson>(prs, options);
+	jsoncons::ojson jprs;
+	DataPack::LoadCsv(abilityRequisiteFilename, true, jprs);
 
 	cm->PrimeReqMultiplier.resize(19);
 
@@ -78,11 +79,9 @@ CharacterManager* CharacterManager::LoadCharacteristics()
 		cm->PrimeReqMultiplier[score] = multiplier;
 	}
 
-	prs.close();
-
-	gLog->Log("Characteristic Loader", "Decoded " + abilityRequisiteFilename);
+	RCK_LOG_INFO("Characteristic Loader", "Decoded " + abilityRequisiteFilename);
 
-	gLog->Log("Characteristic Loader", "Completed");
+	RCK_LOG_INFO("Characteristic Loader", "Completed");
 
 	return cm;
 }
@@ -130,7 +129,7 @@ bool CharacterManager::TurnHandler(int entityID, double time)
 		{
 			// move in a random direction
 			int moveX, moveY, move_value;
-			int mapID = gGame->GetCurrentMap();
+			int mapID = pcMapID[entityID];
 			if (gGame->mMapManager->getMap(mapID)->outdoor)
 			{
 				move_value = gGame->randomiser->getInt(0, 5);
@@ -139,7 +138,7 @@ bool CharacterManager::TurnHandler(int entityID, double time)
 			{
 				move_value = gGame->randomiser->getInt(0, 7);
 			}
-			gGame->mMapManager->shift(gGame->GetCurrentMap(), moveX, moveY, GetPlayerX(entityID), GetPlayerY(entityID), move_value);
+			gGame->mMapManager->shift(mapID, moveX, moveY, GetPlayerX(entityID), GetPlayerY(entityID), move_value);
 
 			timeToMove = MoveTo(entityID, moveX, moveY, time);
 		}
@@ -217,6 +216,7 @@ bool CharacterManager::TimeHandler(int rounds, int turns, int hours, int days, i
 		}
 		if(updateNeeded)
 		{
+			UpdateConditionMask(c);
 			UpdateCapabilities(c);
 		}
 	}
@@ -266,6 +266,7 @@ void CharacterManager::BaseGenerate()
 	// no condition
 	std::vector<std::pair<int,int>> b;
 	pcConditions.push_back(b);
+	pcConditionMasks.push_back(0);
 
 	// basic capabilities
 	pcCapabilityFlags.push_back(GenerateBaseCapabilityFlags());
@@ -273,13 +274,16 @@ void CharacterManager::BaseGenerate()
 	// empty inventory and equipment
 	std::list<int> a;
 	pcInventory.push_back(a);
+	pcLoadUnits.push_back(0);
+	pcEncumbranceClass.push_back(-1);
+	pcSpeed.push_back(-1);
 
 	std::vector<int> e;
 	e.resize(EQUIP_MAX, -1);
 	pcEquipped.push_back(e);
 
 	// tag cache
-	pcCollectedTags.push_back(std::map<std::string, int>());
+	pcTagValues.push_back(std::vector<int>());
 
 	// copy class armour and weapon proficiencies to the cache
 	pcArmourProficiencies.push_back(std::vector<std::string>());
@@ -307,9 +311,9 @@ void CharacterManager::BaseGenerate()
 
 int CharacterManager::GenerateNormalMan(std::string name)
 {
-	int output = nextCharacterIndex++;
+	int output = characterIDs.Allocate();
 
-	DebugLog("Generating a Normal Man as #" + std::to_string(output));
+	DEBUG_LOG("Generating a Normal Man as #" + std::to_string(output));
 
 	// we need to add something to every vector, to make sure we line up
 
@@ -353,9 +357,9 @@ int CharacterManager::GenerateNormalMan(std::string name)
 
 int CharacterManager::GenerateTestCharacter(std::string name, const std::string _class)
 {
-	int output = nextCharacterIndex++;
+	int output = characterIDs.Allocate();
 
-	DebugLog("Generating a " + _class +"as #" + std::to_string(output));
+	DEBUG_LOG("Generating a " + _class +"as #" + std::to_string(output));
 
 	// we need to add something to every vector, to make sure we line up
 
@@ -404,7 +408,7 @@ int CharacterManager::SelectBehaviour(int entityID)
 	int result = -1;
 	// TODO: Add sensorium checks here
 
-	if (getCharacterHasCondition(entityID, "Unconscious")) return CHAR_BEHAVIOUR_UNCONSCIOUS;
+	if (getCharacterHasCondition(entityID, gGame->mConditionManager->UnconsciousIndex)) return CHAR_BEHAVIOUR_UNCONSCIOUS;
 
 	// doing nothing special yet, set wander
 
@@ -441,25 +445,24 @@ void CharacterManager::UpdateProficiencyCache(int characterID)
 	styleCache.insert(styleCache.end(), classFightingStyles.begin(), classFightingStyles.end());
 }
 
+unsigned long long CharacterManager::CapabilityFromName(const std::string& name)
+{
+	// only called while loading, so a straight search is fine
+	for (int i = 0; i < CAPABILITY_MAX; i++)
+	{
+		if (CapabilityNames[i] == name)
+			return 1ULL << i;
+	}
+	return 0;
+}
+
 void CharacterManager::UpdateCapabilities(int characterID)
 {
 	// start with base capabilities, universal to all characters
 	unsigned long long capabilityFlags = GenerateBaseCapabilityFlags();
 
 	// add all class capabilities
-	ACKSClass ac = gGame->mClassManager->Classes().Classes()[pcClass[characterID]];
-
-	for(LevelledAbility la : ac.LevelledAbilities())
-	{
-		std::string name = la.Type();
-		if(name.compare(0,11,"Capability:") == 0)
-		{
-			// this is a capability flag
-			std::string capability = name.substr(11, name.length() - 11);
-			unsigned long long capability_index = CapabilityLookup.at(capability);
-			capabilityFlags |= capability_index;
-		}
-	}
+	capabilityFlags |= gGame->mClassManager->Classes().Classes()[pcClass[characterID]].CapabilityFlags;
 	
 	// add all fighting style capabilities
 	for(std::string s : pcFightingStyles[characterID])
@@ -486,16 +489,7 @@ void CharacterManager::UpdateCapabilities(int characterID)
 
 	for(MortalEffect* effect : pcMortalWounds[characterID])
 	{
-		for(SpecialPenalty penalty : effect->SpecialPenalties())
-		{
-			std::string name = penalty.Name();
-			if (name.compare(0, 11, "Capability:") == 0)
-			{
-				std::string capability = name.substr(11, name.length() - 11);
-				unsigned long long capability_index = CapabilityLookup.at(capability);
-				capabilityFlags &= ~capability_index;
-			}
-		}
+		capabilityFlags &= ~effect->PenaltyCapabilities;
 	}
 
 	// store results
@@ -504,7 +498,7 @@ void CharacterManager::UpdateCapabilities(int characterID)
 
 std::string CharacterManager::DumpProficiencyCache(int characterID)
 {
-	DebugLog("Dumping Proficiencies for " + this->getCharacterName(characterID) + ":");
+	DEBUG_LOG("Dumping Proficiencies for " + this->getCharacterName(characterID) + ":");
 
 	std::string aProfList = "Armour:";
 	for(std::string aProf : pcArmourProficiencies[characterID])
@@ -528,7 +522,7 @@ std::string CharacterManager::DumpProficiencyCache(int characterID)
 	sProfList = "\n";
 
 	std::string output = aProfList + wProfList + sProfList;
-	DebugLog(output);
+	DEBUG_LOG(output);
 	return output;
 }
 
@@ -581,11 +575,11 @@ int CharacterManager::EquipShield(int characterID, int itemID)
 	if (CanUseStyle(characterID, "Weapon And Shield"))
 	{
 		pcEquipped[characterID][HAND_OFF] = itemID;
-		DebugLog("Equipped " + gGame->mItemManager->getName(itemID) + " in off-hand");
+		DEBUG_LOG("Equipped " + gGame->mItemManager->getName(itemID) + " in off-hand");
 		return HAND_OFF;
 	}
 
-	DebugLog("Can't equip shield without proficiency");
+	DEBUG_LOG("Can't equip shield without proficiency");
 	return -1;
 }
 
@@ -596,11 +590,11 @@ int CharacterManager::EquipArmour(int characterID, int itemID)
 	if (CanUseItem(characterID, itemID))
 	{
 		pcEquipped[characterID][ARMOUR] = itemID;
-		DebugLog("Equipped " + gGame->mItemManager->getName(itemID));
+		DEBUG_LOG("Equipped " + gGame->mItemManager->getName(itemID));
 		return ARMOUR;
 	}
 
-	DebugLog("Can't equip armour without proficiency");
+	DEBUG_LOG("Can't equip armour without proficiency");
 	return -1;
 }
 
@@ -628,8 +622,8 @@ int CharacterManager::EquipWeapon(int characterID, int itemID)
 	// Note that this function will NOT unequip existing items, you need to do that upstream
 
 	// with all weapons, shields, armour etc we need to check that we have proficiency with them and can use the appropriate style.	
-	bool one_h = gGame->mItemManager->hasTag(itemID, "One-Handed");
-	bool two_h = gGame->mItemManager->hasTag(itemID, "Two-Handed");
+	bool one_h = gGame->mItemManager->hasTag(itemID, ITEM_TAG_ONE_HANDED);
+	bool two_h = gGame->mItemManager->hasTag(itemID, ITEM_TAG_TWO_HANDED);
 
 	std::string item_name = gGame->mItemManager->getName(itemID);
 
@@ -645,7 +639,7 @@ int CharacterManager::EquipWeapon(int characterID, int itemID)
 				// we can use the two-handed style, so lets wield this two-handed!
 				pcEquipped[characterID][HAND_MAIN] = itemID;
 				pcEquipped[characterID][HAND_OFF] = itemID;
-				DebugLog(getCharacterName(characterID) + " equips " + item_name + " two-handed.");
+				DEBUG_LOG(getCharacterName(characterID) + " equips " + item_name + " two-handed.");
 				return HAND_MAIN;
 			}
 		}
@@ -664,7 +658,7 @@ int CharacterManager::EquipWeapon(int characterID, int itemID)
 					// we can use the two-handed style, so lets wield this two-handed!
 					pcEquipped[characterID][HAND_MAIN] = itemID;
 					pcEquipped[characterID][HAND_OFF] = itemID;
-					DebugLog(getCharacterName(characterID) + " equips " + item_name + " two-handed.");
+					DEBUG_LOG(getCharacterName(characterID) + " equips " + item_name + " two-handed.");
 					return HAND_MAIN;
 				}
 			}
@@ -677,13 +671,13 @@ int CharacterManager::EquipWeapon(int characterID, int itemID)
 			{
 				// we can do paired weapons, so lets do it
 				pcEquipped[characterID][HAND_OFF] = itemID;
-				DebugLog(getCharacterName(characterID) + " equips " + item_name + " in off-hand.");
+				DEBUG_LOG(getCharacterName(characterID) + " equips " + item_name + " in off-hand.");
 				return HAND_OFF;
 			}
 			else
 			{
 				// we tried to equip a second weapon and we can't use paired, so nowt
-				DebugLog(getCharacterName(characterID) + " can't dual wield " + item_name);
+				DEBUG_LOG(getCharacterName(characterID) + " can't dual wield " + item_name);
 				return -1;
 			}
 		}
@@ -697,34 +691,34 @@ int CharacterManager::EquipWeapon(int characterID, int itemID)
 
 			int offhandItem = pcEquipped[characterID][HAND_OFF];
 
-			if (gGame->mItemManager->hasTag(offhandItem, "Shield"))
+			if (gGame->mItemManager->hasTag(offhandItem, ITEM_TAG_SHIELD))
 			{
 				if (CanUseStyle(characterID, "Weapon And Shield"))
 				{
 					pcEquipped[characterID][HAND_MAIN] = itemID;
-					DebugLog(getCharacterName(characterID) + " equips " + item_name + " alongside their shield.");
+					DEBUG_LOG(getCharacterName(characterID) + " equips " + item_name + " alongside their shield.");
 					return HAND_MAIN;
 				}
 				else
 				{
 					// wield nothing
-					DebugLog(getCharacterName(characterID) + " cannot wield " + item_name + " alongside their shield.");
+					DEBUG_LOG(getCharacterName(characterID) + " cannot wield " + item_name + " alongside their shield.");
 					return -1;
 				}
 			}
 
-			if (gGame->mItemManager->hasTag(offhandItem, "Weapon"))
+			if (gGame->mItemManager->hasTag(offhandItem, ITEM_TAG_WEAPON))
 			{
 				if (CanUseStyle(characterID, "Paired Weapon"))
 				{
 					pcEquipped[characterID][HAND_MAIN] = itemID;
-					DebugLog(getCharacterName(characterID) + " equips " + item_name + " paired.");
+					DEBUG_LOG(getCharacterName(characterID) + " equips " + item_name + " paired.");
 					return HAND_MAIN;
 				}
 				else
 				{
 					// wield nothing
-					DebugLog(getCharacterName(characterID) + " cannot wield " + item_name + " paired.");
+					DEBUG_LOG(getCharacterName(characterID) + " cannot wield " + item_name + " paired.");
 					return -1;
 				}
 			}
@@ -732,7 +726,7 @@ int CharacterManager::EquipWeapon(int characterID, int itemID)
 			// if we reach here, then our other item is some misc nonsense, so wield normally
 
 			pcEquipped[characterID][HAND_MAIN] = itemID;
-			DebugLog(getCharacterName(characterID) + " equips " + item_name + " in on-hand.");
+			DEBUG_LOG(getCharacterName(characterID) + " equips " + item_name + " in on-hand.");
 			return HAND_MAIN;
 		}
 	}
@@ -765,7 +759,7 @@ void CharacterManager::UnequipItem(int characterID, int inventoryID)
 		}
 	}
 	std::string item_name = gGame->mItemManager->getName(itemID);
-	DebugLog(getCharacterName(characterID) + " unequips " + item_name);
+	DEBUG_LOG(getCharacterName(characterID) + " unequips " + item_name);
 }
 
 int CharacterManager::EquipItem(int characterID, int inventoryID)
@@ -784,18 +778,18 @@ int CharacterManager::EquipItem(int characterID, int inventoryID)
 
 	if (CanUseItem(characterID, itemID))
 	{
-		if (gGame->mItemManager->hasTag(itemID, "Weapon"))
+		if (gGame->mItemManager->hasTag(itemID, ITEM_TAG_WEAPON))
 		{
 			output = EquipWeapon(characterID, itemID);
-			UpdateCurrentAttackValue(characterID, gGame->mItemManager->hasTag(itemID, "Missile"));
+			UpdateCurrentAttackValue(characterID, gGame->mItemManager->hasTag(itemID, ITEM_TAG_MISSILE));
 		}
 
-		if (gGame->mItemManager->hasTag(itemID, "Shield"))
+		if (gGame->mItemManager->hasTag(itemID, ITEM_TAG_SHIELD))
 		{
 			output = EquipShield(characterID, itemID);
 		}
 
-		if (gGame->mItemManager->hasTag(itemID, "Armour"))
+		if (gGame->mItemManager->hasTag(itemID, ITEM_TAG_ARMOUR))
 		{
 			output = EquipArmour(characterID, itemID);
 		}
@@ -817,7 +811,7 @@ bool CharacterManager::CanUseItem(int characterID, int itemID)
 {
 	// this function checks for proficiencies. magic items will use something else
 
-	bool is_weapon = gGame->mItemManager->hasTag(itemID, "Weapon");
+	bool is_weapon = gGame->mItemManager->hasTag(itemID, ITEM_TAG_WEAPON);
 	if(is_weapon)
 	{
 		// this is a weapon. If any of the weapon's tags match the user's class proficiencies, we can use this weapon
@@ -833,7 +827,7 @@ bool CharacterManager::CanUseItem(int characterID, int itemID)
 	}
 	else
 	{
-		bool is_armour = gGame->mItemManager->hasTag(itemID, "Armour");
+		bool is_armour = gGame->mItemManager->hasTag(itemID, ITEM_TAG_ARMOUR);
 		if(is_armour)
 		{
 			if (std::find_if(pcArmourProficiencies[characterID].begin(), pcArmourProficiencies[characterID].end(), [itemID](const std::string& prof) -> bool {return gGame->mItemManager->hasTag(itemID, prof); }) == pcArmourProficiencies[characterID].end())
@@ -848,7 +842,7 @@ bool CharacterManager::CanUseItem(int characterID, int itemID)
 		}
 	}
 
-	bool is_shield = gGame->mItemManager->hasTag(itemID, "Shield");
+	bool is_shield = gGame->mItemManager->hasTag(itemID, ITEM_TAG_SHIELD);
 	if(is_shield)
 	{
 		if(CanUseStyle(characterID, "Weapon And Shield"))
@@ -865,12 +859,17 @@ int CharacterManager::AddInventoryItem(int characterID, int itemID)
 {
 	int newIndex = pcInventory[characterID].size();
 	pcInventory[characterID].push_back(itemID);
+	if (pcLoadUnits[characterID] >= 0)
+	{
+		pcLoadUnits[characterID] += gGame->mItemManager->getWeightUnits(itemID);
+	}
+	InvalidateEncumbrance(characterID);
 	return newIndex;
 }
 
 int CharacterManager::RemoveInventoryItem(int characterID, int inventoryID)
 {
-	auto list = pcInventory[characterID];
+	auto& list = pcInventory[characterID];
 
 	if (list.size() == 0)
 		return -1;
@@ -880,6 +879,11 @@ int CharacterManager::RemoveInventoryItem(int characterID, int inventoryID)
 	int output = *iter;
 
 	list.erase(iter);
+	if (pcLoadUnits[characterID] >= 0)
+	{
+		pcLoadUnits[characterID] -= gGame->mItemManager->getWeightUnits(output);
+	}
+	InvalidateEncumbrance(characterID);
 	
 	return output;
 }
@@ -893,64 +897,64 @@ void CharacterManager::UpdateTagCache(int characterID)
 	// 4) Your Mortal Wounds (usually negative)
 	// These are used as the value modifiers for a variety of values and are totalled here.
 
-	auto &tags = pcCollectedTags[characterID];
+	// built from scratch each time, so updating twice doesn't count the bonuses twice
+	auto &tags = pcTagValues[characterID];
+	tags.assign(Symbols().Count(), 0);
+
+	const ACKSClass* ac = getCharacterClass(characterID);
+	int level = getCharacterLevel(characterID);
 	
 	// abilities unlocked per-level (as opposed to levelled bonuses)
 	// these are not summed
-	for (auto kv : getCharacterClass(characterID)->LevelledAbilities())
+	const std::vector<LevelledAbility>& abilities = ac->LevelledAbilities();
+	for (int i = 0; i < abilities.size(); i++)
 	{
-		if (getCharacterLevel(characterID) > kv.Level())
+		if (level > abilities[i].Level())
 		{
-			tags[kv.Type()] = kv.Value();
+			tags[ac->LevelledAbilityTags[i]] = abilities[i].Value();
 		}
 	}
 
 	// characteristic bonuses
-	for(auto kv : CharacteristicTags)
+	for(const auto& kv : CharacteristicTagIDs)
 	{
 		tags[kv.first] += getCharacterAbilityBonus(characterID, kv.second);
 	}
 
 	// levelled bonuses from class
-	for (auto kv : getCharacterClass(characterID)->LevelTagBonuses)
+	for (const auto& kv : ac->LevelTagBonuses)
 	{
-		tags[kv.first] += kv.second[getCharacterLevel(characterID)];
+		tags[kv.first] += kv.second[level];
 	}
 
+	// if it's not a Capability, it's a Tag
 	for (MortalEffect* effect : pcMortalWounds[characterID])
 	{
-		for (SpecialPenalty penalty : effect->SpecialPenalties())
+		for (const auto& penalty : effect->PenaltyTags)
 		{
-			std::string name = penalty.Name();
-			// if it's not a Capability, it's a Tag
-			if (name.compare(0, 11, "Capability:"))
-			{
-				tags[name] = penalty.Value();
-			}
+			tags[penalty.first] = penalty.second;
 		}
 	}
 }
 
 std::string CharacterManager::DumpTagCache(int characterID)
 {
-	DebugLog("Dumping Tags for " + this->getCharacterName(characterID));
+	DEBUG_LOG("Dumping Tags for " + this->getCharacterName(characterID));
 
 	std::string tagList;
-	for (auto tag : pcCollectedTags[characterID])
+	const std::vector<int>& tags = pcTagValues[characterID];
+	for (SymbolID tag = 0; tag < (SymbolID)tags.size(); tag++)
 	{
-		tagList += tag.first + ":" + std::to_string(tag.second) + ", ";
+		if (tags[tag] != 0)
+		{
+			tagList += Symbols().GetName(tag) + ":" + std::to_string(tags[tag]) + ", ";
+		}
 	}
 	tagList += "\n";
-	DebugLog(tagList);
+	DEBUG_LOG(tagList);
 	return tagList;
 }
 
-int CharacterManager::getTagValue(int characterID, std::string tag)
-{
-	auto &tags = pcCollectedTags[characterID];
-	return tags[tag];
-}
-
 int CharacterManager::UpdateCurrentAttackValue(int characterID, bool missile)
 {
 	// TODO: Fighting style bonuses to attack value
@@ -959,50 +963,56 @@ int CharacterManager::UpdateCurrentAttackValue(int characterID, bool missile)
 	auto acks_class = gGame->mCharacterManager->getCharacterClass(characterID);
 	int level = gGame->mCharacterManager->getCharacterLevel(characterID);
 
-	std::string debugOutput = this->getCharacterName(characterID) + " calculating attack value with base ";
-	
-	auto attack_bonuses = advancement->AttackBonusLookup[acks_class->AttackProgression()];
-	int attack_bonus = attack_bonuses[level];
-
-	debugOutput += std::to_string(attack_bonus);
-
-	std::string attack_tag = "Attack:Melee";
-	if(missile)
-	{
-		attack_tag = "Attack:Missile";
-	}
-
-	int tagValue = getTagValue(characterID, attack_tag);
-	debugOutput += " and tag bonus " + std::to_string(tagValue);
+	int attack_bonus = advancement->GetAttackBonuses(acks_class->AttackProgressionIdx)[level];
+	int tagValue = getTagValue(characterID, missile ? TAG_ATTACK_MISSILE : TAG_ATTACK_MELEE);
 	
 	int output = attack_bonus - tagValue; // why minus? Because our attack values are roll-above, eg 7 gives "7+". So a bonus of 2 gives "5+"
-	debugOutput += " for a total of " + std::to_string(output);
-	DebugLog(debugOutput);
+	DEBUG_LOG(this->getCharacterName(characterID) + " calculating attack value with base " + std::to_string(attack_bonus) +
+		" and tag bonus " + std::to_string(tagValue) + " for a total of " + std::to_string(output));
 	return output;
 }
 
-int CharacterManager::UpdateCurrentSaveValue(int characterID, std::string save)
+int CharacterManager::UpdateCurrentSaveValue(int characterID, int saveType)
 {
 	auto advancement = gGame->mClassManager->GetAdvancementStore();
-	auto classes = advancement->SaveLookup[save];
 	int level = gGame->mCharacterManager->getCharacterLevel(characterID);
 	auto acks_class = gGame->mCharacterManager->getCharacterClass(characterID);
 
-	auto by_level = classes[acks_class->Name()];
-
-	int save_value = by_level[level];
+	int save_value = advancement->GetSaves(saveType, acks_class->SaveProgressionIdx)[level];
 
-	std::string save_tag = "Saves:" + save;
-
-	int output = save_value + getTagValue(characterID, save_tag);
-	DebugLog(this->getCharacterName(characterID) + " updated current " + save + " value to " + std::to_string(output));
+	int output = save_value + getTagValue(characterID, saveTags[saveType]);
+	DEBUG_LOG(this->getCharacterName(characterID) + " updated current " + saveTypes[saveType] + " value to " + std::to_string(output));
 	return output;
 }
 
+int CharacterManager::UpdateCurrentSaveValue(int characterID, std::string save)
+{
+	for (int i = 0; i < SAVE_MAX; i++)
+	{
+		if (save == saveTypes[i])
+			return UpdateCurrentSaveValue(characterID, i);
+	}
+	return 0;
+}
+
 double CharacterManager::GetCurrentEncumbrance(int characterID)
 {
-	auto inv = GetInventory(characterID);
-	return gGame->mItemManager->getWeight(inv);
+	return (double)GetLoadUnits(characterID) / WEIGHT_UNITS_PER_STONE;
+}
+
+long long CharacterManager::GetLoadUnits(int characterID)
+{
+	if (pcLoadUnits[characterID] < 0)
+	{
+		// full recount, only needed after a snapshot load
+		long long total = 0;
+		for (int item : pcInventory[characterID])
+		{
+			total += gGame->mItemManager->getWeightUnits(item);
+		}
+		pcLoadUnits[characterID] = total;
+	}
+	return pcLoadUnits[characterID];
 }
 
 int CharacterManager::GetCurrentSpeed(int characterID)
@@ -1018,49 +1028,56 @@ int CharacterManager::GetCurrentSpeed(int characterID)
 	// encumbrance load can be 0-1/2 Base (Minimal, full speed), 1/2 - 3/4 Base (Light), 3/4 - Base (Medium), Base - 2xBase (Heavy)
 	// Exploration Speeds are 120/90/60/30 for each category
 
+	if (pcSpeed[characterID] >= 0)
+		return pcSpeed[characterID];
+
 	// first get the encumbrance class (split off so we can also use this for text response)
 	int encumbrance = GetEncumbranceClass(characterID);
 
 	double calcMovement = (4 - encumbrance) * BASE_MOVEMENT;
 
+	pcSpeed[characterID] = calcMovement;
 	return calcMovement;
 	
 }
 
 int CharacterManager::GetEncumbranceClass(int characterID)
 {
-	const double BASE_LOAD = 10.0;
+	if (pcEncumbranceClass[characterID] >= 0)
+		return pcEncumbranceClass[characterID];
+
+	// in weight units, so the comparisons are exact
+	const long long BASE_LOAD = 10 * WEIGHT_UNITS_PER_STONE;
 
-	const double minimal = BASE_LOAD * 0.5;
-	const double light = BASE_LOAD * 0.75;
-	const double medium = BASE_LOAD * 1.0;
-	const double heavy = BASE_LOAD * 2.0;
+	const long long minimal = BASE_LOAD / 2;
+	const long long light = BASE_LOAD * 3 / 4;
+	const long long medium = BASE_LOAD;
 
-	double currentEnc = GetCurrentEncumbrance(characterID);
+	long long currentEnc = GetLoadUnits(characterID);
 
+	int encumbranceClass = 3;
 	if(currentEnc <= minimal)
 	{
-		return 0;
-	}
-	else if(currentEnc > minimal && currentEnc <= light )
-	{
-		return 1;
+		encumbranceClass = 0;
 	}
-	else if(currentEnc > light && currentEnc <= medium )
+	else if(currentEnc <= light )
 	{
-		return 2;
+		encumbranceClass = 1;
 	}
-	else
+	else if(currentEnc <= medium )
 	{
-		return 3;
+		encumbranceClass = 2;
 	}
+
+	pcEncumbranceClass[characterID] = encumbranceClass;
+	return encumbranceClass;
 }
 
 std::string CharacterManager::GetCurrentEncumbranceType(int characterID)
 {
 	const std::string thing[] = { "Minimal","Light","Medium","Heavy" };
 	int encumbranceClass = GetEncumbranceClass(characterID);
-	DebugLog(this->getCharacterName(characterID) + " recalculated current encumbrance class as " + thing[encumbranceClass]);
+	DEBUG_LOG(this->getCharacterName(characterID) + " recalculated current encumbrance class as " + thing[encumbranceClass]);
 	return thing[encumbranceClass];
 }
 
@@ -1070,11 +1087,9 @@ int CharacterManager::GetCurrentDamageBonus(int characterID, bool missile)
 
 	int damageBonus = 0;
 
-	std::string damageTag = missile ? "Damage:Missile" : "Damage:Melee";
-
-	damageBonus += getTagValue(characterID, damageTag);
+	damageBonus += getTagValue(characterID, missile ? TAG_DAMAGE_MISSILE : TAG_DAMAGE_MELEE);
 
-	DebugLog(this->getCharacterName(characterID) + " recalculated current damage bonus:" + std::to_string(damageBonus));
+	DEBUG_LOG(this->getCharacterName(characterID) + " recalculated current damage bonus:" + std::to_string(damageBonus));
 	
 	return damageBonus;
 }
@@ -1090,7 +1105,7 @@ int CharacterManager::GetCurrentAC(int characterID)
 	std::string debugOut = this->getCharacterName(characterID) + " recalculating AC with ";
 	
 	// if the thing in our offhand isn't some form of shield, ignore it
-	if(shieldID != -1 && !gGame->mItemManager->hasTag(shieldID, "Shield"))
+	if(shieldID != -1 && !gGame->mItemManager->hasTag(shieldID, ITEM_TAG_SHIELD))
 	{
 		shieldID = -1;
 	}
@@ -1100,35 +1115,21 @@ int CharacterManager::GetCurrentAC(int characterID)
 	if(armourID != -1)
 	{
 		debugOut += gGame->mItemManager->getName(armourID) + ", ";
-		auto tags = gGame->mItemManager->getTags(armourID);
-		auto ac_tag = std::find_if(tags.begin(), tags.end(), [](std::string s) -> bool { const std::string pre = "AC|"; return (s.compare(0, pre.size(), pre) == 0); });
-		if(ac_tag != tags.end())
-		{
-			std::string value = (*ac_tag).substr(3);
-			int ac_value = std::stoi(value);
-			AC += ac_value;
-		}
+		AC += gGame->mItemManager->getProfile(armourID).ACBonus;
 	}
 
 	if (shieldID != -1)
 	{
 		debugOut += gGame->mItemManager->getName(shieldID) + " ";
-		auto tags = gGame->mItemManager->getTags(shieldID);
-		auto ac_tag = std::find_if(tags.begin(), tags.end(), [](std::string s) -> bool { const std::string pre = "AC|"; return (s.compare(0, pre.size(), pre) == 0); });
-		if (ac_tag != tags.end())
-		{
-			std::string value = (*ac_tag).substr(3);
-			int ac_value = std::stoi(value);
-			AC += ac_value;
-		}
+		AC += gGame->mItemManager->getProfile(shieldID).ACBonus;
 	}
 
-	int ac_value = getTagValue(characterID, "Defence:AC");
+	int ac_value = getTagValue(characterID, TAG_DEFENCE_AC);
 	debugOut += "and AC bonus of " + std::to_string(ac_value);
 	AC += ac_value;
 	debugOut += " for a total AC of " + std::to_string(AC);
 	pcCurrentArmourClass[characterID] = AC;
-	DebugLog(debugOut);
+	DEBUG_LOG(debugOut);
 	return AC;
 }
 
@@ -1149,8 +1150,13 @@ int CharacterManager::GetEquipSlotForInventoryItem(int characterID, int inventor
 
 bool CharacterManager::getCharacterHasCondition(int id, int condition)
 {
-	auto p = std::find_if(pcConditions[id].begin(), pcConditions[id].end(), [&](std::pair<int, int> t_cond) { return t_cond.first == condition; });
-	return p != pcConditions[id].end();
+	// includes count, so an Unconscious character is also Helpless
+	return ConditionManager::MaskHasCondition(pcConditionMasks[id], condition);
+}
+
+void CharacterManager::UpdateConditionMask(int id)
+{
+	pcConditionMasks[id] = gGame->mConditionManager->ExpandConditions(pcConditions[id]);
 }
 
 bool CharacterManager::getCharacterHasCondition(int id, std::string condition)
@@ -1162,13 +1168,18 @@ bool CharacterManager::getCharacterHasCondition(int id, std::string condition)
 // Set a condition. Usually inflicted on us by others.
 int CharacterManager::SetCondition(int id, int condition,int time)
 {
-	DebugLog(this->getCharacterName(id) + " setting condition " + gGame->mConditionManager->GetNameFromIndex(condition));
-	
-	// don't duplicate
-	if(!getCharacterHasCondition(id, condition))
+	if (condition < 0)
+		return -1;
+
+	DEBUG_LOG(this->getCharacterName(id) + " setting condition " + gGame->mConditionManager->GetNameFromIndex(condition));
+
+	// don't duplicate. This checks what's actually held rather than the mask - having it via an include isn't the same as having it
+	auto p = std::find_if(pcConditions[id].begin(), pcConditions[id].end(), [&](std::pair<int, int> t_cond) { return t_cond.first == condition; });
+	if(p == pcConditions[id].end())
 	{
 		std::pair<int, int> entry(condition,time);
 		pcConditions[id].push_back(entry);
+		UpdateConditionMask(id);
 		return condition;
 	}
 
@@ -1182,9 +1193,10 @@ int CharacterManager::RemoveCondition(int id, int condition)
 	std::vector<std::pair<int,int>>::iterator iter = std::find_if(pcConditions[id].begin(), pcConditions[id].end(), [&](std::pair<int, int> t_cond) { return t_cond.first == condition; });
 	if(iter != pcConditions[id].end())
 	{
-		DebugLog(this->getCharacterName(id) + " removing condition " + gGame->mConditionManager->GetNameFromIndex(condition));
+		DEBUG_LOG(this->getCharacterName(id) + " removing condition " + gGame->mConditionManager->GetNameFromIndex(condition));
 		std::pair<int,int> value = *iter;
 		pcConditions[id].erase(iter);
+		UpdateConditionMask(id);
 		return value.first;
 	}
 
@@ -1226,14 +1238,14 @@ int CharacterManager::ReduceCondition(int id, std::string condition, int timeToR
 
 void CharacterManager::DebugLog(std::string message)
 {
-	gLog->Log("CharacterManager", message);
+	DEBUG_LOG(message);
 }
 
 void CharacterManager::DumpCharacter(int characterID)
 {
 	// this dumps all character details
 
-	DebugLog("Dumping Character #" + std::to_string(characterID));
+	DEBUG_LOG("Dumping Character #" + std::to_string(characterID));
 
 	std::string name = pcName[characterID];
 
@@ -1282,7 +1294,7 @@ void CharacterManager::DumpCharacter(int characterID)
 
 		std::string display_name = save_name.substr(0, 13);
 
-		int saveVal = UpdateCurrentSaveValue(characterID, save_name);
+		int saveVal = UpdateCurrentSaveValue(characterID, i);
 		std::string save = display_name + ":" + std::to_string(saveVal);
 		dumpFile << save << std::endl;
 	}
@@ -1328,7 +1340,7 @@ void CharacterManager::DumpCharacter(int characterID)
 
 void CharacterManager::SpawnOnMap(int entityID, int mapID, int spawn_x, int spawn_y)
 {
-	gLog->Log("Character Manager", "Spawning " + getCharacterName(entityID) + " onto map #" + std::to_string(mapID));
+	RCK_LOG_DEBUG(LogCategory, "Spawning " + getCharacterName(entityID) + " onto map #" + std::to_string(mapID));
 	
 	pcMapID[entityID] = mapID;
 
@@ -1360,7 +1372,7 @@ void CharacterManager::SpawnOnMap(int entityID, int mapID, int spawn_x, int spaw
 							double moveTime = MoveTo(entityID, new_x, new_y, 0);
 							gGame->mTimeManager->SetEntityTime(entityID, MANAGER_CHARACTER, moveTime);
 							found = true;
-							gLog->Log("Character Manager", "Spawned " + getCharacterName(entityID) + " onto map #" + std::to_string(mapID) + " at position (" + std::to_string(new_x) + "," + std::to_string(new_y) + ")");
+							RCK_LOG_DEBUG(LogCategory, "Spawned " + getCharacterName(entityID) + " onto map #" + std::to_string(mapID) + " at position (" + std::to_string(new_x) + "," + std::to_string(new_y) + ")");
 						}
 					}
 				}
@@ -1383,9 +1395,10 @@ double CharacterManager::MoveTo(int entityID, int new_x, int new_y, int currentT
 			if (new_x >= 0 && new_y >= 0)
 			{
 				int baseCharacter = 0;
-				if ((gGame->mCharacterManager->GetPlayerX(gGame->GetSelectedCharacterID()) == new_x) && (gGame->mCharacterManager->GetPlayerY(gGame->GetSelectedCharacterID()) == new_y))
+				int selected = gGame->GetSelectedCharacterID();
+				if (pcMapID[selected] == mapID && pcXPos[selected] == new_x && pcYPos[selected] == new_y)
 				{
-					baseCharacter = gGame->GetSelectedCharacterID();
+					baseCharacter = selected;
 				}
 				else
 				{
@@ -1402,7 +1415,7 @@ double CharacterManager::MoveTo(int entityID, int new_x, int new_y, int currentT
 					if (mobId)
 					{
 						// there's a monster there. Check for MURDERIZATION!
-						Creature& c = gGame->mMobManager->GetMonster(mobId);
+						Creature c = gGame->mMobManager->GetMonster(mobId);
 
 						if (c.IsBlocking())
 						{
@@ -1423,14 +1436,7 @@ double CharacterManager::MoveTo(int entityID, int new_x, int new_y, int currentT
 					}
 					else
 					{
-						// there isn't another creature there, so move
-						int oldX = GetPlayerX(entityID);
-						int oldY = GetPlayerY(entityID);
-						if (oldX > -1 && oldY > -1)
-							m->setCharacter(oldX, oldY, 0);
-						SetPlayerX(entityID,new_x);
-						SetPlayerY(entityID, new_y);
-						
+						// there isn't another creature there, so move. The map takes us out of our old square and updates our position.
 						m->setCharacter(new_x, new_y, entityID);
 
 						timeExpended = gGame->mMapManager->getMovementTime(mapID, GetCurrentSpeed(entityID));
@@ -1515,9 +1521,10 @@ std::vector<int> CharacterManager::GetTaggedCharactersOnMap(int mapID, std::stri
 	std::vector<int> output;
 	std::vector<int> input = GetCharactersOnMap(mapID);
 	std::vector<int>::iterator it = input.begin();
+	SymbolID tagID = Symbols().Find(tag);
 	if(value)
 	{
-		while ((it = std::find_if(it, input.end(), [=](int c) {return getTagValue(c, tag) != 0; })) != input.end())
+		while ((it = std::find_if(it, input.end(), [=](int c) {return getTagValue(c, tagID) != 0; })) != input.end())
 		{
 			output.push_back(*it);
 			// ReSharper disable once CppDiscardedPostfixOperatorResult
@@ -1526,7 +1533,7 @@ std::vector<int> CharacterManager::GetTaggedCharactersOnMap(int mapID, std::stri
 	}
 	else
 	{
-		while ((it = std::find_if(it, input.end(), [=](int c) {return getTagValue(c, tag) == 0; })) != input.end())
+		while ((it = std::find_if(it, input.end(), [=](int c) {return getTagValue(c, tagID) == 0; })) != input.end())
 		{
 			output.push_back(*it);
 			// ReSharper disable once CppDiscardedPostfixOperatorResult
@@ -1536,22 +1543,28 @@ std::vector<int> CharacterManager::GetTaggedCharactersOnMap(int mapID, std::stri
 	return output;
 }
 
-std::vector<int> CharacterManager::GetConditionCharactersOnMap(int mapID, std::string condition, bool value)
+std::vector<int> CharacterManager::GetConditionCharactersOnMap(int mapID, int condition, bool value)
 {
+	// one pass over the map and mask columns, no per-character lookups
 	std::vector<int> output;
-	std::vector<int> input = GetCharactersOnMap(mapID);
-	std::vector<int>::iterator it = input.begin();
-
-	while ((it = std::find_if(it, input.end(), [=](int c) {return getCharacterHasCondition(c, condition) == value; })) != input.end())
+	ConditionMask bit = ConditionManager::ConditionBit(condition);
+	ConditionMask wanted = value ? bit : 0;
+	for (int c = 0; c < pcMapID.size(); c++)
 	{
-		output.push_back(*it);
-		// ReSharper disable once CppDiscardedPostfixOperatorResult
-		it++;
+		if (pcMapID[c] == mapID && (pcConditionMasks[c] & bit) == wanted)
+		{
+			output.push_back(c);
+		}
 	}
 	
 	return output;
 }
 
+std::vector<int> CharacterManager::GetConditionCharactersOnMap(int mapID, std::string condition, bool value)
+{
+	return GetConditionCharactersOnMap(mapID, gGame->mConditionManager->GetConditionIndex(condition), value);
+}
+
 std::string CharacterManager::getCharacterDomainAction(int id)
 {
 	return pcDomainAction[id];
@@ -1588,4 +1601,136 @@ void CharacterManager::toggleCharacterTravelMode(int id, std::string mode)
 	{
 		setCharacterTravelMode(id, mode);
 	}
-}
\ No newline at end of file
+}
+
+void CharacterManager::SaveSnapshot(SnapshotWriter& w)
+{
+	w.Section("CHAR");
+	characterIDs.Save(w);
+
+	w.Write(pcCharacteristics);
+	w.Write(pcClass);
+	w.Write(pcTotalHitPoints);
+	w.Write(pcCurrentHitPoints);
+	w.Write(pcLevel);
+	w.Write(pcExperience);
+	w.Write(pcCurrentArmourClass);
+	// symbol ids depend on load order, so the tags go out by name
+	std::vector<std::map<std::string, int>> namedTags(pcTagValues.size());
+	for (size_t c = 0; c < pcTagValues.size(); c++)
+	{
+		for (SymbolID tag = 0; tag < (SymbolID)pcTagValues[c].size(); tag++)
+		{
+			if (pcTagValues[c][tag] != 0)
+				namedTags[c][Symbols().GetName(tag)] = pcTagValues[c][tag];
+		}
+	}
+	w.Write(namedTags);
+	w.Write(pcName);
+
+	w.Write(pcWeaponProficiencies);
+	w.Write(pcArmourProficiencies);
+	w.Write(pcFightingStyles);
+
+	w.Write(pcInventory);
+	w.Write(pcEquipped);
+
+	w.Write(pcXPos);
+	w.Write(pcYPos);
+	w.Write(pcCurrentBehaviour);
+	w.Write(pcMapID);
+	w.Write(pcRemainingCleaves);
+
+	w.Write(pcTravelModes);
+	w.Write(pcDomainAction);
+	w.Write(pcCapabilityFlags);
+	w.Write(pcConditions);
+
+	// mortal wounds point into the MortalWoundManager's loaded data, so they go out as indices into it
+	MortalEffect* first = gGame->mMortalManager->GetMortalEffectFromIndex(0);
+	w.Write((uint64_t)pcMortalWounds.size());
+	for (std::vector<MortalEffect*>& wounds : pcMortalWounds)
+	{
+		std::vector<int> indices;
+		for (MortalEffect* e : wounds)
+		{
+			indices.push_back(e == NULL ? -1 : (int)(e - first));
+		}
+		w.Write(indices);
+	}
+}
+
+bool CharacterManager::LoadSnapshot(SnapshotReader& r)
+{
+	if (!r.Section("CHAR"))
+		return false;
+	characterIDs.Load(r);
+
+	r.Read(pcCharacteristics);
+	r.Read(pcClass);
+	r.Read(pcTotalHitPoints);
+	r.Read(pcCurrentHitPoints);
+	r.Read(pcLevel);
+	r.Read(pcExperience);
+	r.Read(pcCurrentArmourClass);
+	std::vector<std::map<std::string, int>> namedTags;
+	r.Read(namedTags);
+	pcTagValues.assign(namedTags.size(), std::vector<int>());
+	for (size_t c = 0; c < namedTags.size(); c++)
+	{
+		for (const auto& kv : namedTags[c])
+		{
+			SymbolID tag = Symbols().Intern(kv.first);
+			if (tag >= (SymbolID)pcTagValues[c].size())
+				pcTagValues[c].resize(tag + 1, 0);
+			pcTagValues[c][tag] = kv.second;
+		}
+	}
+	r.Read(pcName);
+
+	r.Read(pcWeaponProficiencies);
+	r.Read(pcArmourProficiencies);
+	r.Read(pcFightingStyles);
+
+	r.Read(pcInventory);
+	r.Read(pcEquipped);
+
+	r.Read(pcXPos);
+	r.Read(pcYPos);
+	r.Read(pcCurrentBehaviour);
+	r.Read(pcMapID);
+	r.Read(pcRemainingCleaves);
+
+	r.Read(pcTravelModes);
+	r.Read(pcDomainAction);
+	r.Read(pcCapabilityFlags);
+	r.Read(pcConditions);
+
+	// the load needs the item weights, and the ItemManager loads after us, so that gets recounted the first time it's asked for
+	pcLoadUnits.assign(pcInventory.size(), -1);
+	pcEncumbranceClass.assign(pcInventory.size(), -1);
+	pcSpeed.assign(pcInventory.size(), -1);
+
+	// the masks come from the conditions data, so rebuild rather than store them
+	pcConditionMasks.assign(pcConditions.size(), 0);
+	for (int c = 0; c < pcConditions.size(); c++)
+	{
+		UpdateConditionMask(c);
+	}
+
+	uint64_t count = 0;
+	r.Read(count);
+	pcMortalWounds.clear();
+	for (uint64_t i = 0; i < count && r.Ok(); i++)
+	{
+		std::vector<int> indices;
+		r.Read(indices);
+		pcMortalWounds.emplace_back();
+		for (int index : indices)
+		{
+			pcMortalWounds.back().push_back(index < 0 ? NULL : gGame->mMortalManager->GetMortalEffectFromIndex(index));
+		}
+	}
+
+	return r.Ok();
+}
@@ -1,5 +1,6 @@
 #include "Class.h"
 #include "Game.h"
+#include "DataPack.h"
 #include <string>
 #include <locale>
 
@@ -8,16 +9,13 @@ std::string saveTypes[] = { "PetrificationParalysis","PoisonDeath","BlastBreath"
 
 ClassManager* ClassManager::LoadClasses()
 {
-	gLog->Log("Class Loader", "Started");
+	RCK_LOG_INFO("Class Loader", "Started");
 
 	std::string classFilename = "RCK/scripts/classes.json";
-	std::ifstream is(classFilename);
 
-	ClassManager* output = new ClassManager(jsoncons::decode_json<ClassSet>(is));
+	ClassManager* output = new ClassManager(DataPack::LoadJson<ClassSet>(classFilename));
 
-	is.close();
-
-	gLog->Log("Class Loader", "Decoded " + classFilename);
+	RCK_LOG_INFO("Class Loader", "Decoded " + classFilename);
 	
 	// now for every defined class in the set, load the associated stats CSV
 
@@ -31,14 +29,10 @@ ClassManager* ClassManager::LoadClasses()
 
 		std::string csv_name = "RCK/scripts/" + cl->Name() + "_chart.csv";
 		std::transform(csv_name.begin(), csv_name.end(), csv_name.begin(), ::tolower);
-		std::ifstream csv(csv_name);
-
-		jsoncons::csv::csv_options options;
-		options.assume_header(false);
+		jsoncons::ojson jo;
 
-		if (csv.is_open())
+		if (DataPack::LoadCsv(csv_name, false, jo))
 		{
-			jsoncons::ojson jo = jsoncons::csv::decode_csv<jsoncons::ojson>(csv, options);
 			int rowCount = 1;
 			int size = jo.size() + 2;
 			// quickly push out the size values
@@ -72,8 +66,6 @@ ClassManager* ClassManager::LoadClasses()
 				rowCount++;
 			}
 
-			csv.close();
-
 			// once we've extracted the values, match them to tags and store them
 
 			for (const LevelledChartColumn pair : cl->LevelledChartColumns())
@@ -83,7 +75,17 @@ ClassManager* ClassManager::LoadClasses()
 
 				std::vector<int>& col = bonusMatrix[column];
 
-				cl->LevelTagBonuses[name] = col;
+				// a later column for the same tag replaces the earlier one
+				SymbolID tag = Symbols().Intern(name);
+				auto existing = std::find_if(cl->LevelTagBonuses.begin(), cl->LevelTagBonuses.end(), [tag](const std::pair<SymbolID, std::vector<int>>& p) { return p.first == tag; });
+				if (existing != cl->LevelTagBonuses.end())
+				{
+					existing->second = col;
+				}
+				else
+				{
+					cl->LevelTagBonuses.push_back(std::make_pair(tag, col));
+				}
 			}
 		}
 
@@ -94,6 +96,25 @@ ClassManager* ClassManager::LoadClasses()
 			cl->PrimeReqIdx.push_back(gGame->mCharacterManager->GetStatisticIndex(rq));
 		}
 
+		// levelled abilities become tags, and the capability ones are also collected into flags
+		for (const LevelledAbility& la : cl->LevelledAbilities())
+		{
+			cl->LevelledAbilityTags.push_back(Symbols().Intern(la.Type()));
+
+			const std::string& type = la.Type();
+			if (type.compare(0, 11, "Capability:") == 0)
+			{
+				unsigned long long flag = CharacterManager::CapabilityFromName(type.substr(11));
+				if (flag == 0)
+				{
+					RCK_LOG_WARNING("Class Loader", cl->Name() + " has unknown capability " + type);
+				}
+				cl->CapabilityFlags |= flag;
+			}
+		}
+
+		Symbols().Intern(cl->Name());
+
 		// add this class to the index list
 		output->classLookup[cl->Name()] = i;
 	}
@@ -101,7 +122,19 @@ ClassManager* ClassManager::LoadClasses()
 	output->advancementStore = new AdvancementStore();
 	output->advancementStore->LoadAdvancementSets();
 
-	gLog->Log("Class Loader", "Completed");
+	// now the progressions are loaded, point each class at its own
+	for (int i = 0; i < classList.size(); i++)
+	{
+		ACKSClass* cl = (ACKSClass*)&classList[i];
+		cl->AttackProgressionIdx = output->advancementStore->GetProgressionIndex(cl->AttackProgression());
+		cl->SaveProgressionIdx = output->advancementStore->GetProgressionIndex(cl->SaveProgression());
+		if (cl->AttackProgressionIdx == -1 || cl->SaveProgressionIdx == -1)
+		{
+			RCK_LOG_ERROR("Class Loader", cl->Name() + " has a progression that isn't in advancement.csv");
+		}
+	}
+
+	RCK_LOG_INFO("Class Loader", "Completed");
 	
 	return output;
 }
@@ -121,14 +154,11 @@ void AdvancementStore::LoadAdvancementSets()
 	std::vector<std::vector<int>> columnValues;
 	
 	std::string csv_name = "RCK/scripts/advancement.csv";
-	std::ifstream csv(csv_name);
+	jsoncons::ojson jo;
 
-	jsoncons::csv::csv_options options;
-	options.assume_header(false); // we have a header - but we want to read it
-
-	if (csv.is_open())
+	// we have a header - but we want to read it, so don't treat it as one
+	if (DataPack::LoadCsv(csv_name, false, jo))
 	{
-		jsoncons::ojson jo = jsoncons::csv::decode_csv<jsoncons::ojson>(csv, options);
 		int rowCount = -1;
 
 		for (const auto& row : jo.array_range())
@@ -159,51 +189,69 @@ void AdvancementStore::LoadAdvancementSets()
 			
 			rowCount++;
 		}
-		csv.close();
 	}
 
-	// re-sort into the map
+	// re-sort into the tables
 	// and open the save advancement charts for each
 	//
 
+	ProgressionNames = columnNames;
+	AttackBonuses.resize(columnNames.size());
+	for (int j = 0; j < SAVE_MAX; j++)
+	{
+		Saves[j].resize(columnNames.size());
+	}
+
 	for (int i = 0; i < columnNames.size(); i++)
 	{
 		std::string name = columnNames[i];
 		std::vector<int>& colArray = columnValues[i];
 
-		AttackBonusLookup[name] = colArray;
+		AttackBonuses[i] = colArray;
 		// skip Monsters (they have a save derived from a base class)
-		if (i != 0)
+		if (i != MONSTER_PROGRESSION)
 		{
 			std::string adv_csv_name = "RCK/scripts/" + name + "_advancement.csv";
 			std::transform(adv_csv_name.begin(), adv_csv_name.end(), adv_csv_name.begin(), ::tolower);
-			std::ifstream adv_csv(adv_csv_name);
-
-			jsoncons::csv::csv_options options;
-			options.assume_header(true);
-
-			for (int j = 0; j < 5; j++)
+			for (int j = 0; j < SAVE_MAX; j++)
 			{
-				SaveLookup[saveTypes[j]][name].resize(15);
+				Saves[j][i].resize(15);
 			}
 
-			if (adv_csv.is_open())
+			jsoncons::ojson jo;
+			if (DataPack::LoadCsv(adv_csv_name, true, jo))
 			{
-				jsoncons::ojson jo = jsoncons::csv::decode_csv<jsoncons::ojson>(adv_csv, options);
 				int rowCount = 0;
 				int size = jo.size() + 1;
 
 				for (const auto& row : jo.array_range())
 				{
-					for (int j = 0; j < 5; j++)
+					for (int j = 0; j < SAVE_MAX; j++)
 					{
-						SaveLookup[saveTypes[j]][name][rowCount] = row[saveTypes[j]].as<int>();
+						Saves[j][i][rowCount] = row[saveTypes[j]].as<int>();
 					}
 					rowCount++;
 				}
-
-				adv_csv.close();
 			}
 		}
 	}
 }
+
+int AdvancementStore::GetProgressionIndex(const std::string& name) const
+{
+	for (int i = 0; i < ProgressionNames.size(); i++)
+	{
+		if (ProgressionNames[i] == name)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+const std::vector<int>& AdvancementStore::GetAttackBonuses(const std::string& progression) const
+{
+	static const std::vector<int> none;
+	int index = GetProgressionIndex(progression);
+	return index != -1 ? AttackBonuses[index] : none;
+}
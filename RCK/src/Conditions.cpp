@@ -1,15 +1,16 @@
 #include "Conditions.h"
+#include "Character.h"
+#include "DataPack.h"
 
 ConditionManager* ConditionManager::LoadConditions()
 {
-	gLog->Log("Condition Loader", "Started");
+	RCK_LOG_INFO("Condition Loader", "Started");
 	
 	std::string conditionsFilename = "RCK/scripts/conditions.json";
-	std::ifstream is(conditionsFilename);
 
-	ConditionManager* cm = new ConditionManager(jsoncons::decode_json<ConditionData>(is));
+	ConditionManager* cm = new ConditionManager(DataPack::LoadJson<ConditionData>(conditionsFilename));
 
-	gLog->Log("Condition Loader", "Decoded " + conditionsFilename);
+	RCK_LOG_INFO("Condition Loader", "Decoded " + conditionsFilename);
 
 	int nextConditionIndex = 0;
 
@@ -43,49 +44,92 @@ ConditionManager* ConditionManager::LoadConditions()
 		std::vector<int> conditionIndicies;
 		for(std::string included_condition : c.Includes())
 		{
-			conditionIndicies.push_back(cm->GetConditionIndex(included_condition));
+			int index = cm->GetConditionIndex(included_condition);
+			if (index < 0)
+			{
+				RCK_LOG_WARNING("Condition Loader", c.Name() + " includes unknown condition " + included_condition);
+				continue;
+			}
+			conditionIndicies.push_back(index);
 		}
 		cm->Includes.push_back(conditionIndicies);
 	}
 
-	gLog->Log("Condition Loader", "Completed");
+	if (cm->Names.size() > CONDITION_MASK_BITS)
+	{
+		RCK_LOG_ERROR("Condition Loader", "More than " + std::to_string(CONDITION_MASK_BITS) + " conditions, the extra ones can't be held");
+	}
+
+	// close the includes: keep folding in the includes of everything already in the mask until nothing changes.
+	// Iterating to a fixed point rather than recursing means a loop in the data (A includes B includes A) is harmless.
+	for (int i = 0; i < cm->Includes.size(); i++)
+	{
+		ConditionMask closure = ConditionBit(i);
+		ConditionMask previous = 0;
+		while (closure != previous)
+		{
+			previous = closure;
+			for (int j = 0; j < cm->Includes.size(); j++)
+			{
+				if (MaskHasCondition(closure, j))
+				{
+					for (int included : cm->Includes[j])
+					{
+						closure |= ConditionBit(included);
+					}
+				}
+			}
+		}
+		cm->Closures.push_back(closure);
+	}
+
+	cm->UnconsciousIndex = cm->GetConditionIndex("Unconscious");
+	if (cm->UnconsciousIndex < 0)
+	{
+		RCK_LOG_ERROR("Condition Loader", "There's no Unconscious condition");
+	}
+
+	RCK_LOG_INFO("Condition Loader", "Completed");
 	
 	return cm;
 }
 
 bool ConditionManager::HasCondition(std::vector<int>& conditions, int findVal)
 {
-	if (std::find(conditions.begin(), conditions.end(), findVal) != conditions.end())
+	return MaskHasCondition(ExpandConditions(conditions), findVal);
+}
+
+ConditionMask ConditionManager::ExpandConditions(const std::vector<int>& held) const
+{
+	ConditionMask expanded = 0;
+	for (int condition : held)
 	{
-		// we found it in the basic list, so
-		return true;
+		if (condition >= 0 && condition < Closures.size())
+			expanded |= Closures[condition];
 	}
+	return expanded;
+}
 
-	// for every condition we actually have, check what is included in it
-	for (int condIndex : conditions)
+ConditionMask ConditionManager::ExpandConditions(const std::vector<std::pair<int, int>>& held) const
+{
+	ConditionMask expanded = 0;
+	for (const std::pair<int, int>& condition : held)
 	{
-		std::vector<int>& included = Includes[condIndex];
-		if (std::find(included.begin(), included.end(), findVal) != included.end())
-		{
-			// we found it in the derived list, so
-			return true;
-		}
+		if (condition.first >= 0 && condition.first < Closures.size())
+			expanded |= Closures[condition.first];
 	}
-
-	// didn't find it in the base or derived lists, so
-	return false;
+	return expanded;
 }
 
 MortalWoundManager* MortalWoundManager::LoadMortalWoundData()
 {
-	gLog->Log("Mortal Loader", "Started");
+	RCK_LOG_INFO("Mortal Loader", "Started");
 	
 	std::string mortalFilename = "RCK/scripts/mortal_wound_effects.json";
-	std::ifstream is(mortalFilename);
 
-	MortalWoundManager* mwm = new MortalWoundManager(jsoncons::decode_json<MortalWoundData>(is));
+	MortalWoundManager* mwm = new MortalWoundManager(DataPack::LoadJson<MortalWoundData>(mortalFilename));
 
-	gLog->Log("Mortal Loader", "Decoded " + mortalFilename);
+	RCK_LOG_INFO("Mortal Loader", "Decoded " + mortalFilename);
 	
 	int nextMortalWoundIndex = 0;
 
@@ -111,6 +155,24 @@ MortalWoundManager* MortalWoundManager::LoadMortalWoundData()
 		mwm->CodeLookup[m.Code()] = nextMortalWoundIndex++;
 	}
 
+	// resolve the penalties, so applying a wound doesn't have to look at any names
+
+	for (MortalEffect& m : mwm->mwd.MortalEffects_NC())
+	{
+		for (SpecialPenalty p : m.SpecialPenalties())
+		{
+			std::string name = p.Name();
+			if (name.compare(0, 11, "Capability:") == 0)
+			{
+				m.PenaltyCapabilities |= CharacterManager::CapabilityFromName(name.substr(11));
+			}
+			else
+			{
+				m.PenaltyTags.push_back(std::make_pair(Symbols().Intern(name), p.Value()));
+			}
+		}
+	}
+
 	// now we've set all the the mortal wounds up we can translate the DoubleTo strings into indices.
 
 	for (MortalEffect m : mwm->mwd.MortalEffects_NC())
@@ -123,19 +185,19 @@ MortalWoundManager* MortalWoundManager::LoadMortalWoundData()
 
 	mwm->mortalstore.LoadMortalRollStore();
 
-	gLog->Log("Mortal Loader", "Completed");
+	RCK_LOG_INFO("Mortal Loader", "Completed");
 
 	return mwm;
 }
 
 void MortalWoundManager::DebugLog(std::string message)
 {
-	gLog->Log("Mortal Wound Manager", message);
+	DEBUG_LOG(message);
 }
 
 void ConditionManager::DebugLog(std::string message)
 {
-	gLog->Log("Condition Manager", message);
+	DEBUG_LOG(message);
 }
 
 void MortalRollStore::LoadMortalRollStore()
@@ -143,14 +205,10 @@ void MortalRollStore::LoadMortalRollStore()
 	std::vector<std::vector<std::string>> columnValues;
 
 	std::string csv_name = "RCK/scripts/mortal_wounds.csv";
-	std::ifstream csv(csv_name);
+	jsoncons::ojson jo;
 
-	jsoncons::csv::csv_options options;
-	options.assume_header(false); // we have no header
-
-	if (csv.is_open())
+	if (DataPack::LoadCsv(csv_name, false, jo)) // we have no header
 	{
-		jsoncons::ojson jo = jsoncons::csv::decode_csv<jsoncons::ojson>(csv, options);
 		int rowCount = 0;
 		int size = jo.size();
 
@@ -169,8 +227,6 @@ void MortalRollStore::LoadMortalRollStore()
 			results.push_back(effects);
 			rowCount++;
 		}
-
-		csv.close();
 	}
 }
 
@@ -0,0 +1,365 @@
+#include "DataPack.h"
+#include "Game.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <sys/stat.h>
+
+const char* DataPack::DEFAULT_PACK = "RCK/scripts/data.pack";
+
+static const std::string dataDirectory = "RCK/scripts/";
+
+// the fixed-name files the loaders read from the scripts directory. The per-class and per-progression ones are found from these.
+static const char* scriptSources[] = {
+	"statistics.json", "ability_bonus.csv", "ability_prime_req.csv", "classes.json", "advancement.csv", "conditions.json",
+	"mortal_wound_effects.json", "mortal_wounds.csv", "ranges.csv", "equipment.json", "decoration.json", "creatures.json", "bases.json"
+};
+
+// data that lives outside the scripts directory
+static const char* extraSources[] = { "RCK/prefabs/maps.json" };
+
+static std::string PackKey(std::string filename)
+{
+	// the loaders build some names from data (class names etc), so don't let case decide whether we find them
+	std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
+	return filename;
+}
+
+static bool EndsWith(const std::string& s, const std::string& ending)
+{
+	return s.size() >= ending.size() && s.compare(s.size() - ending.size(), ending.size(), ending) == 0;
+}
+
+int64_t DataPack::GetModifiedTime(const std::string& filename)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return -1;
+	return (int64_t)st.st_mtime;
+}
+
+bool DataPack::Open(std::string filename)
+{
+	entries.clear();
+	staleCount = 0;
+
+	SnapshotReader r;
+	if (!r.LoadFromFile(filename))
+		return false;
+
+	uint32_t version = 0;
+	uint64_t count = 0;
+	r.Section("PACK");
+	r.Read(version);
+	r.Read(count);
+	if (!r.Ok() || version != DATA_PACK_VERSION)
+	{
+		RCK_LOG_WARNING("Data Pack", filename + " is from a different version, ignoring it");
+		return false;
+	}
+
+	for (uint64_t i = 0; i < count && r.Ok(); i++)
+	{
+		std::string name;
+		r.Read(name);
+		DataPackEntry& entry = entries[name];
+		r.Read(entry.sourceTime);
+		r.Read(entry.cbor);
+	}
+
+	if (!r.Ok() || !r.AtEnd())
+	{
+		RCK_LOG_WARNING("Data Pack", filename + " is damaged, ignoring it");
+		entries.clear();
+		return false;
+	}
+
+	RCK_LOG_INFO("Data Pack", "Opened " + filename + " (" + std::to_string(entries.size()) + " files)");
+	return true;
+}
+
+const std::vector<uint8_t>* DataPack::Find(const std::string& source)
+{
+	auto it = entries.find(PackKey(source));
+	if (it == entries.end())
+		return NULL;
+
+	// a missing source is fine (a mod can ship just the pack), an edited one means the pack is out of date
+	int64_t modified = GetModifiedTime(source);
+	if (modified > it->second.sourceTime)
+	{
+		RCK_LOG_INFO("Data Pack", source + " has changed since the pack was built, reading the text");
+		staleCount++;
+		return NULL;
+	}
+
+	return &it->second.cbor;
+}
+
+const std::vector<uint8_t>* DataPack::FindLoaded(const std::string& filename)
+{
+	if (gGame == NULL || gGame->mDataPack == NULL)
+		return NULL;
+	return gGame->mDataPack->Find(filename);
+}
+
+static jsoncons::ojson HeaderRowsToObjects(const jsoncons::ojson& rows)
+{
+	// the pack always keeps the raw rows - this turns them into what decode_csv gives with assume_header(true)
+	jsoncons::ojson out = jsoncons::ojson::array();
+	if (rows.size() == 0)
+		return out;
+
+	const jsoncons::ojson& header = rows[0];
+	out.reserve(rows.size() - 1);
+	for (size_t i = 1; i < rows.size(); i++)
+	{
+		const jsoncons::ojson& row = rows[i];
+		jsoncons::ojson obj;
+		for (size_t col = 0; col < header.size() && col < row.size(); col++)
+		{
+			obj.insert_or_assign(header[col].as<std::string>(), row[col]);
+		}
+		out.push_back(std::move(obj));
+	}
+	return out;
+}
+
+bool DataPack::LoadCsv(const std::string& filename, bool header, jsoncons::ojson& out)
+{
+	const std::vector<uint8_t>* compiled = FindLoaded(filename);
+	if (compiled != NULL)
+	{
+		jsoncons::ojson rows = jsoncons::cbor::decode_cbor<jsoncons::ojson>(*compiled);
+		out = header ? HeaderRowsToObjects(rows) : std::move(rows);
+		return true;
+	}
+
+	std::ifstream is(filename);
+	if (!is.is_open())
+	{
+		out = jsoncons::ojson::array();
+		return false;
+	}
+
+	jsoncons::csv::csv_options options;
+	options.assume_header(header);
+	out = jsoncons::csv::decode_csv<jsoncons::ojson>(is, options);
+	return true;
+}
+
+static bool CheckReferences(const std::unordered_map<std::string, jsoncons::ojson>& documents)
+{
+	// the loaders skip anything they can't find, which makes a typo in the data very quiet. Catch those here instead.
+	int problems = 0;
+	auto report = [&problems](const std::string& message)
+	{
+		RCK_LOG_ERROR("Data Compiler", message);
+		printf("%s\n", message.c_str());
+		problems++;
+	};
+	auto has = [&documents](const std::string& filename) { return documents.count(PackKey(filename)) > 0; };
+
+	std::set<std::string> statistics;
+	auto stats = documents.find(PackKey(dataDirectory + "statistics.json"));
+	if (stats != documents.end())
+	{
+		for (const auto& s : stats->second["statistics"].array_range())
+			statistics.insert(s["name"].as<std::string>());
+	}
+
+	// advancement.csv's header names the attack progressions, and each of them (bar Monster) has a save table
+	std::set<std::string> progressions;
+	auto advancement = documents.find(PackKey(dataDirectory + "advancement.csv"));
+	if (advancement == documents.end() || advancement->second.size() == 0)
+	{
+		report("advancement.csv is missing or empty");
+	}
+	else
+	{
+		const jsoncons::ojson& header = advancement->second[0];
+		for (size_t i = 1; i < header.size(); i++)
+		{
+			std::string name = header[i].as<std::string>();
+			progressions.insert(name);
+			if (i > 1 && !has(dataDirectory + name + "_advancement.csv"))
+				report("advancement.csv lists " + name + " but there's no " + PackKey(name) + "_advancement.csv");
+		}
+	}
+
+	auto classes = documents.find(PackKey(dataDirectory + "classes.json"));
+	if (classes == documents.end())
+	{
+		report("classes.json is missing");
+	}
+	else
+	{
+		for (const auto& cl : classes->second["Classes"].array_range())
+		{
+			std::string name = cl["Name"].as<std::string>();
+			if (!has(dataDirectory + name + "_chart.csv"))
+				report("class " + name + " has no " + PackKey(name) + "_chart.csv");
+			for (const auto& rq : cl["PrimeRequisites"].array_range())
+			{
+				if (statistics.count(rq.as<std::string>()) == 0)
+					report("class " + name + " prime requisite " + rq.as<std::string>() + " isn't a statistic");
+			}
+			if (progressions.count(cl["AttackProgression"].as<std::string>()) == 0)
+				report("class " + name + " attack progression " + cl["AttackProgression"].as<std::string>() + " isn't in advancement.csv");
+			if (progressions.count(cl["SaveProgression"].as<std::string>()) == 0)
+				report("class " + name + " save progression " + cl["SaveProgression"].as<std::string>() + " isn't in advancement.csv");
+		}
+	}
+
+	return problems == 0;
+}
+
+bool DataPack::Compile(std::string packFilename)
+{
+	// parse everything first, so one bad file is reported before we write anything
+	std::vector<std::string> sources;
+	std::unordered_map<std::string, jsoncons::ojson> documents;
+	bool parsed = true;
+	auto parse = [&sources, &documents, &parsed](const std::string& source)
+	{
+		sources.push_back(source);
+		try
+		{
+			std::ifstream is(source);
+			if (!is.is_open())
+			{
+				RCK_LOG_ERROR("Data Compiler", "Couldn't open " + source);
+				parsed = false;
+				return;
+			}
+
+			if (EndsWith(PackKey(source), ".csv"))
+			{
+				jsoncons::csv::csv_options options;
+				options.assume_header(false);
+				documents[PackKey(source)] = jsoncons::csv::decode_csv<jsoncons::ojson>(is, options);
+			}
+			else
+			{
+				documents[PackKey(source)] = jsoncons::decode_json<jsoncons::ojson>(is);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			RCK_LOG_ERROR("Data Compiler", source + ": " + e.what());
+			printf("%s: %s\n", source.c_str(), e.what());
+			parsed = false;
+		}
+	};
+
+	for (const char* file : scriptSources)
+		parse(dataDirectory + file);
+	for (const char* extra : extraSources)
+		parse(extra);
+
+	// the class loader builds the rest of its filenames from the data, so follow the same references. Anything missing is left for
+	// CheckReferences to report by name.
+	auto derived = [&parse](const std::string& name, const std::string& suffix)
+	{
+		std::string source = dataDirectory + PackKey(name + suffix);
+		if (DataPack::GetModifiedTime(source) >= 0)
+			parse(source);
+	};
+	auto advancement = documents.find(PackKey(dataDirectory + "advancement.csv"));
+	if (advancement != documents.end() && advancement->second.size() > 0)
+	{
+		const jsoncons::ojson& header = advancement->second[0];
+		for (size_t i = 2; i < header.size(); i++)
+			derived(header[i].as<std::string>(), "_advancement.csv");
+	}
+	auto classes = documents.find(PackKey(dataDirectory + "classes.json"));
+	if (classes != documents.end())
+	{
+		// copied, as parsing more files can rehash the map out from under the iterator
+		jsoncons::ojson classList = classes->second["Classes"];
+		for (const auto& cl : classList.array_range())
+			derived(cl["Name"].as<std::string>(), "_chart.csv");
+	}
+
+	if (!parsed || !CheckReferences(documents))
+		return false;
+
+	SnapshotWriter w;
+	w.Section("PACK");
+	w.Write(DATA_PACK_VERSION);
+	w.Write((uint64_t)sources.size());
+	for (const std::string& source : sources)
+	{
+		std::vector<uint8_t> cbor;
+		jsoncons::cbor::encode_cbor(documents[PackKey(source)], cbor);
+
+		w.Write(PackKey(source));
+		w.Write(GetModifiedTime(source));
+		w.Write(cbor);
+	}
+
+	if (!w.SaveToFile(packFilename, false))
+	{
+		RCK_LOG_ERROR("Data Compiler", "Couldn't write " + packFilename);
+		return false;
+	}
+
+	// last check: the real loaders have to be happy with it, typed Sets and all
+	gGame->mDataPack = new DataPack();
+	if (!gGame->mDataPack->Open(packFilename))
+		return false;
+	try
+	{
+		gGame->StartGame();
+	}
+	catch (const std::exception& e)
+	{
+		RCK_LOG_ERROR("Data Compiler", std::string("The game couldn't load the pack: ") + e.what());
+		printf("The game couldn't load the pack: %s\n", e.what());
+		return false;
+	}
+
+	ReportLine("Data Compiler", "Compiled %d data files into %s (%zu bytes)", (int)sources.size(), packFilename.c_str(), w.Size());
+	return true;
+}
+
+void DataPack::BenchmarkStartup(int repeats)
+{
+	// StartGame from the text files (an empty pack), then from the default pack, each with the loaders on one thread and then on
+	// all of them. The managers from each run are simply leaked, it's a benchmark and we exit straight after.
+	typedef std::chrono::high_resolution_clock clock;
+
+	for (int pass = 0; pass < 4; pass++)
+	{
+		bool fromPack = pass >= 2;
+		int threads = pass % 2 == 0 ? 1 : 0;
+		gGame->SetLoaderThreads(threads);
+		double best = 0.0;
+		double total = 0.0;
+		for (int i = 0; i < repeats; i++)
+		{
+			// with no pack set StartGame opens the default one, so reading the pack is part of the time
+			delete gGame->mDataPack;
+			gGame->mDataPack = fromPack ? NULL : new DataPack();
+
+			clock::time_point start = clock::now();
+			gGame->StartGame();
+			double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+			if (fromPack && gGame->mDataPack == NULL)
+			{
+				printf("no data pack at %s - build one with -compile-data\n", DEFAULT_PACK);
+				return;
+			}
+
+			total += ms;
+			if (i == 0 || ms < best)
+				best = ms;
+		}
+
+		ReportLine("Data Pack", "StartGame from %s, %s: best %.2fms, average %.2fms over %d runs", fromPack ? "data pack" : "text files",
+			threads == 1 ? "one thread" : "parallel loaders", best, total / repeats, repeats);
+	}
+}
@@ -1,4 +1,11 @@
 #include "Game.h"
+#include "Journal.h"
+#include "DataPack.h"
+#include "ParallelLoader.h"
+#include "Snapshot.h"
+#include "JobSystem.h"
+#include "libtcod/libtcod_int.h"
+#include <chrono>
 
 Game* gGame;
 
@@ -9,27 +16,264 @@ void Game::StartGame()
 	
 	// create game managers
 
-	DebugLog("Starting Game");
+	DEBUG_LOG("Starting Game");
+	RCK_LOG_INFO(LogCategory, "Random seed " + std::to_string(randomSeed));
+
+	// use the precompiled scripts if they've been built - the loaders fall back to the text files for anything not in there
+	if (mDataPack == nullptr)
+	{
+		mDataPack = new DataPack();
+		if (!mDataPack->Open(DataPack::DEFAULT_PACK))
+		{
+			delete mDataPack;
+			mDataPack = nullptr;
+		}
+	}
 	
-	mCharacterManager = CharacterManager::LoadCharacteristics();
-	mClassManager = ClassManager::LoadClasses();
-	mMapManager = MapManager::LoadMaps();
-	mTimeManager = new TimeManager();
-	gLog->Log("Time Manager", "Started");
-	mItemManager = ItemManager::LoadItemTemplates();
-	mMobManager = MobManager::LoadMobData();
-	mConditionManager = ConditionManager::LoadConditions();
-	mMortalManager = MortalWoundManager::LoadMortalWoundData();
-	mPartyManager = PartyManager::LoadPartyData();
-	mBaseManager = BaseManager::LoadBaseData();
-
-	DebugLog("Game Managers Created");
+	// the loaders are independent file reads apart from the classes, which need the statistics from the CharacterManager,
+	// so they run side by side and we wait for the lot before going on
+	ParallelLoader loader;
+	int characters = loader.Add("Characteristics", [this]() { mCharacterManager = CharacterManager::LoadCharacteristics(); });
+	loader.Add("Classes", [this]() { mClassManager = ClassManager::LoadClasses(); }, { characters });
+	loader.Add("Maps", [this]() { mMapManager = MapManager::LoadMaps(); });
+	loader.Add("Time", [this]() { mTimeManager = new TimeManager(); RCK_LOG_INFO("Time Manager", "Started"); });
+	loader.Add("Items", [this]() { mItemManager = ItemManager::LoadItemTemplates(); });
+	loader.Add("Monsters", [this]() { mMobManager = MobManager::LoadMobData(); });
+	loader.Add("Conditions", [this]() { mConditionManager = ConditionManager::LoadConditions(); });
+	loader.Add("Mortal Wounds", [this]() { mMortalManager = MortalWoundManager::LoadMortalWoundData(); });
+	loader.Add("Parties", [this]() { mPartyManager = PartyManager::LoadPartyData(); });
+	loader.Add("Bases", [this]() { mBaseManager = BaseManager::LoadBaseData(); });
+	loader.Run(loaderThreads);
+
+	for (const std::string& line : loader.Report())
+	{
+		RCK_LOG_INFO("Loader", line);
+	}
+
+	DEBUG_LOG("Game Managers Created");
+
+	if (mJobs == nullptr)
+	{
+		mJobs = new JobSystem(workerThreads);
+		RCK_LOG_INFO(LogCategory, "Job system has " + std::to_string(mJobs->GetThreadCount()) + " threads");
+	}
 
 	CreateMenu();
 	
 	mode = GM_MENU;
 }
 
+void Game::SetWorkerThreads(int threads)
+{
+	workerThreads = threads;
+	if (mJobs != nullptr)
+	{
+		delete mJobs;
+		mJobs = new JobSystem(workerThreads);
+	}
+}
+
+void Game::SeedRandom(uint32_t seed)
+{
+	// the shared TCODRandom instance seeds itself from the clock, so swap in our own. Reseeding replaces the last one we made.
+	randomSeed = seed;
+	seededRandomiser.reset(new TCODRandom(seed, TCOD_RNG_CMWC));
+	randomiser = seededRandomiser.get();
+}
+
+uint64_t Game::StateHash()
+{
+	// FNV-1a over the bits of the game state a divergent replay would show up in first: the clock, where everyone is and how hurt they are,
+	// and where the random number generator has got to.
+	uint64_t h = 14695981039346656037ULL;
+	auto mix = [&h](int64_t value)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			h ^= (uint64_t)(value >> (i * 8)) & 0xff;
+			h *= 1099511628211ULL;
+		}
+	};
+
+	mix((int64_t)(mTimeManager->GetRunningTime() * 1000.0L));
+	mix(mode);
+	mix(currentMapID);
+	mix(currentCharacterID);
+
+	for (int i = 0; i < mCharacterManager->GetCharacterCount(); i++)
+	{
+		mix(mCharacterManager->GetPlayerMap(i));
+		mix(mCharacterManager->GetPlayerX(i));
+		mix(mCharacterManager->GetPlayerY(i));
+		mix(mCharacterManager->getCharacterCurrentHitPoints(i));
+	}
+
+	// monster 0 is the empty placeholder
+	for (int i = 1; i < mMobManager->GetMonsterCount(); i++)
+	{
+		if (!mMobManager->MonsterExists(i))
+			continue;
+		mix(mMobManager->GetMobX(i));
+		mix(mMobManager->GetMobY(i));
+		mix(mMobManager->GetMonster(i).GetHitPoints());
+	}
+
+	// peek at the next number from a copy, so taking the hash doesn't change the sequence
+	TCODRandom* peek = randomiser->save();
+	mix(peek->getInt(0, 0x7fffffff));
+	delete peek;
+
+	return h;
+}
+
+bool Game::SaveSnapshot(std::string filename, bool compress)
+{
+	SnapshotWriter w;
+
+	w.Section("GAME");
+	w.Write(currentPartyID);
+	w.Write(currentCharacterID);
+	w.Write(currentMapID);
+	w.Write(currentBaseID);
+	w.Write(mode);
+	w.Write(charactersFallen);
+	w.Write(characterDeaths);
+	w.Write(mobsFallen);
+	w.Write(randomSeed);
+	// the whole generator state, so a loaded game rolls the same dice the saved one would have
+	w.Bytes(randomiser->get_data(), sizeof(TCOD_Random));
+
+	mTimeManager->SaveSnapshot(w);
+	mMapManager->SaveSnapshot(w);
+	mCharacterManager->SaveSnapshot(w);
+	mMobManager->SaveSnapshot(w);
+	mItemManager->SaveSnapshot(w);
+	mPartyManager->SaveSnapshot(w);
+	mBaseManager->SaveSnapshot(w);
+
+	if (!w.SaveToFile(filename, compress))
+	{
+		RCK_LOG_ERROR(LogCategory, "Couldn't write snapshot " + filename);
+		return false;
+	}
+
+	RCK_LOG_INFO(LogCategory, "Saved snapshot " + filename + " (" + std::to_string(w.Size()) + " bytes before compression)");
+	return true;
+}
+
+bool Game::LoadSnapshot(std::string filename)
+{
+	SnapshotReader r;
+	if (!r.LoadFromFile(filename))
+	{
+		RCK_LOG_ERROR(LogCategory, "Couldn't read snapshot " + filename);
+		return false;
+	}
+
+	// if any section fails, the game is half loaded, so there's no point going on
+	bool ok = r.Section("GAME");
+	r.Read(currentPartyID);
+	r.Read(currentCharacterID);
+	r.Read(currentMapID);
+	r.Read(currentBaseID);
+	r.Read(mode);
+	r.Read(charactersFallen);
+	r.Read(characterDeaths);
+	r.Read(mobsFallen);
+	r.Read(randomSeed);
+	r.Bytes(randomiser->get_data(), sizeof(TCOD_Random));
+
+	ok = ok && r.Ok()
+		&& mTimeManager->LoadSnapshot(r)
+		&& mMapManager->LoadSnapshot(r)
+		&& mCharacterManager->LoadSnapshot(r)
+		&& mMobManager->LoadSnapshot(r)
+		&& mItemManager->LoadSnapshot(r)
+		&& mPartyManager->LoadSnapshot(r)
+		&& mBaseManager->LoadSnapshot(r)
+		&& r.AtEnd();
+
+	if (!ok)
+	{
+		RCK_LOG_ERROR(LogCategory, "Snapshot " + filename + " is damaged or from a different version");
+		return false;
+	}
+
+	currentMap = currentMapID > 0 ? mMapManager->getMap(currentMapID) : NULL;
+	recomputeFov = true;
+
+	RCK_LOG_INFO(LogCategory, "Loaded snapshot " + filename);
+	return true;
+}
+
+void Game::BenchmarkSnapshot(int entityCount)
+{
+	// Needs the managers loaded (StartGame) but no window. After each save we add some extra monsters, so the hash after loading
+	// only matches if the load really did replace everything.
+	typedef std::chrono::high_resolution_clock clock;
+
+	auto ms = [](clock::time_point start, clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+
+	// character 0 is the "nobody" character, same as the test game
+	mCharacterManager->GenerateTestCharacter("NULL", "Fighter");
+	currentPartyID = mPartyManager->GenerateAITestParty();
+	currentCharacterID = mPartyManager->getNextPlayerCharacter(currentPartyID);
+
+	const int size = 1000;
+	int mapID = mMapManager->buildEmptyMap(size, size, MAP_DUNGEON);
+	currentMapID = mapID;
+	currentMap = mMapManager->getMap(mapID);
+	mCharacterManager->SetPlayerMap(currentCharacterID, mapID);
+	currentMap->setCharacter(0, 0, currentCharacterID);
+
+	for (int i = 0; i < entityCount; i++)
+	{
+		mMobManager->GenerateMonster("Goblin", mapID, randomiser->getInt(0, size - 1), randomiser->getInt(0, size - 1));
+	}
+	mode = GM_MAIN;
+
+	uint64_t hash = StateHash();
+
+	const std::string rawFile = "snapshot_benchmark.rck";
+	const std::string packedFile = "snapshot_benchmark_z.rck";
+	for (int pass = 0; pass < 2; pass++)
+	{
+		bool compress = pass == 1;
+		const std::string& filename = compress ? packedFile : rawFile;
+
+		clock::time_point start = clock::now();
+		bool saved = SaveSnapshot(filename, compress);
+		double saveTime = ms(start, clock::now());
+
+		for (int i = 0; i < 100; i++)
+		{
+			mMobManager->GenerateMonster("Goblin", mapID, randomiser->getInt(0, size - 1), randomiser->getInt(0, size - 1));
+		}
+
+		start = clock::now();
+		bool loaded = saved && LoadSnapshot(filename);
+		double loadTime = ms(start, clock::now());
+
+		long fileSize = 0;
+		FILE* f = fopen(filename.c_str(), "rb");
+		if (f != NULL)
+		{
+			fseek(f, 0, SEEK_END);
+			fileSize = ftell(f);
+			fclose(f);
+		}
+
+		ReportLine(LogCategory, "%d monsters, %s: save %.1fms, load %.1fms, %ld bytes, state %s",
+			entityCount, compress ? "zlib" : "raw", saveTime, loadTime, fileSize, !loaded ? "NOT LOADED" : (StateHash() == hash ? "matches" : "DIFFERS"));
+	}
+
+	remove(rawFile.c_str());
+	remove(packedFile.c_str());
+}
+
 void Game::QuitGame()
 {
 	mode = GM_QUIT;
@@ -48,7 +292,7 @@ void Game::CreateMenu()
 
 void Game::CreateTestGame()
 {
-	DebugLog("Creating Test Game");
+	DEBUG_LOG("Creating Test Game");
 
 	// starting character to make numbers match (0 = false, 0 = no character on map)
 	mCharacterManager->GenerateTestCharacter("NULL", "Fighter");
@@ -145,9 +389,9 @@ void Game::CreateTestGame()
 
 	MortalRollResult* result = mMortalManager->RollMortalWound(d20_roll, d6_roll);
 
-	DebugLog("Test Mortal Wound:");
-	DebugLog("D20/D6:" + std::to_string(d20_roll) + "/" + std::to_string(d6_roll));
-	DebugLog("Results:" + result->effect->PlayerText());
+	DEBUG_LOG("Test Mortal Wound:");
+	DEBUG_LOG("D20/D6:" + std::to_string(d20_roll) + "/" + std::to_string(d6_roll));
+	DEBUG_LOG("Results:" + result->effect->PlayerText());
 
 	delete result;
 
@@ -159,17 +403,43 @@ void Game::ClearGame()
 	
 }
 
+void Game::LiftPartyOffMap()
+{
+	// the PCs, henches and animals of the current party, as placed by SpawnLevel. They're left on no map until the next SpawnLevel.
+	std::vector<int> leaving = mPartyManager->getPlayerCharacters(currentPartyID);
+	std::vector<int> henches = mPartyManager->getHenchmen(currentPartyID);
+	leaving.insert(leaving.end(), henches.begin(), henches.end());
+	for (int c : leaving)
+	{
+		if (mCharacterManager->GetPlayerMap(c) == currentMapID)
+		{
+			currentMap->removeCharacter(c);
+			mCharacterManager->SetPlayerMap(c, -1);
+		}
+	}
+
+	for (int a : mPartyManager->getAnimals(currentPartyID))
+	{
+		if (mMobManager->GetMobMap(a) == currentMapID)
+		{
+			currentMap->removeMob(a);
+			mTimeManager->DeregisterEntity(a, MANAGER_MOB);
+			mMobManager->SpawnOnMap(a, -1, 0, 0);
+		}
+	}
+}
+
 void Game::SpawnLevel(int mapID, int spawnPointX, int spawnPointY)
 {
-	DebugLog("SPAWNING LEVEL #" + std::to_string(mapID));
+	DEBUG_LOG("SPAWNING LEVEL #" + std::to_string(mapID));
 	
 	currentMapID = mapID;
 	currentMap = mMapManager->getMap(currentMapID);
 
 	bool outdoor = currentMap->outdoor;
-	DebugLog("Level is " + outdoor ? "outdoor." : "indoor.");
+	DEBUG_LOG(std::string("Level is ") + (outdoor ? "outdoor." : "indoor."));
 
-	DebugLog("Spawning PCs");
+	DEBUG_LOG("Spawning PCs");
 	const int MAX_SPAWN_DIST = 255;
 	int dist = 1;
 	int dist_mult = outdoor ? 6 : 8;
@@ -180,12 +450,10 @@ void Game::SpawnLevel(int mapID, int spawnPointX, int spawnPointY)
 		if (pc_id == currentCharacterID)
 		{
 			// the currently controlled character spawns on the spawn point
-			mCharacterManager->SetPlayerX(currentCharacterID, spawnPointX);
-			mCharacterManager->SetPlayerY(currentCharacterID, spawnPointY);
 			mCharacterManager->SetPlayerMap(currentCharacterID, mapID);
 			currentMap->setCharacter(spawnPointX, spawnPointY, currentCharacterID);
 			
-			DebugLog("Spawning player onto position (" + std::to_string(spawnPointX) + "," + std::to_string(spawnPointY) + ")");
+			DEBUG_LOG("Spawning player onto position (" + std::to_string(spawnPointX) + "," + std::to_string(spawnPointY) + ")");
 		}
 		else
 		{
@@ -193,14 +461,14 @@ void Game::SpawnLevel(int mapID, int spawnPointX, int spawnPointY)
 		}
 	}
 
-	DebugLog("Spawning Henches");
+	DEBUG_LOG("Spawning Henches");
 	std::vector<int> henches = mPartyManager->getHenchmen(currentPartyID);
 	for (int h_id : henches)
 	{
 		mCharacterManager->SpawnOnMap(h_id, mapID, spawnPointX, spawnPointY);
 	}
 
-	DebugLog("Spawning Animals");
+	DEBUG_LOG("Spawning Animals");
 	std::vector<int> animals = mPartyManager->getAnimals(currentPartyID);
 	for (int a_id : animals)
 	{
@@ -210,6 +478,9 @@ void Game::SpawnLevel(int mapID, int spawnPointX, int spawnPointY)
 			mMobManager->SpawnOnMap(a_id, currentMapID, spawnPointX, spawnPointY);
 		}
 	}
+
+	// wherever we just left can go quiet, and this one comes back to life
+	mMobManager->UpdateMapDetail();
 }
 
 bool Game::MenuGameHandleKeyboard(TCOD_key_t* key)
@@ -411,7 +682,7 @@ bool Game::MainGameHandleKeyboard(TCOD_key_t* key)
 					int wieldedID = mCharacterManager->GetItemInEquipSlot(currentCharacterID, HAND_MAIN);
 					if (wieldedID != -1)
 					{
-						bool missile = mItemManager->hasTag(wieldedID, "Missile");
+						bool missile = mItemManager->hasTag(wieldedID, ITEM_TAG_MISSILE);
 
 						// just ignore this press if we're not using a missile weapon of some kind
 						if (missile)
@@ -442,7 +713,7 @@ bool Game::MainGameHandleKeyboard(TCOD_key_t* key)
 						mTimeManager->SetEntityTime(currentCharacterID, MANAGER_CHARACTER, 0.01);
 						mCharacterManager->SetBehaviour(shiftCharacterID, CHAR_BEHAVIOUR_UNSET);
 
-						DebugLog("Switching to character " + std::to_string(shiftCharacterID));
+						DEBUG_LOG("Switching to character " + std::to_string(shiftCharacterID));
 						currentCharacterID = shiftCharacterID;
 						player_x = mCharacterManager->GetPlayerX(currentCharacterID);
 						player_y = mCharacterManager->GetPlayerY(currentCharacterID);
@@ -451,7 +722,7 @@ bool Game::MainGameHandleKeyboard(TCOD_key_t* key)
 					}
 					else
 					{
-						DebugLog("Tab pressed but no valid character available.");
+						DEBUG_LOG("Tab pressed but no valid character available.");
 					}
 				}
 
@@ -482,8 +753,9 @@ bool Game::MainGameHandleKeyboard(TCOD_key_t* key)
 							player_x = targetMap->reverse_transition_xpos[i];
 							player_y = targetMap->reverse_transition_ypos[i];
 
-							currentMapID = targetMapIndex;
-							currentMap = targetMap;
+							// the party comes along, arranged around the stairs. SpawnLevel then lets the level we left go quiet.
+							LiftPartyOffMap();
+							SpawnLevel(targetMapIndex, player_x, player_y);
 
 							recomputeFov = true;
 						}
@@ -500,9 +772,13 @@ bool Game::MainGameHandleKeyboard(TCOD_key_t* key)
 
 						// TODO: Check for active enemies, don't allow zooming out if there are any (thank you Skyrim)
 
+						// the party leaves the map with us, so nothing keeps it at full detail
+						LiftPartyOffMap();
+
 						currentMapID = -1;
 						currentMap = NULL;
 						mTimeManager->DeregisterEntities();
+						mMobManager->UpdateMapDetail();
 						AddActionLogText("", true); // clear the action log
 					}
 
@@ -769,10 +1045,10 @@ void Game::MoveCharacter(int new_x, int new_y)
 						// unconscious character. Check if they have an unresolved injury
 						if (mCharacterManager->getCharacterHasCondition(character, "Injured"))
 						{
-							if (mCharacterManager->getCharacterCapabilityFlag(currentCharacterID, "TreatWounds"))
+							if (mCharacterManager->getCharacterCapabilityFlag(currentCharacterID, CAPABILITY_TREAT_WOUNDS))
 							{
 								std::string charName = mCharacterManager->getCharacterName(character);
-								DebugLog("Performing mortal wounds check on " + charName + ".");
+								DEBUG_LOG("Performing mortal wounds check on " + charName + ".");
 								std::string text2 = mCharacterManager->getCharacterName(currentCharacterID) + " checks " + charName + "'s wounds.";
 								AddActionLogText(text2);
 								// unresolved injury. Calculate modifiers for roll
@@ -796,14 +1072,14 @@ void Game::MoveCharacter(int new_x, int new_y)
 										bonus -= 5;
 									}
 								}
-								bonus += mCharacterManager->getTagValue(currentCharacterID, "Healing:MortalWound:Bonus");
+								bonus += mCharacterManager->getTagValue(currentCharacterID, TAG_HEALING_MORTAL_WOUND_BONUS);
 
-								DebugLog("Severity roll at " + std::to_string(bonus));
+								DEBUG_LOG("Severity roll at " + std::to_string(bonus));
 								// test mortal wounds
 								int d20_roll = randomiser->diceRoll("1d20") + bonus;
 								int d6_roll = randomiser->diceRoll("1d6");
 
-								DebugLog("D20/D6:" + std::to_string(d20_roll) + "/" + std::to_string(d6_roll));
+								DEBUG_LOG("D20/D6:" + std::to_string(d20_roll) + "/" + std::to_string(d6_roll));
 
 								MortalRollResult* result = mMortalManager->RollMortalWound(d20_roll, d6_roll);
 
@@ -811,7 +1087,7 @@ void Game::MoveCharacter(int new_x, int new_y)
 
 								text.replace(text.find("%1%"), sizeof("%1%") - 1, charName);
 
-								DebugLog("Results:" + text);
+								DEBUG_LOG("Results:" + text);
 
 								AddActionLogText(text);
 
@@ -859,7 +1135,7 @@ void Game::MoveCharacter(int new_x, int new_y)
 				{
 					// there's a monster there
 					int c_id = currentMap->getMobAt(new_x, new_y);
-					Creature& c = gGame->mMobManager->GetMonster(c_id);
+					Creature c = gGame->mMobManager->GetMonster(c_id);
 
 					if (c.IsBlocking())
 					{
@@ -899,8 +1175,7 @@ void Game::MoveCharacter(int new_x, int new_y)
 						hostilifying = false;
 
 						// there isn't another creature there, so move
-						mCharacterManager->SetPlayerX(currentCharacterID, new_x);
-						mCharacterManager->SetPlayerY(currentCharacterID, new_y);
+						currentMap->setCharacter(new_x, new_y, currentCharacterID);
 						recomputeFov = true;
 
 						UpdateLookText(new_x, new_y);
@@ -915,8 +1190,7 @@ void Game::MoveCharacter(int new_x, int new_y)
 					hostilifying = false;
 
 					// there isn't another creature there, so move
-					mCharacterManager->SetPlayerX(currentCharacterID, new_x);
-					mCharacterManager->SetPlayerY(currentCharacterID, new_y);
+					currentMap->setCharacter(new_x, new_y, currentCharacterID);
 					recomputeFov = true;
 
 					UpdateLookText(new_x, new_y);
@@ -1190,7 +1464,7 @@ bool Game::ResolveAttacks(int attackerManager, int attackerID, int defenderManag
 	{
 		case MANAGER_CHARACTER:
 			{
-				Creature& c = mMobManager->GetMonster(defenderID);
+				Creature c = mMobManager->GetMonster(defenderID);
 				std::string attackText = gGame->mCharacterManager->getCharacterName(attackerID) + " attacks " + c.GetName() + ".";
 				gGame->AddActionLogText(attackText);
 				
@@ -1203,28 +1477,10 @@ bool Game::ResolveAttacks(int attackerManager, int attackerID, int defenderManag
 
 				if (weaponID != -1)
 				{
-					if (weaponID != offhandID)
-					{
-						// if the weapon is in one hand and has the "Grab" tag, the die is d2 (bolas, whips etc)
-						// if the weapon is in one hand and has the "Light" tag, the die is d4 (Clubs/Daggers etc)
-						// if the weapon is in one hand only, the die is d6 (one handed weapon only)
-						attackerDamageDieType = 6;
-						if (mItemManager->hasTag(weaponID, "Light")) attackerDamageDieType = 4;
-						if (mItemManager->hasTag(weaponID, "Grab")) attackerDamageDieType = 2;
-					}
-					else
-					{
-						// if the weapon is in two hands and has the "One-Handed" tag, the die is d8 (bastard weapon wielded in two hands)
-						// if the weapon is in two hands and does not have the "One-Handed" tag, the die is d10 (full two-hander)
-						if (mItemManager->hasTag(weaponID, "One-Handed"))
-						{
-							attackerDamageDieType = 8;
-						}
-						else
-						{
-							attackerDamageDieType = 10;
-						}
-					}
+					// the die depends on whether the weapon is held in one hand or two (and on its Light/Grab/One-Handed/bow tags),
+					// which the item's profile has already worked out
+					const ItemProfile& weapon = mItemManager->getProfile(weaponID);
+					attackerDamageDieType = weaponID != offhandID ? weapon.DamageDieOneHand : weapon.DamageDieTwoHands;
 				
 
 					// range modifiers
@@ -1240,12 +1496,7 @@ bool Game::ResolveAttacks(int attackerManager, int attackerID, int defenderManag
 						int rangePenalty = mItemManager->getRangePenalty(weaponID, dist);
 						attackerAttackBonus += rangePenalty;
 					}
-					
-					// bow weapons are an exception to the usual damage pattern.
-					if(mItemManager->hasTag(weaponID, "Bows") || mItemManager->hasTag(weaponID, "Crossbows"))
-					{
-						attackerDamageDieType = 6;
-					}
+
 
 					// barring special circumstances (criticals, spear charges etc) this is always 1 damage die
 					attackerDamageDice = 1;
@@ -1291,8 +1542,7 @@ bool Game::ResolveAttacks(int attackerManager, int attackerID, int defenderManag
 							int new_x = mMobManager->GetMobX(defenderID);
 							int new_y = mMobManager->GetMobY(defenderID);
 
-							mCharacterManager->SetPlayerX(currentCharacterID, new_x);
-							mCharacterManager->SetPlayerY(currentCharacterID, new_y);
+							currentMap->setCharacter(new_x, new_y, currentCharacterID);
 							recomputeFov = true;
 
 							UpdateLookText(new_x, new_y);
@@ -1322,7 +1572,7 @@ bool Game::ResolveAttacks(int attackerManager, int attackerID, int defenderManag
 		case MANAGER_MOB:
 			{
 				// Monsters usually either get 1 weapon attack (like PCs) or get an attack sequence like Claw/Claw/Bite
-				Creature& c = mMobManager->GetMonster(attackerID);
+				Creature c = mMobManager->GetMonster(attackerID);
 
 				std::string attackText = c.GetName() + " attacks " + gGame->mCharacterManager->getCharacterName(defenderID) + ".";
 				gGame->AddActionLogText(attackText);
@@ -1330,15 +1580,15 @@ bool Game::ResolveAttacks(int attackerManager, int attackerID, int defenderManag
 				attackerCleaveCount = c.GetCleaveCount();
 				
 				AdvancementStore* as = mClassManager->GetAdvancementStore();
-				attackerAttackBonus = as->AttackBonusLookup["Monster"][c.GetHitDie()];
+				attackerAttackBonus = as->GetAttackBonuses(AdvancementStore::MONSTER_PROGRESSION)[c.GetHitDie()];
 
-				std::vector <std::vector<std::string>>& attackSequences = c.GetAttackSequences();
+				const std::vector<std::vector<int>>& attackSequences = c.GetAttackSequences();
 				int sequence = randomiser->getInt(0, attackSequences.size()-1);
-				std::vector<std::string>& attackSequence = attackSequences[sequence];
+				const std::vector<int>& attackSequence = attackSequences[sequence];
 				
-				for(std::string attack : attackSequence)
+				for(int attack : attackSequence)
 				{
-					AttackType at = c.GetAttack(attack);
+					const AttackType& at = c.GetAttack(attack);
 					attackerDamageBonus = at.DamageBonus();
 					attackerDamageDieType = at.DamageDie();
 					// TODO: Damage Dice in AttackType
@@ -1379,7 +1629,7 @@ bool Game::ResolveAttack(int attackBonus, int damageDie, int damageBonus, int de
 			break;
 		case MANAGER_MOB:
 			{
-				Creature& c = mMobManager->GetMonster(defenderID);
+				Creature c = mMobManager->GetMonster(defenderID);
 				defenderAC = c.GetArmourClass();
 			}
 			break;
@@ -1442,6 +1692,7 @@ bool Game::ResolveDamage(int damageDie, int damageBonus, int defenderMananger, i
 		{
 			std::string c = mCharacterManager->getCharacterName(defenderID);
 			gGame->AddActionLogText(c + " falls!");
+			charactersFallen++;
 			mCharacterManager->SetCondition(defenderID,"Unconscious",-255);
 			mCharacterManager->SetCondition(defenderID, "Injured",-255);
 			mCharacterManager->SetBehaviour(defenderID, "Unconscious"); 
@@ -1468,7 +1719,7 @@ bool Game::ResolveDamage(int damageDie, int damageBonus, int defenderMananger, i
 	break;
 	case MANAGER_MOB:
 	{
-		Creature& c = mMobManager->GetMonster(defenderID);
+		Creature c = mMobManager->GetMonster(defenderID);
 		int currentHP = c.GetHitPoints();
 		currentHP -= result;
 		disabled = (currentHP < 1);
@@ -1476,9 +1727,11 @@ bool Game::ResolveDamage(int damageDie, int damageBonus, int defenderMananger, i
 		if(disabled)
 		{
 			gGame->AddActionLogText(c.GetName() + " falls!");
+			mobsFallen++;
 			c.SetCondition("Unconscious");
 			c.SetCondition("Injured");
 			mMobManager->SetBehaviour(defenderID, "Unconscious"); // will be moved into the condition management eventually
+			mMobManager->MarkFallen(defenderID);
 		}
 	}
 	break;
@@ -1495,6 +1748,7 @@ bool Game::ResolveDamage(int damageDie, int damageBonus, int defenderMananger, i
 void Game::CharacterDeath(int characterID)
 {
 	// sad times :(
+	characterDeaths++;
 	// TODO: drop all items
 	mCharacterManager->DeactivateCharacter(characterID);
 	mPartyManager->RemoveCharacter(currentPartyID, characterID);
@@ -1508,6 +1762,8 @@ void Game::MainLoop()
 	TCOD_mouse_t mouse;
 	
 	do {
+		long double keyTime = mTimeManager->GetRunningTime();
+
 		// render current sample
 
 		TCODConsole::root->clear();
@@ -1558,6 +1814,15 @@ void Game::MainLoop()
 			RenderActionLog();
 		}
 
+		if (journal != nullptr && key.vk != TCODK_NONE)
+		{
+			journal->RecordKey(key, keyTime);
+			if (journal->CheckpointDue())
+			{
+				journal->RecordCheckpoint(StateHash(), mTimeManager->GetRunningTime());
+			}
+		}
+
 		// blit the sample console on the root console
 		TCODConsole::blit(gGame->sampleConsole, 0, 0, SAMPLE_SCREEN_WIDTH, SAMPLE_SCREEN_HEIGHT, // the source console & zone to blit
 			TCODConsole::root, SAMPLE_SCREEN_X, SAMPLE_SCREEN_Y // the destination console & position
@@ -1639,7 +1904,7 @@ void Game::RenderMap()
 			if (mCharacterManager->GetPlayerX(ch) != -1)
 			{
 				TCODColor baseColor = TCODColor::lighterGrey;
-				if (mCharacterManager->getCharacterHasCondition(ch, "Unconscious")) baseColor = baseColor * TCODColor::grey;
+				if (mCharacterManager->getCharacterHasCondition(ch, mConditionManager->UnconsciousIndex)) baseColor = baseColor * TCODColor::grey;
 
 				if (ch == currentCharacterID)
 				{
@@ -1656,7 +1921,7 @@ void Game::RenderMap()
 		for (int ch : henches)
 		{
 			TCODColor baseColor = TCODColor::lighterGrey;
-			if (mCharacterManager->getCharacterHasCondition(ch, "Unconscious")) baseColor = baseColor * TCODColor::grey;
+			if (mCharacterManager->getCharacterHasCondition(ch, mConditionManager->UnconsciousIndex)) baseColor = baseColor * TCODColor::grey;
 
 			if (mCharacterManager->GetPlayerX(ch) != -1)
 			{
@@ -1713,7 +1978,7 @@ void Game::RenderTargets()
 		{
 			for (int beastie : targets)
 			{
-				//Creature& c = mMobManager->GetMonster(beastie);
+				//Creature c = mMobManager->GetMonster(beastie);
 				
 				mMapManager->renderAtPosition(sampleConsole, currentMapID, mMobManager->GetMobX(beastie), mMobManager->GetMobX(beastie), mMobManager->GetMobX(beastie), mMobManager->GetMobX(beastie), 'X');
 			}
@@ -1768,8 +2033,8 @@ void Game::UpdateLookText(int x, int y)
 		int mobID = currentMap->getMobAt(x, y);
 		if (mobID != 0)
 		{
-			Creature& c = mMobManager->GetMonster(mobID);
-			if (c.HasCondition("Unconscious"))
+			Creature c = mMobManager->GetMonster(mobID);
+			if (c.HasCondition(mConditionManager->UnconsciousIndex))
 			{
 				playLogString += "There is an unconscious " + c.GetName() + ".";
 			}
@@ -1782,7 +2047,7 @@ void Game::UpdateLookText(int x, int y)
 		int charID = currentMap->getCharacterAt(x, y);
 		if (charID != 0 && charID != currentCharacterID)
 		{
-			if (mCharacterManager->getCharacterHasCondition(charID, "Unconscious"))
+			if (mCharacterManager->getCharacterHasCondition(charID, mConditionManager->UnconsciousIndex))
 			{
 				playLogString += mCharacterManager->getCharacterName(charID) + "lies here, unconscious.";
 			}
@@ -1810,7 +2075,7 @@ void Game::UpdateLookText(int x, int y)
 		}
 	}
 
-	DebugLog("Action Log changed to:" + playLogString);
+	DEBUG_LOG("Action Log changed to:" + playLogString);
 }
 
 void Game::AddActionLogText(std::string term, bool clear)
@@ -1823,11 +2088,11 @@ void Game::AddActionLogText(std::string term, bool clear)
 
 	if (clear)
 	{
-		DebugLog("Action Log cleared and added:" + term);
+		DEBUG_LOG("Action Log cleared and added:" + term);
 	}
 	else
 	{
-		DebugLog("Action Log added:" + term);
+		DEBUG_LOG("Action Log added:" + term);
 	}
 }
 
@@ -1909,7 +2174,7 @@ void Game::RenderCharacterSheet()
 
 	auto advancement = mClassManager->GetAdvancementStore();
 	
-	auto attack_bonuses = advancement->AttackBonusLookup[acks_class->AttackProgression()];
+	const std::vector<int>& attack_bonuses = advancement->GetAttackBonuses(acks_class->AttackProgressionIdx);
 	int attack_bonus = attack_bonuses[level];
 	std::string ab_melee = "Melee Attack:" + std::to_string(mCharacterManager->UpdateCurrentAttackValue(currentCharacterID, false));
 	std::string ab_missile = "Missile Attack:" + std::to_string(mCharacterManager->UpdateCurrentAttackValue(currentCharacterID, true));
@@ -1927,7 +2192,7 @@ void Game::RenderCharacterSheet()
 		
 		characterScreen->printEx(25, 12+i, TCOD_BKGND_NONE, TCOD_LEFT, display_name.c_str());
 
-		int saveVal = mCharacterManager->UpdateCurrentSaveValue(currentCharacterID, save_name);
+		int saveVal = mCharacterManager->UpdateCurrentSaveValue(currentCharacterID, i);
 
 		characterScreen->printEx(40, 12+i, TCOD_BKGND_NONE, TCOD_LEFT, std::to_string(saveVal).c_str());
 	}
@@ -2036,5 +2301,5 @@ void Game::RenderOffscreenUI(bool inventory, bool character)
 
 void Game::DebugLog(std::string message)
 {
-	gLog->Log("Game", message);
+	DEBUG_LOG(message);
 }
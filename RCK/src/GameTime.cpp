@@ -1,8 +1,12 @@
 #include "GameTime.h"
 
+#include <algorithm>
+#include <chrono>
 #include <ctime>
+#include <random>
 #include <vector>
 #include "Game.h"
+#include "Snapshot.h"
 
 TimeManager::TimeManager()
 {
@@ -18,80 +22,119 @@ bool TimeManager::AdvanceTime()
 
 bool TimeManager::AdvanceTimeBy(long double time)
 {
-	if (entities.size() <= 0)
+	// nothing to fire still lets a fixed amount of time go by (the region map has nobody scheduled, but the maps off it keep going)
+	if (schedule.Empty() && time == -1.0)
 		return false;
 
 	// the entities we call are able to interrupt us. If we hit an interruption, we have to quit back out.
 	// usually this happens when something important happens to a party member or we need a decision from the player
-	// Because we can always be interrupted, we have to deduct time one by one.
 
-	// we cannot modify a collection that is currently being iterated. To correct for this, we need to handle this as a DOD type table transformation.
-	// To achieve this we copy the list, and further calls to SetEntityTime (from TurnHandlers) effectively generate a new table.
-
-	std::list<long double > old_times;
-	std::list<int> old_entities, old_managers;
-	std::copy(times.begin(), times.end(), std::back_inserter(old_times));
-	std::copy(entities.begin(), entities.end(), std::back_inserter(old_entities));
-	std::copy(managers.begin(), managers.end(), std::back_inserter(old_managers));
-	
-	std::list<long double >::iterator time_iter = old_times.begin();
-	std::list<int>::iterator ent_iter = old_entities.begin();
-	std::list<int>::iterator manager_iter = old_managers.begin();
+	// the TurnHandlers will reschedule themselves (via SetEntityTime) while we're running, so we take a snapshot of everything due in this window first.
+	// Each due entity gets exactly one turn per call, the same as when we iterated over a copy of the lists.
+	// Entities that don't reschedule (eg the selected character) stay in the queue at their old time.
 
 	if (time == -1.0)
 	{
 		// time of -1 indicates "skip to next event"
-		time = *time_iter; // first event
+		time = schedule.Top().time - masterTime; // first event
 	}
 
-	long double time_elapsed = 0.0L;
+	std::vector<ScheduledEvent> due;
+	schedule.CollectDue(masterTime + time, due);
+
+	// handlers get their time relative to the start of this advance, and schedule their next turn relative to that as well
+	long double time_elapsed = time;
 	bool result = false;
-	for (; time_iter != old_times.end(); time_iter++, ent_iter++, manager_iter++)
+	std::vector<int> batch;
+	for (size_t i = 0; i < due.size(); i++)
 	{
-		time_elapsed = *time_iter;
+		const ScheduledEvent& e = due[i];
+		long double eventTime = e.time - masterTime;
 
-		if (time_elapsed > time) break;
-		
-		switch(*manager_iter)
+		if (e.manager == MANAGER_MOB)
 		{
-		case MANAGER_CHARACTER:
+			// monsters due at the same moment go to the MobManager as one batch, so it can work out what they're all doing in parallel
+			// before any of them act (see MobManager::TurnHandler). It hands them their turns in ID order.
+			batch.clear();
+			size_t end = i;
+			while (end < due.size() && due[end].manager == MANAGER_MOB && due[end].time == e.time)
 			{
-				result = gGame->mCharacterManager->TurnHandler(*ent_iter, time_elapsed);
+				batch.push_back(due[end].entity);
+				end++;
 			}
-			break;
-		case MANAGER_MOB:
+
+			int handled = 0;
+			result = gGame->mMobManager->TurnHandler(batch, eventTime, handled);
+			eventsFired += handled;
+
+			// each turn's TRACE_FIRE/TRACE_FIRE_END is recorded by the MobManager as it goes (see TraceTurn)
+			if (trace.IsOpen() && result && handled > 0)
+				trace.Record(TRACE_INTERRUPT, MANAGER_MOB, batch[handled - 1], masterTime, e.time);
+
+			if (result)
+			{
+				time_elapsed = eventTime;
+				break;
+			}
+
+			i = end - 1;
+			continue;
+		}
+
+		eventsFired++;
+
+		if (trace.IsOpen())
+			trace.Record(TRACE_FIRE, e.manager, e.entity, masterTime, e.time);
+
+		switch(e.manager)
+		{
+		case MANAGER_CHARACTER:
 			{
-				result = gGame->mMobManager->TurnHandler(*ent_iter, time_elapsed);
+				result = gGame->mCharacterManager->TurnHandler(e.entity, eventTime);
 			}
 			break;
 		case MANAGER_MAP:
 			{
-				result = gGame->mMapManager->TurnHandler(*ent_iter, time_elapsed);
+				result = gGame->mMapManager->TurnHandler(e.entity, eventTime);
 			}
 			break;
 		case MANAGER_ITEM:
 			{
-				// gGame->mItemManager->TurnHandler(*ent_iter, *time_iter);
+				// gGame->mItemManager->TurnHandler(e.entity, eventTime);
 			}
 			break;
 		case MANAGER_BASE:
 			{
-				result = gGame->mBaseManager->TurnHandler(*ent_iter, time_elapsed);
+				result = gGame->mBaseManager->TurnHandler(e.entity, eventTime);
 			}
 		}
-		
-		if (result) break;
-	}
 
-	for (long double&t : times)
-	{
-		t -= time_elapsed;
+		if (trace.IsOpen())
+		{
+			trace.Record(TRACE_FIRE_END, e.manager, e.entity, masterTime, e.time);
+			if (result)
+				trace.Record(TRACE_INTERRUPT, e.manager, e.entity, masterTime, e.time);
+		}
+
+		if (result)
+		{
+			// we've been interrupted, so the clock only runs up to this event
+			time_elapsed = eventTime;
+			break;
+		}
 	}
 
+	// entities that never rescheduled can be sitting in the past, but the clock never runs backwards
+	if (time_elapsed < 0.0L)
+		time_elapsed = 0.0L;
+
 	// now update the main time counter and call the managers if needed
 	long double old_time = masterTime;
 	masterTime += time_elapsed;
 
+	if (trace.IsOpen())
+		trace.Record(TRACE_ADVANCE, MANAGER_GAME, -1, old_time, masterTime);
+
 	int roundsPassed = (int)(masterTime / time_periods[TIME_ROUND]) - (int)(old_time / time_periods[TIME_ROUND]);;
 
 	int turnsPassed = (int)(roundsPassed / 60);
@@ -112,13 +155,6 @@ bool TimeManager::AdvanceTimeBy(long double time)
 		gGame->mBaseManager->TimeHandler(roundsPassed, turnsPassed, hoursPassed, daysPassed, weeksPassed, monthsPassed);
 	}
 
-	// advance by intervals. 
-
-	if(debugMode)
-	{
-		DumpTimeToFile("time_dump.txt");
-	}
-	
 	return result;
 }
 
@@ -167,52 +203,68 @@ void TimeManager::RegisterNewEntity(int entityID, int manager)
 void TimeManager::DeregisterEntities()
 {
 	// generally used when we change maps. This does not affect long term timing (since that calls the managers directly)
-	entities.clear();
-	managers.clear();
-	times.clear();
+	schedule.Clear();
+
+	if (trace.IsOpen())
+		trace.Record(TRACE_CLEAR, MANAGER_GAME, -1, masterTime, masterTime);
+}
+
+void TimeManager::DeregisterEntity(int entityID, int manager)
+{
+	if (schedule.Remove(entityID, manager) && trace.IsOpen())
+		trace.Record(TRACE_DEREGISTER, manager, entityID, masterTime, masterTime);
 }
 
 void TimeManager::SetEntityTime(int entityID, int manager, long double time)
 {
-	std::list<int>::iterator ent_iter = entities.begin();
-	std::list<int>::iterator manager_iter = managers.begin();
-	std::list<long double>::iterator time_iter = times.begin();
-	
-	// wind forward to the entity we're looking for
-	for (; ent_iter != entities.end() && !(*ent_iter == entityID && *manager_iter == manager); ent_iter++, manager_iter++, time_iter++)
-	{}
-
-	if (ent_iter != entities.end())
-	{
-		entities.erase(ent_iter);
-		managers.erase(manager_iter);
-		times.erase(time_iter);
-	}
+	// Schedule moves the entity if it's already in the queue, so no need to find and erase it first
 	EmplaceEntity(entityID, manager, time);
 }
 
 void TimeManager::EmplaceEntity(int entityID, int manager, long double time)
 {
-	std::list<int>::iterator ent_iter = entities.begin();
-	std::list<int>::iterator manager_iter = managers.begin();
-	std::list<long double>::iterator time_iter = times.begin();
-
-	for(; time_iter != times.end()  && *time_iter < time ;ent_iter++,manager_iter++,time_iter++)
-	{}
+	// callers give us time from now; the queue wants absolute time
+	schedule.Schedule(entityID, manager, masterTime + time);
 
-	entities.emplace(ent_iter, entityID);
-	managers.emplace(manager_iter, manager);
-	times.emplace(time_iter, time);
+	if (trace.IsOpen())
+		trace.Record(TRACE_SCHEDULE, manager, entityID, masterTime, masterTime + time);
+}
 
-	if (debugMode)
+bool TimeManager::EnableTrace(std::string filename)
+{
+	if (!trace.Open(filename))
 	{
-		DumpTimeToFile("time_dump.txt");
+		RCK_LOG_WARNING(LogCategory, "Couldn't open scheduler trace " + filename);
+		return false;
 	}
+
+	RCK_LOG_INFO(LogCategory, "Recording scheduler trace to " + filename);
+	return true;
+}
+
+void TimeManager::SaveSnapshot(SnapshotWriter& w)
+{
+	w.Section("TIME");
+	// long double is 8 bytes on MSVC and 10 in a 16 byte slot on gcc, so times go out as plain doubles
+	w.Write((double)masterTime);
+	w.Write(eventsFired);
+	schedule.SaveSnapshot(w);
+}
+
+bool TimeManager::LoadSnapshot(SnapshotReader& r)
+{
+	if (!r.Section("TIME"))
+		return false;
+	double time = 0.0;
+	r.Read(time);
+	masterTime = time;
+	r.Read(eventsFired);
+	return schedule.LoadSnapshot(r);
 }
 
 void TimeManager::DebugLog(std::string message)
 {
-	gLog->Log("TimeManager", message);
+	DEBUG_LOG(message);
 }
 
 void TimeManager::DumpTimeToLog(OutputLog* log)
@@ -221,34 +273,38 @@ void TimeManager::DumpTimeToLog(OutputLog* log)
 	log->Log("TimeManager", "DUMPING TIMES");
 	log->Log("TimeManager", "=============");
 
-	std::list<int>::iterator ent_iter = entities.begin();
-	std::list<int>::iterator manager_iter = managers.begin();
-	std::list<long double>::iterator time_iter = times.begin();
+	// the heap is only partially ordered, so sort a copy for the dump
+	std::vector<ScheduledEvent> events = schedule.Entries();
+	std::sort(events.begin(), events.end(), [](const ScheduledEvent& a, const ScheduledEvent& b)
+	{
+		return a.time < b.time || (a.time == b.time && a.sequence < b.sequence);
+	});
 
-	for (; time_iter != times.end(); ent_iter++, manager_iter++, time_iter++)
+	for (const ScheduledEvent& e : events)
 	{
-		switch (*manager_iter)
+		long double relativeTime = e.time - masterTime;
+		switch (e.manager)
 		{
 		case MANAGER_CHARACTER:
 		{
-			std::string name = gGame->mCharacterManager->getCharacterName(*ent_iter);
-			log->Log("TimeManager", "Character(" + name + "), " + std::to_string(*time_iter));
+			std::string name = gGame->mCharacterManager->getCharacterName(e.entity);
+			log->Log("TimeManager", "Character(" + name + "), " + std::to_string(relativeTime));
 		}
 		break;
 		case MANAGER_MOB:
 		{
-			std::string name = gGame->mMobManager->GetMonster(*ent_iter).GetName();
-			log->Log("TimeManager", "Monster(" + name + "), " + std::to_string(*time_iter));
+			std::string name = gGame->mMobManager->GetMonster(e.entity).GetName();
+			log->Log("TimeManager", "Monster(" + name + "), " + std::to_string(relativeTime));
 		}
 		break;
 		case MANAGER_MAP:
 		{
-			//gGame->mMapManager->TurnHandler(*ent_iter, time_elapsed);
+			//gGame->mMapManager->TurnHandler(e.entity, time_elapsed);
 		}
 		break;
 		case MANAGER_ITEM:
 		{
-			// gGame->mItemManager->TurnHandler(*ent_iter, *time_iter);
+			// gGame->mItemManager->TurnHandler(e.entity, relativeTime);
 		}
 		break;
 		}
@@ -257,7 +313,8 @@ void TimeManager::DumpTimeToLog(OutputLog* log)
 
 void TimeManager::DumpTimeToFile(std::string filename)
 {
-	OutputLog* log = new OutputLog(filename);
+	// a throwaway log, so write it synchronously rather than start a writer thread for it
+	OutputLog* log = new OutputLog(filename, false);
 
 	DumpTimeToLog(log);
 
@@ -268,3 +325,280 @@ long double TimeManager::GetRunningTime()
 {
 	return masterTime;
 }
+
+// ===========
+// Event Queue
+// ===========
+
+int& EventQueue::Slot(int entityID, int manager)
+{
+	// entity IDs are dense per manager, so a flat table per manager is cheaper than hashing
+	if (manager >= (int)slots.size())
+		slots.resize(manager + 1);
+
+	std::vector<int>& table = slots[manager];
+	if (entityID >= (int)table.size())
+		table.resize(entityID + 1, -1);
+
+	return table[entityID];
+}
+
+void EventQueue::Place(int index, const ScheduledEvent& e)
+{
+	heap[index] = e;
+	slots[e.manager][e.entity] = index;
+}
+
+void EventQueue::SiftUp(int index)
+{
+	ScheduledEvent e = heap[index];
+	while (index > 0)
+	{
+		int parent = (index - 1) / ARITY;
+		if (!Before(e, heap[parent]))
+			break;
+
+		Place(index, heap[parent]);
+		index = parent;
+	}
+	Place(index, e);
+}
+
+void EventQueue::SiftDown(int index)
+{
+	ScheduledEvent e = heap[index];
+	int count = (int)heap.size();
+	while (true)
+	{
+		int first = index * ARITY + 1;
+		if (first >= count)
+			break;
+
+		// find the earliest child
+		int best = first;
+		int last = std::min(first + ARITY, count);
+		for (int c = first + 1; c < last; c++)
+		{
+			if (Before(heap[c], heap[best]))
+				best = c;
+		}
+
+		if (!Before(heap[best], e))
+			break;
+
+		Place(index, heap[best]);
+		index = best;
+	}
+	Place(index, e);
+}
+
+void EventQueue::Schedule(int entityID, int manager, long double time)
+{
+	ScheduledEvent e;
+	e.time = time;
+	e.entity = entityID;
+	e.manager = manager;
+	e.sequence = nextSequence++;
+
+	int& slot = Slot(entityID, manager);
+	if (slot == -1)
+	{
+		heap.push_back(e);
+		slot = (int)heap.size() - 1;
+		SiftUp(slot);
+	}
+	else
+	{
+		// already scheduled - overwrite in place and let it float whichever way it needs to
+		int index = slot;
+		bool earlier = Before(e, heap[index]);
+		heap[index] = e;
+		if (earlier)
+			SiftUp(index);
+		else
+			SiftDown(index);
+	}
+}
+
+bool EventQueue::Remove(int entityID, int manager)
+{
+	if (!Contains(entityID, manager))
+		return false;
+
+	int index = slots[manager][entityID];
+	slots[manager][entityID] = -1;
+
+	int lastIndex = (int)heap.size() - 1;
+	if (index != lastIndex)
+	{
+		// move the last element into the hole, then repair in whichever direction it needs
+		ScheduledEvent moved = heap[lastIndex];
+		heap.pop_back();
+		bool earlier = index > 0 && Before(moved, heap[(index - 1) / ARITY]);
+		Place(index, moved);
+		if (earlier)
+			SiftUp(index);
+		else
+			SiftDown(index);
+	}
+	else
+	{
+		heap.pop_back();
+	}
+
+	return true;
+}
+
+void EventQueue::Clear()
+{
+	// only reset the slots we actually used rather than sweeping every table
+	for (const ScheduledEvent& e : heap)
+	{
+		slots[e.manager][e.entity] = -1;
+	}
+	heap.clear();
+}
+
+void EventQueue::SaveSnapshot(SnapshotWriter& w)
+{
+	// field by field rather than the raw structs, which would carry the long double's padding along
+	w.Write((uint64_t)heap.size());
+	for (const ScheduledEvent& e : heap)
+	{
+		w.Write((double)e.time);
+		w.Write(e.entity);
+		w.Write(e.manager);
+		w.Write(e.sequence);
+	}
+	w.Write(nextSequence);
+}
+
+bool EventQueue::LoadSnapshot(SnapshotReader& r)
+{
+	Clear();
+	uint64_t count = 0;
+	r.Read(count);
+	for (uint64_t i = 0; i < count && r.Ok(); i++)
+	{
+		ScheduledEvent e;
+		double time = 0.0;
+		r.Read(time);
+		r.Read(e.entity);
+		r.Read(e.manager);
+		r.Read(e.sequence);
+		e.time = time;
+		heap.push_back(e);
+	}
+	r.Read(nextSequence);
+	if (!r.Ok())
+	{
+		heap.clear();
+		return false;
+	}
+
+	for (int i = 0; i < (int)heap.size(); i++)
+	{
+		Slot(heap[i].entity, heap[i].manager) = i;
+	}
+	return true;
+}
+
+bool EventQueue::Contains(int entityID, int manager)
+{
+	if (manager < 0 || manager >= (int)slots.size())
+		return false;
+	if (entityID < 0 || entityID >= (int)slots[manager].size())
+		return false;
+
+	return slots[manager][entityID] != -1;
+}
+
+void EventQueue::Pop()
+{
+	if (heap.empty())
+		return;
+
+	Remove(heap.front().entity, heap.front().manager);
+}
+
+void EventQueue::CollectDue(long double time, std::vector<ScheduledEvent>& out)
+{
+	out.clear();
+	if (heap.empty())
+		return;
+
+	// any child of a node that isn't due can't be due either, so we can stop descending there
+	scratch.clear();
+	scratch.push_back(0);
+	while (!scratch.empty())
+	{
+		int index = scratch.back();
+		scratch.pop_back();
+
+		if (heap[index].time > time)
+			continue;
+
+		out.push_back(heap[index]);
+
+		int first = index * ARITY + 1;
+		int last = std::min(first + ARITY, (int)heap.size());
+		for (int c = first; c < last; c++)
+		{
+			scratch.push_back(c);
+		}
+	}
+
+	std::sort(out.begin(), out.end(), [this](const ScheduledEvent& a, const ScheduledEvent& b)
+	{
+		return Before(a, b);
+	});
+}
+
+void TimeManager::BenchmarkScheduler(int entityCount)
+{
+	// Exercises the queue on its own (no managers, no handlers) so we can see what the scheduler itself costs per operation.
+	// "advance" pops the earliest entity and reschedules it a little later, which is what a TurnHandler does every turn.
+
+	typedef std::chrono::high_resolution_clock clock;
+
+	EventQueue queue;
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<double> spread(0.0, MAX_TURN_SPEED);
+
+	auto nsPerOp = [entityCount](clock::time_point start, clock::time_point end)
+	{
+		return std::chrono::duration<double, std::nano>(end - start).count() / entityCount;
+	};
+
+	clock::time_point start = clock::now();
+	for (int i = 0; i < entityCount; i++)
+	{
+		queue.Schedule(i, MANAGER_MOB, spread(rng));
+	}
+	double scheduleCost = nsPerOp(start, clock::now());
+
+	start = clock::now();
+	for (int i = 0; i < entityCount; i++)
+	{
+		queue.Schedule((int)(rng() % entityCount), MANAGER_MOB, spread(rng));
+	}
+	double rescheduleCost = nsPerOp(start, clock::now());
+
+	start = clock::now();
+	for (int i = 0; i < entityCount; i++)
+	{
+		const ScheduledEvent& next = queue.Top();
+		queue.Schedule(next.entity, next.manager, next.time + spread(rng));
+	}
+	double advanceCost = nsPerOp(start, clock::now());
+
+	start = clock::now();
+	for (int i = 0; i < entityCount; i++)
+	{
+		queue.Remove(i, MANAGER_MOB);
+	}
+	double removeCost = nsPerOp(start, clock::now());
+
+	ReportLine(LogCategory, "%d entities: schedule %.1fns, reschedule %.1fns, advance %.1fns, remove %.1fns (per op)",
+		entityCount, scheduleCost, rescheduleCost, advanceCost, removeCost);
+}
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include "Game.h"
+#include "Headless.h"
+#include "Journal.h"
+#include "Pathing.h"
+
+std::string HeadlessSummary::ToString() const
+{
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer), "%d turns, %.0f game seconds, %llu events in %.3fs wall (%.0f events/sec). Characters fallen %d, dead %d. Monsters fallen %d. %s",
+		turns, (double)gameTime, events, wallSeconds, EventsPerSecond(), charactersFallen, characterDeaths, mobsFallen, resolved ? "Resolved." : "Turn limit reached.");
+	return buffer;
+}
+
+bool Game::CreateEncounter(std::string filename)
+{
+	DEBUG_LOG("Creating Encounter from " + filename);
+
+	std::ifstream is(filename);
+	if (!is.is_open())
+	{
+		RCK_LOG_ERROR(LogCategory, "Couldn't open encounter file " + filename);
+		return false;
+	}
+
+	EncounterDefinition encounter = jsoncons::decode_json<EncounterDefinition>(is);
+	is.close();
+
+	if (encounter.Layout().empty())
+	{
+		RCK_LOG_ERROR(LogCategory, "Encounter " + encounter.Name() + " has no layout");
+		return false;
+	}
+
+	// same party setup as the test game, including the "nobody" character 0
+	mCharacterManager->GenerateTestCharacter("NULL", "Fighter");
+
+	currentPartyID = mPartyManager->GenerateAITestParty();
+	currentCharacterID = mPartyManager->getNextPlayerCharacter(currentPartyID);
+	currentBaseID = -1;
+
+	int testItem = mItemManager->GenerateItemFromTemplate("Sword");
+	int inventoryID = mCharacterManager->AddInventoryItem(currentCharacterID, testItem);
+	mCharacterManager->EquipItem(currentCharacterID, inventoryID);
+
+	int mapID = mMapManager->buildMapFromText(encounter.Layout(), encounter.Outdoor());
+	Map* m = mMapManager->getMap(mapID);
+
+	for (const EncounterMonster& em : encounter.Monsters())
+	{
+		// put each one on the nearest free floor to where they asked for, working outward a ring at a time
+		int placed = 0;
+		for (int r = 0; placed < em.Count() && r < std::max(m->width, m->height); r++)
+		{
+			for (int y = em.Y() - r; y <= em.Y() + r && placed < em.Count(); y++)
+			{
+				for (int x = em.X() - r; x <= em.X() + r && placed < em.Count(); x++)
+				{
+					if (std::max(std::abs(x - em.X()), std::abs(y - em.Y())) != r)
+						continue;
+					if (mMapManager->isOutOfBounds(mapID, x, y) || !m->map->isWalkable(x, y))
+						continue;
+					if (m->getMobAt(x, y) || m->getCharacterAt(x, y) || (x == encounter.SpawnX() && y == encounter.SpawnY()))
+						continue;
+
+					mMobManager->GenerateMonster(em.Template(), mapID, x, y);
+					placed++;
+				}
+			}
+		}
+
+		if (placed < em.Count())
+		{
+			RCK_LOG_WARNING(LogCategory, "Only room for " + std::to_string(placed) + " of " + std::to_string(em.Count()) + " " + em.Template());
+		}
+	}
+
+	SpawnLevel(mapID, encounter.SpawnX(), encounter.SpawnY());
+
+	RCK_LOG_INFO(LogCategory, "Encounter " + encounter.Name() + " ready");
+
+	mode = GM_MAIN;
+	return true;
+}
+
+bool Game::HeadlessPlayerTurn(int playerMode, const std::string& script, size_t& scriptPosition)
+{
+	// stands in for the keyboard. Returns false once there's nothing left for the player to do.
+	int x = mCharacterManager->GetPlayerX(currentCharacterID);
+	int y = mCharacterManager->GetPlayerY(currentCharacterID);
+	int nx, ny;
+
+	switch (playerMode)
+	{
+	case HP_HUNT:
+		{
+			std::vector<int> hostiles = mMobManager->GetAllMonstersOnMap(currentMapID, true, true);
+			if (hostiles.empty())
+				return false;
+
+			// nearest as the crow flies, the planner works out the actual route
+			int target = hostiles[0];
+			int bestDistance = INT_MAX;
+			for (int mobID : hostiles)
+			{
+				int dx = mMobManager->GetMobX(mobID) - x;
+				int dy = mMobManager->GetMobY(mobID) - y;
+				if (dx * dx + dy * dy < bestDistance)
+				{
+					bestDistance = dx * dx + dy * dy;
+					target = mobID;
+				}
+			}
+
+			// the last step lands on the monster, which MoveCharacter turns into an attack
+			PathResult r = mMapManager->getPathPlanner()->NextStep(MANAGER_CHARACTER, currentCharacterID, currentMapID, x, y,
+				mMobManager->GetMobX(target), mMobManager->GetMobY(target), nx, ny);
+			if (r == PATH_STEP)
+			{
+				MoveCharacter(nx, ny);
+			}
+		}
+		break;
+	case HP_SCRIPT:
+		{
+			if (script.empty())
+				break;
+
+			char c = script[scriptPosition % script.size()];
+			scriptPosition++;
+
+			int move_value = c - '0';
+			if (move_value >= 0 && move_value < (currentMap->outdoor ? (int)HEX_MAX : (int)ORTHO_MAX))
+			{
+				mMapManager->shift(currentMapID, nx, ny, x, y, move_value);
+				MoveCharacter(nx, ny);
+			}
+			// anything else (usually '.') waits
+		}
+		break;
+	case HP_IDLE:
+	default:
+		break;
+	}
+
+	return true;
+}
+
+HeadlessSummary Game::RunHeadless(int maxTurns, int playerMode, std::string script)
+{
+	typedef std::chrono::high_resolution_clock clock;
+
+	HeadlessSummary summary;
+	size_t scriptPosition = 0;
+
+	RCK_LOG_INFO(LogCategory, "Headless run: " + std::to_string(maxTurns) + " turns, player " + HeadlessPlayerNames[playerMode]);
+
+	long double startTime = mTimeManager->GetRunningTime();
+	unsigned long long startEvents = mTimeManager->GetEventCount();
+	int startFallen = charactersFallen;
+	int startDeaths = characterDeaths;
+	int startMobsFallen = mobsFallen;
+
+	clock::time_point start = clock::now();
+	while (summary.turns < maxTurns && mode == GM_MAIN)
+	{
+		long double before = mTimeManager->GetRunningTime();
+
+		if (!HeadlessPlayerTurn(playerMode, script, scriptPosition))
+		{
+			summary.resolved = true;
+			break;
+		}
+
+		if (mTimeManager->GetRunningTime() == before)
+		{
+			// attacks, bumps and waiting don't cost any time yet. Charge a move's worth so everyone else still gets their turns.
+			mTimeManager->AdvanceTimeBy(mMapManager->getMovementTime(currentMapID, mCharacterManager->GetCurrentSpeed(currentCharacterID)));
+		}
+
+		summary.turns++;
+
+		// nobody is going to read the action log, so don't let it grow forever
+		playLogString.clear();
+	}
+
+	// game over drops us back to the menu
+	if (mode != GM_MAIN)
+		summary.resolved = true;
+
+	summary.wallSeconds = std::chrono::duration<double>(clock::now() - start).count();
+	summary.gameTime = mTimeManager->GetRunningTime() - startTime;
+	summary.events = mTimeManager->GetEventCount() - startEvents;
+	summary.charactersFallen = charactersFallen - startFallen;
+	summary.characterDeaths = characterDeaths - startDeaths;
+	summary.mobsFallen = mobsFallen - startMobsFallen;
+
+	RCK_LOG_INFO(LogCategory, summary.ToString());
+
+	return summary;
+}
+
+bool Game::ReplayJournal(SessionJournal* replay)
+{
+	// Same key handling as MainLoop, minus the rendering. Nothing in the renderers changes the game state, so skipping them is safe
+	// (and any checkpoint mismatch will tell us if that ever stops being true).
+	typedef std::chrono::high_resolution_clock clock;
+
+	int checkpoints = 0;
+	int mismatches = 0;
+	int timeMismatches = 0;
+	unsigned long long startEvents = mTimeManager->GetEventCount();
+
+	clock::time_point start = clock::now();
+
+	JournalRecord record;
+	while (replay->ReadNext(record) && mode != GM_QUIT)
+	{
+		if (record.type == JOURNAL_KEY)
+		{
+			if ((double)mTimeManager->GetRunningTime() != record.gameTime && timeMismatches++ == 0)
+			{
+				RCK_LOG_WARNING(LogCategory, "Replay key " + std::to_string(record.keyIndex) + " expected at game time " + std::to_string(record.gameTime)
+					+ " but the clock says " + std::to_string((double)mTimeManager->GetRunningTime()));
+			}
+
+			TCOD_key_t key = SessionJournal::ToKey(record);
+			if (mode == GM_MENU)
+			{
+				MenuGameHandleKeyboard(&key);
+			}
+			else
+			{
+				MainGameHandleKeyboard(&key);
+			}
+
+			// nobody is going to read the action log, so don't let it grow forever
+			playLogString.clear();
+		}
+		else if (record.type == JOURNAL_CHECKPOINT)
+		{
+			checkpoints++;
+			uint64_t hash = StateHash();
+			if (hash != record.hash)
+			{
+				if (mismatches++ == 0)
+				{
+					char buffer[256];
+					snprintf(buffer, sizeof(buffer), "Replay diverged by key %llu: state hash %016llx, journal has %016llx",
+						(unsigned long long)record.keyIndex, (unsigned long long)hash, (unsigned long long)record.hash);
+					printf("%s\n", buffer);
+					RCK_LOG_ERROR(LogCategory, buffer);
+				}
+			}
+		}
+	}
+
+	double wallSeconds = std::chrono::duration<double>(clock::now() - start).count();
+	unsigned long long events = mTimeManager->GetEventCount() - startEvents;
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer), "Replayed %llu keys (seed %u): %d/%d checkpoints matched, %.0f game seconds, %llu events in %.3fs wall (%.0f events/sec)",
+		(unsigned long long)replay->GetKeyCount(), replay->GetSeed(), checkpoints - mismatches, checkpoints, (double)mTimeManager->GetRunningTime(),
+		events, wallSeconds, wallSeconds > 0.0 ? events / wallSeconds : 0.0);
+	printf("%s\n", buffer);
+	RCK_LOG_INFO(LogCategory, buffer);
+
+	return mismatches == 0;
+}
@@ -1,4 +1,7 @@
 #include "ItemTemplate.h"
+#include "Game.h"
+#include "DataPack.h"
+#include "Snapshot.h"
 #include <cmath>
 #include <numeric>
 #include <cstdlib>
@@ -7,18 +10,14 @@ ItemManager* ItemManager::LoadItemTemplates()
 {
 	// read the characteristic bonuses from ability_bonus.csv
 
-	gLog->Log("Item Loader", "Started");
+	RCK_LOG_INFO("Item Loader", "Started");
 
 	std::string itemRangeFilename = "RCK/scripts/ranges.csv";
-	
-	std::ifstream rs(itemRangeFilename);
-
-	jsoncons::csv::csv_options options;
-	options.assume_header(true);
 
-	jsoncons::ojson j = jsoncons::csv::decode_csv<jsoncons::ojson>(rs, options);
+	jsoncons::ojson j;
+	DataPack::LoadCsv(itemRangeFilename, true, j);
 
-	gLog->Log("Item Loader", "Decoded " + itemRangeFilename);
+	RCK_LOG_INFO("Item Loader", "Decoded " + itemRangeFilename);
 
 	std::map<std::string, std::vector<int>> rangeSet;
 
@@ -49,28 +48,38 @@ ItemManager* ItemManager::LoadItemTemplates()
 		}
 	}
 
-	rs.close();
-
 	std::string equipmentFilename = "RCK/scripts/equipment.json";
 	std::string decorationFilename = "RCK/scripts/decoration.json";
 	
-	std::ifstream is(equipmentFilename);
-	std::ifstream ds(decorationFilename);
-
-	ItemManager* output = new ItemManager(jsoncons::decode_json<TemplateSet>(is), jsoncons::decode_json<DecorationSet>(ds),rangeSet,rangePenalties);
+	ItemManager* output = new ItemManager(DataPack::LoadJson<TemplateSet>(equipmentFilename), DataPack::LoadJson<DecorationSet>(decorationFilename),rangeSet,rangePenalties);
 
-	gLog->Log("Item Loader", "Decoded " + equipmentFilename);
-	gLog->Log("Item Loader", "Decoded " + decorationFilename);
+	RCK_LOG_INFO("Item Loader", "Decoded " + equipmentFilename);
+	RCK_LOG_INFO("Item Loader", "Decoded " + decorationFilename);
 	
-	is.close();
-	ds.close();
-
 	// fill in the reverse lookups
 
 	for(int i=0; i<output->itemTemplates.ItemTemplates().size();i++)
 	{
 		const ItemTemplate& it = output->itemTemplates.ItemTemplates()[i];
 		output->reverseTemplateDictionary[it.Name()] = i;
+
+		// every tag an item can end up with comes from a template, so they can all be given a bit now
+		for (const std::string& tag : it.EquipmentTags())
+		{
+			output->RegisterTag(tag);
+		}
+		for (const MaterialType& mt : it.MaterialTypes())
+		{
+			for (const std::string& tag : mt.MaterialTags())
+			{
+				output->RegisterTag(tag);
+			}
+		}
+	}
+
+	if (output->tagNames.size() > ITEM_TAG_BITS)
+	{
+		RCK_LOG_ERROR("Item Loader", "More than " + std::to_string(ITEM_TAG_BITS) + " item tags, the extra ones will never match");
 	}
 
 	for (int i = 0; i < output->decorations.Decorations().size(); i++)
@@ -79,7 +88,7 @@ ItemManager* ItemManager::LoadItemTemplates()
 		output->reverseTemplateDictionary[it.Tag()] = i;
 	}
 
-	gLog->Log("Item Loader", "Completed");
+	RCK_LOG_INFO("Item Loader", "Completed");
 	
 	return output;
 }
@@ -95,21 +104,22 @@ int ItemManager::GenerateItemFromTemplate(int templateID)
 	// item generation!
 	// start with base item, then go through material generation and generate decorations
 
-	int output = items.nextID++;
+	int output = items.ids.Allocate();
+	ResizeColumns();
 
 	const ItemTemplate& it = itemTemplates.ItemTemplates().at(templateID);
 
 
 	// copy base elements
-	items.Name.push_back(it.Name());
-	items.Visual.push_back(it.Visual());
+	items.Name[output] = it.Name();
+	items.Visual[output] = it.Visual();
 	int baseValue = it.Value();
 	std::vector<std::string> tags;
 	auto& eTags = it.EquipmentTags();
 	tags.insert(tags.end(), eTags.begin(), eTags.end());
 
-	items.WeightDen.push_back(it.WeightDen());
-	items.WeightNum.push_back(it.WeightNum());
+	items.WeightDen[output] = it.WeightDen();
+	items.WeightNum[output] = it.WeightNum();
 
 	// generate material
 	std::vector<int> probs;
@@ -121,7 +131,7 @@ int ItemManager::GenerateItemFromTemplate(int templateID)
 		maxProb += chance;
 	}
 
-	int select = rand() % maxProb;
+	int select = gGame->randomiser->getInt(0, maxProb - 1);
 	int result = probs.size() - 1;
 	for (int i = 0; i < probs.size(); i++)
 	{
@@ -138,8 +148,8 @@ int ItemManager::GenerateItemFromTemplate(int templateID)
 	std::string shortDesc = "a " + material.Name() + " " + it.Name();
 	std::string longDesc = "A " + it.Name() + ". It is made from " + material.Name() + ".";
 
-	items.LongDescription.push_back(longDesc);
-	items.ShortDescription.push_back(shortDesc);
+	items.LongDescription[output] = longDesc;
+	items.ShortDescription[output] = shortDesc;
 	
 	int undecoratedValue = material.ValueMultiplier() * baseValue;
 
@@ -157,63 +167,127 @@ int ItemManager::GenerateItemFromTemplate(int templateID)
 	int decorationValue = decorationBaseValue * decorationMaterialValue;
 	// value = base value * material multiplier + decoration value * material multiplier
 
-	items.Value.push_back(undecoratedValue + decorationValue);
+	items.Value[output] = undecoratedValue + decorationValue;
 
 	// add collated tags
 
-	items.Tags.push_back(tags);
-
+	items.Tags[output] = tags;
+	CompileItem(output);
 
 	return output;
 }
 
-int ItemManager::getRangePenalty(int id, int range)
+void ItemManager::ResizeColumns()
 {
-	for (auto p : rangeDictionary) 
+	int size = items.ids.GetCapacity();
+	if (size <= (int)items.Name.size())
+		return;
+
+	items.Visual.resize(size);
+	items.Name.resize(size);
+	items.ShortDescription.resize(size);
+	items.LongDescription.resize(size);
+	items.Value.resize(size);
+	items.Tags.resize(size);
+	items.WeightDen.resize(size);
+	items.WeightNum.resize(size);
+	items.TagMasks.resize(size);
+	items.Profiles.resize(size);
+}
+
+int ItemManager::RegisterTag(const std::string& tag)
+{
+	auto it = tagLookup.find(tag);
+	if (it != tagLookup.end())
 	{
-		if(hasTag(id, p.first))
-		{
-			// we have the tag for this item, so return the penalty at this range (or -255 if no shot)
-			return getRangePenalty(p.first, range);
-		}
+		return it->second;
 	}
 
-	// item has no matching tag, so -255 for no shot
-	return -255;
+	int index = tagNames.size();
+	tagLookup[tag] = index;
+	tagNames.push_back(tag);
+	return index;
 }
 
-int ItemManager::getMaxRange(int id)
+void ItemManager::CompileItem(int id)
 {
-	for (auto p : rangeDictionary)
+	ItemTagMask& mask = items.TagMasks[id];
+	mask.reset();
+	for (const std::string& tag : items.Tags[id])
+	{
+		int index = GetTagIndex(tag);
+		if (index >= 0 && index < ITEM_TAG_BITS)
+		{
+			mask.set(index);
+		}
+	}
+
+	ItemProfile profile;
+
+	for (const std::string& tag : items.Tags[id])
+	{
+		const std::string pre = "AC|";
+		if (tag.compare(0, pre.size(), pre) == 0)
+		{
+			profile.ACBonus = atoi(tag.c_str() + pre.size());
+			break;
+		}
+	}
+
+	// one hand: d6, d4 if Light, d2 if Grab (bolas, whips etc). Two hands: d8 for a bastard weapon, d10 for a full two-hander.
+	if (mask.test(ITEM_TAG_LIGHT)) profile.DamageDieOneHand = 4;
+	if (mask.test(ITEM_TAG_GRAB)) profile.DamageDieOneHand = 2;
+	if (mask.test(ITEM_TAG_ONE_HANDED)) profile.DamageDieTwoHands = 8;
+
+	// bow weapons are an exception to the usual damage pattern.
+	if (mask.test(ITEM_TAG_BOWS) || mask.test(ITEM_TAG_CROSSBOWS))
+	{
+		profile.DamageDieOneHand = 6;
+		profile.DamageDieTwoHands = 6;
+	}
+
+	// the first tag in ranges.csv (by name) that the item has gives its range bands
+	for (const auto& p : rangeDictionary)
 	{
 		if (hasTag(id, p.first))
 		{
-			// we have the tag for this item, so return the penalty at this range (or -255 if no shot)
-			std::vector<int> rangeList = rangeDictionary[p.first];
-			return rangeList[LONG_RANGE];
+			profile.HasRange = true;
+			for (int i = 0; i < RANGE_MAX; i++)
+			{
+				profile.Range[i] = p.second[i];
+			}
+			break;
 		}
 	}
 
-	// item has no matching tag, so -255 for no shot
-	return -255;
+	items.Profiles[id] = profile;
 }
 
-int ItemManager::getRangePenalty(std::string tag, int range)
+int ItemManager::getRangePenalty(int id, int range)
 {
-	// this function is to be used when/if the relevant tag has already been located
-	std::vector<int> rangeList = rangeDictionary[tag];
+	const ItemProfile& profile = items.Profiles[id];
+
+	// item has no range bands, so -255 for no shot
+	if (!profile.HasRange)
+		return -255;
+
 	for(int i = 0;i<RANGE_MAX;i++)
 	{
-		int r = rangeList[i];
-		if(range<r)
+		if(range<profile.Range[i])
 		{
 			return rangePenalties[i];
 		}
 	}
-	// longer than long range for this tag, penalty is -255 (will be flagged as "no shot")
+	// longer than long range for this item, penalty is -255 (will be flagged as "no shot")
 	return -255;
 }
 
+int ItemManager::getMaxRange(int id)
+{
+	const ItemProfile& profile = items.Profiles[id];
+	return profile.HasRange ? profile.Range[LONG_RANGE] : -255;
+}
+
 double ItemManager::getWeight(std::vector<int> items)
 {
 	double total = 0;
@@ -238,12 +312,44 @@ double ItemManager::getWeight(std::list<int> items)
 	return total;
 }
 
-bool ItemManager::hasTag(int id, std::string tag)
+void ItemManager::DebugLog(std::string message)
 {
-	return std::find(items.Tags[id].begin(), items.Tags[id].end(), tag) != items.Tags[id].end();
+	DEBUG_LOG(message);
 }
 
-void ItemManager::DebugLog(std::string message)
+void ItemManager::SaveSnapshot(SnapshotWriter& w)
+{
+	w.Section("ITEM");
+	items.ids.Save(w);
+	w.Write(items.Name);
+	w.Write(items.Visual);
+	w.Write(items.ShortDescription);
+	w.Write(items.LongDescription);
+	w.Write(items.Value);
+	w.Write(items.Tags);
+	w.Write(items.WeightDen);
+	w.Write(items.WeightNum);
+}
+
+bool ItemManager::LoadSnapshot(SnapshotReader& r)
 {
-	gLog->Log("ItemManager", message);
+	if (!r.Section("ITEM"))
+		return false;
+	items.ids.Load(r);
+	r.Read(items.Name);
+	r.Read(items.Visual);
+	r.Read(items.ShortDescription);
+	r.Read(items.LongDescription);
+	r.Read(items.Value);
+	r.Read(items.Tags);
+	r.Read(items.WeightDen);
+	r.Read(items.WeightNum);
+
+	items.TagMasks.assign(items.Tags.size(), ItemTagMask());
+	items.Profiles.assign(items.Tags.size(), ItemProfile());
+	for (int i = 0; i < items.Tags.size(); i++)
+	{
+		CompileItem(i);
+	}
+	return r.Ok();
 }
@@ -0,0 +1,299 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// which system's worker the current thread is, so Submit and Wait know whose queue and scratch to use
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local int currentWorker = -1;
+
+void* ScratchArena::Allocate(size_t bytes, size_t align)
+{
+	while (true)
+	{
+		if (block < blocks.size())
+		{
+			Block& b = blocks[block];
+			size_t start = (offset + align - 1) & ~(align - 1);
+			if (start + bytes <= b.size)
+			{
+				offset = start + bytes;
+				return b.memory.get() + start;
+			}
+
+			// doesn't fit, move on to the next block (or make one)
+			block++;
+			offset = 0;
+			continue;
+		}
+
+		Block b;
+		b.size = std::max(BLOCK_SIZE, bytes + align);
+		b.memory.reset(new char[b.size]);
+		blocks.push_back(std::move(b));
+		block = blocks.size() - 1;
+		offset = 0;
+	}
+}
+
+size_t ScratchArena::GetCapacity() const
+{
+	size_t total = 0;
+	for (const Block& b : blocks)
+		total += b.size;
+	return total;
+}
+
+JobSystem::JobSystem(int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		queues.emplace_back(new WorkerQueue());
+		arenas.emplace_back(new ScratchArena());
+	}
+
+	// the creating thread is worker 0 and does its share while it waits. If it's already worker 0 of another system (a second,
+	// short-lived one for a benchmark say) it stays that one's, and this system treats it as an outsider and runs its jobs inline.
+	if (currentSystem == nullptr)
+	{
+		currentSystem = this;
+		currentWorker = 0;
+	}
+
+	for (int i = 1; i < threadCount; i++)
+	{
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& t : workers)
+	{
+		t.join();
+	}
+
+	if (currentSystem == this)
+	{
+		currentSystem = nullptr;
+		currentWorker = -1;
+	}
+}
+
+int JobSystem::CurrentWorker() const
+{
+	return currentSystem == this ? currentWorker : -1;
+}
+
+void JobSystem::WorkerLoop(int worker)
+{
+	currentSystem = this;
+	currentWorker = worker;
+
+	Job job;
+	while (true)
+	{
+		if (TakeJob(worker, job))
+		{
+			RunJob(worker, job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(sleepLock);
+		wake.wait(guard, [this]() { return stopping || queued.load() > 0; });
+		if (stopping)
+			return;
+	}
+}
+
+void JobSystem::Push(int worker, Job job)
+{
+	{
+		std::lock_guard<std::mutex> guard(queues[worker]->lock);
+		queues[worker]->jobs.push_back(std::move(job));
+	}
+	queued++;
+}
+
+bool JobSystem::TakeJob(int worker, Job& out)
+{
+	if (queued.load() == 0)
+		return false;
+
+	// our own newest first
+	{
+		WorkerQueue& own = *queues[worker];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.jobs.empty())
+		{
+			out = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			queued--;
+			return true;
+		}
+	}
+
+	// then someone else's oldest, starting with our neighbour so the thieves spread out
+	int count = (int)queues.size();
+	for (int i = 1; i < count; i++)
+	{
+		WorkerQueue& victim = *queues[(worker + i) % count];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.jobs.empty())
+		{
+			out = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			queued--;
+			jobsStolen++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(Job& job, JobContext& context)
+{
+	// an exception can't be let out here - whoever's waiting would never see the job finish. Keep the first for Wait to rethrow.
+	try
+	{
+		job.run(context);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> guard(job.state->lock);
+		if (!job.state->firstError)
+			job.state->firstError = std::current_exception();
+	}
+}
+
+void JobSystem::RunJob(int worker, Job& job)
+{
+	ScratchArena& scratch = *arenas[worker];
+	ScratchArena::Marker marker = scratch.GetMarker();
+	JobContext context{ worker, scratch };
+
+	Execute(job, context);
+
+	scratch.Rewind(marker);
+	jobsRun++;
+	job.state->pending.fetch_sub(1);
+	job = Job();
+}
+
+JobHandle JobSystem::Submit(std::function<void(JobContext&)> run)
+{
+	JobHandle handle;
+	handle.state = std::make_shared<JobState>(1);
+
+	Job job{ std::move(run), handle.state };
+	int worker = CurrentWorker();
+	if (worker == -1)
+	{
+		// not one of ours, so there's no queue or scratch to use - just do it now
+		ScratchArena scratch;
+		JobContext context{ -1, scratch };
+		Execute(job, context);
+		jobsRun++;
+		job.state->pending.fetch_sub(1);
+		return handle;
+	}
+
+	if (IsInline())
+	{
+		RunJob(worker, job);
+		return handle;
+	}
+
+	Push(worker, std::move(job));
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	wake.notify_one();
+	return handle;
+}
+
+void JobSystem::Wait(const JobHandle& handle)
+{
+	int worker = CurrentWorker();
+	Job job;
+	while (!handle.IsDone())
+	{
+		// help out rather than sit there. Whatever's left of ours is probably running on another worker, so yield if there's nothing to take.
+		if (worker != -1 && TakeJob(worker, job))
+			RunJob(worker, job);
+		else
+			std::this_thread::yield();
+	}
+
+	if (handle.state)
+	{
+		std::lock_guard<std::mutex> guard(handle.state->lock);
+		if (handle.state->firstError)
+			std::rethrow_exception(handle.state->firstError);
+	}
+}
+
+void JobSystem::ParallelFor(int count, int grain, const std::function<void(int, int, JobContext&)>& fn)
+{
+	if (count <= 0)
+		return;
+	grain = std::max(1, grain);
+
+	int worker = CurrentWorker();
+	if (worker == -1 || IsInline() || count <= grain)
+	{
+		// same chunks, in order, right here
+		ScratchArena local;
+		ScratchArena& scratch = worker == -1 ? local : *arenas[worker];
+		JobContext context{ worker, scratch };
+		for (int begin = 0; begin < count; begin += grain)
+		{
+			ScratchArena::Marker marker = scratch.GetMarker();
+			try
+			{
+				fn(begin, std::min(begin + grain, count), context);
+			}
+			catch (...)
+			{
+				scratch.Rewind(marker);
+				throw;
+			}
+			scratch.Rewind(marker);
+		}
+		return;
+	}
+
+	JobHandle handle;
+	int chunks = (count + grain - 1) / grain;
+	handle.state = std::make_shared<JobState>(chunks);
+
+	// pushed last chunk first, so we work forward from the start off the back of our queue while thieves take the far end off the front
+	for (int c = chunks - 1; c >= 0; c--)
+	{
+		int begin = c * grain;
+		int end = std::min(begin + grain, count);
+		Push(worker, Job{ [&fn, begin, end](JobContext& context) { fn(begin, end, context); }, handle.state });
+	}
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	wake.notify_all();
+
+	Wait(handle);
+}
+
+size_t JobSystem::GetScratchBytes() const
+{
+	size_t total = 0;
+	for (const std::unique_ptr<ScratchArena>& arena : arenas)
+		total += arena->GetCapacity();
+	return total;
+}
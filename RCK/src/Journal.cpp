@@ -0,0 +1,119 @@
+#include "Journal.h"
+
+#include <cstring>
+
+static const char journalMagic[8] = { 'R','C','K','J','R','N','L','\0' };
+
+bool SessionJournal::OpenForRecord(std::string filename, uint32_t seed, uint32_t checkpointInterval)
+{
+	Close();
+
+	file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	memcpy(header.magic, journalMagic, sizeof(header.magic));
+	header.version = JOURNAL_VERSION;
+	header.recordSize = sizeof(JournalRecord);
+	header.seed = seed;
+	header.checkpointInterval = checkpointInterval;
+	file.write((const char*)&header, sizeof(header));
+	file.flush();
+
+	recording = true;
+	keyCount = 0;
+	return true;
+}
+
+bool SessionJournal::OpenForReplay(std::string filename)
+{
+	Close();
+
+	file.open(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, journalMagic, sizeof(header.magic)) != 0
+		|| header.version != JOURNAL_VERSION || header.recordSize != sizeof(JournalRecord))
+	{
+		file.close();
+		return false;
+	}
+
+	recording = false;
+	keyCount = 0;
+	return true;
+}
+
+void SessionJournal::Close()
+{
+	if (file.is_open())
+		file.close();
+	recording = false;
+}
+
+void SessionJournal::RecordKey(const TCOD_key_t& key, long double gameTime)
+{
+	if (!IsRecording())
+		return;
+
+	JournalRecord r = {};
+	r.type = JOURNAL_KEY;
+	r.keyIndex = keyCount;
+	r.gameTime = (double)gameTime;
+	r.vk = key.vk;
+	r.c = key.c;
+	r.flags = (key.pressed ? JKF_PRESSED : 0) | (key.lalt ? JKF_LALT : 0) | (key.lctrl ? JKF_LCTRL : 0) | (key.lmeta ? JKF_LMETA : 0)
+		| (key.ralt ? JKF_RALT : 0) | (key.rctrl ? JKF_RCTRL : 0) | (key.rmeta ? JKF_RMETA : 0) | (key.shift ? JKF_SHIFT : 0);
+
+	// flushed every time - key presses are rare, and we want the journal intact if the game falls over
+	file.write((const char*)&r, sizeof(r));
+	file.flush();
+
+	keyCount++;
+}
+
+void SessionJournal::RecordCheckpoint(uint64_t hash, long double gameTime)
+{
+	if (!IsRecording())
+		return;
+
+	JournalRecord r = {};
+	r.type = JOURNAL_CHECKPOINT;
+	r.keyIndex = keyCount;
+	r.hash = hash;
+	r.gameTime = (double)gameTime;
+
+	file.write((const char*)&r, sizeof(r));
+	file.flush();
+}
+
+bool SessionJournal::ReadNext(JournalRecord& record)
+{
+	if (recording || !file.is_open())
+		return false;
+
+	if (!file.read((char*)&record, sizeof(record)))
+		return false;
+
+	if (record.type == JOURNAL_KEY)
+		keyCount++;
+
+	return true;
+}
+
+TCOD_key_t SessionJournal::ToKey(const JournalRecord& record)
+{
+	TCOD_key_t key = {};
+	key.vk = (TCOD_keycode_t)record.vk;
+	key.c = (char)record.c;
+	key.pressed = (record.flags & JKF_PRESSED) != 0;
+	key.lalt = (record.flags & JKF_LALT) != 0;
+	key.lctrl = (record.flags & JKF_LCTRL) != 0;
+	key.lmeta = (record.flags & JKF_LMETA) != 0;
+	key.ralt = (record.flags & JKF_RALT) != 0;
+	key.rctrl = (record.flags & JKF_RCTRL) != 0;
+	key.rmeta = (record.flags & JKF_RMETA) != 0;
+	key.shift = (record.flags & JKF_SHIFT) != 0;
+	return key;
+}
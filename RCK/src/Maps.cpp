@@ -1,14 +1,21 @@
 #include "Maps.h"
+#include <chrono>
 #include <sstream>
 #include <string>
 #include "Game.h"
+#include "DataPack.h"
+#include "Pathing.h"
+#include "Snapshot.h"
+#include "Visibility.h"
 
 void Map::setMob(int x, int y, int mobID)
 {
-	if (std::find(mobs.begin(), mobs.end(), mobID) == mobs.end())
+	OccupantHandle h = PackOccupant(MANAGER_MOB, mobID);
+	if (occupantCells.find(h) == occupantCells.end())
 	{
 		mobs.push_back(mobID);
 	}
+	placeOccupant(h, x, y);
 
 	gGame->mMobManager->SetMobX(mobID, x);
 	gGame->mMobManager->SetMobY(mobID, y);
@@ -16,10 +23,13 @@ void Map::setMob(int x, int y, int mobID)
 
 void Map::setCharacter(int x, int y, int characterID)
 {
-	if (std::find(characters.begin(), characters.end(), characterID) == characters.end())
+	OccupantHandle h = PackOccupant(MANAGER_CHARACTER, characterID);
+	if (occupantCells.find(h) == occupantCells.end())
 	{
 		characters.push_back(characterID);
 	}
+	placeOccupant(h, x, y);
+
 	// then update it
 	gGame->mCharacterManager->SetPlayerX(characterID,x);
 	gGame->mCharacterManager->SetPlayerY(characterID,y);
@@ -27,36 +37,12 @@ void Map::setCharacter(int x, int y, int characterID)
 
 int Map::getCharacterAt(int x, int y)
 {
-	int found = 0;
-
-	auto g = std::find_if(
-		characters.begin(), characters.end(),
-		[&](int charID) { return ((gGame->mCharacterManager->GetPlayerX(charID) == x) && (gGame->mCharacterManager->GetPlayerY(charID) == y)); }
-	);
-
-	if (g != characters.end())
-	{
-		found = *g;
-	}
-
-	return found;
+	return findOccupant(x, y, MANAGER_CHARACTER);
 }
 
 int Map::getMobAt(int x, int y)
 {
-	int found = 0;
-
-	auto g = std::find_if(
-		mobs.begin(), mobs.end(),
-		[&](int mobID) { return ((gGame->mMobManager->GetMobX(mobID) == x) && (gGame->mMobManager->GetMobY(mobID) == y)); }
-	);
-
-	if (g != mobs.end())
-	{
-		found = *g;
-	}
-
-	return found;
+	return findOccupant(x, y, MANAGER_MOB);
 }
 
 void Map::getManagedEntityAt(int x, int y, int& manager, int& entityID)
@@ -75,35 +61,134 @@ void Map::getManagedEntityAt(int x, int y, int& manager, int& entityID)
 	if (m != 0)
 	{
 		manager = MANAGER_MOB;
-		entityID = manager;
+		entityID = m;
 		return;
 	}
 
-	c = 0;
+	entityID = 0;
 }
 
 int Map::removeCharacter(int characterID)
 {
-	auto p = std::find(characters.begin(), characters.end(), characterID);
-
-	if(p == characters.end())
+	if (!removeOccupant(PackOccupant(MANAGER_CHARACTER, characterID)))
 	{
 		return 0;
 	}
 
-	return *p;
+	characters.erase(std::find(characters.begin(), characters.end(), characterID));
+	return characterID;
 }
 
 int Map::removeMob(int mobID)
 {
-	auto p = std::find(mobs.begin(), mobs.end(), mobID);
+	if (!removeOccupant(PackOccupant(MANAGER_MOB, mobID)))
+	{
+		return 0;
+	}
+
+	mobs.erase(std::find(mobs.begin(), mobs.end(), mobID));
+	return mobID;
+}
+
+void Map::placeOccupant(OccupantHandle h, int x, int y)
+{
+	// moving within the map is a remove from the old cell then an add to the new one
+	removeOccupant(h);
+
+	int cell = y * width + x;
+	if (occupancy[cell] == OCCUPANT_NONE)
+	{
+		occupancy[cell] = h;
+	}
+	else
+	{
+		occupancyOverflow[cell].push_back(h);
+	}
+	occupantCells[h] = cell;
+}
+
+bool Map::removeOccupant(OccupantHandle h)
+{
+	auto where = occupantCells.find(h);
+	if (where == occupantCells.end())
+	{
+		return false;
+	}
+
+	int cell = where->second;
+	occupantCells.erase(where);
+
+	auto overflow = occupancyOverflow.find(cell);
+	if (occupancy[cell] == h)
+	{
+		// promote the next one in, if there's anyone else here
+		if (overflow != occupancyOverflow.end())
+		{
+			occupancy[cell] = overflow->second.front();
+			overflow->second.erase(overflow->second.begin());
+		}
+		else
+		{
+			occupancy[cell] = OCCUPANT_NONE;
+		}
+	}
+	else if (overflow != occupancyOverflow.end())
+	{
+		overflow->second.erase(std::find(overflow->second.begin(), overflow->second.end(), h));
+	}
 
-	if (p == mobs.end())
+	if (overflow != occupancyOverflow.end() && overflow->second.empty())
 	{
+		occupancyOverflow.erase(overflow);
+	}
+
+	return true;
+}
+
+int Map::findOccupant(int x, int y, int manager)
+{
+	// 0 means nobody, same as the old list searches
+	if (x < 0 || y < 0 || x >= width || y >= height)
+		return 0;
+
+	int cell = y * width + x;
+	OccupantHandle h = occupancy[cell];
+	if (h == OCCUPANT_NONE)
 		return 0;
+
+	if (OccupantManager(h) == manager)
+		return OccupantID(h);
+
+	auto overflow = occupancyOverflow.find(cell);
+	if (overflow != occupancyOverflow.end())
+	{
+		for (OccupantHandle o : overflow->second)
+		{
+			if (OccupantManager(o) == manager)
+				return OccupantID(o);
+		}
 	}
 
-	return *p;
+	return 0;
+}
+
+void Map::getOccupantsAt(int x, int y, std::vector<OccupantHandle>& out)
+{
+	out.clear();
+	if (x < 0 || y < 0 || x >= width || y >= height)
+		return;
+
+	int cell = y * width + x;
+	if (occupancy[cell] == OCCUPANT_NONE)
+		return;
+
+	out.push_back(occupancy[cell]);
+
+	auto overflow = occupancyOverflow.find(cell);
+	if (overflow != occupancyOverflow.end())
+	{
+		out.insert(out.end(), overflow->second.begin(), overflow->second.end());
+	}
 }
 
 void MapManager::GeneratePrefabs()
@@ -212,13 +297,13 @@ void MapManager::GeneratePrefabs()
 
 	for (TerrainType t : terrainTypes.TerrainTypes())
 	{
-		gLog->Log("MapManager", "Loading Prefabs for Terrain Type:" + t.Name());
+		RCK_LOG_DEBUG(LogCategory, "Loading Prefabs for Terrain Type:" + t.Name());
 
 		std::vector<std::vector<std::string>> prefabSet;
 
 		for (std::string prefabPath : t.Prefabs())
 		{
-			gLog->Log("MapManager", "Loading Prefab:" + prefabPath);
+			RCK_LOG_DEBUG(LogCategory, "Loading Prefab:" + prefabPath);
 			prefabPath = "RCK/prefabs/" + prefabPath;
 			std::vector<std::string> prefabMap;
 
@@ -244,11 +329,14 @@ MapManager::MapManager(TerrainTypeSet& tts) : terrainTypes(tts)
 {
 	//GeneratePrefabs();
 	mapStore.push_back(NULL);
+	pathPlanner = new PathPlanner(this);
+	visibility = new VisibilityService(this);
 }
 
 MapManager::~MapManager()
 {
-
+	delete pathPlanner;
+	delete visibility;
 }
 
 Map* MapManager::getMap(int index)
@@ -290,6 +378,7 @@ int MapManager::createMap(bool outdoor)
 bool MapManager::isInFOV(int sourceManager, int sourceID, int targetManager, int targetID, int range)
 {
 	int baseX, baseY;
+	int mapID = -1;	// the source's own map, whatever's on screen
 
 	switch (sourceManager)
 	{
@@ -297,6 +386,7 @@ bool MapManager::isInFOV(int sourceManager, int sourceID, int targetManager, int
 		{
 			baseX = gGame->mCharacterManager->GetPlayerX(sourceID);
 			baseY = gGame->mCharacterManager->GetPlayerY(sourceID);
+			mapID = gGame->mCharacterManager->GetPlayerMap(sourceID);
 		}
 		break;
 
@@ -304,20 +394,20 @@ bool MapManager::isInFOV(int sourceManager, int sourceID, int targetManager, int
 		{
 			baseX = gGame->mMobManager->GetMobX(sourceID);
 			baseY = gGame->mMobManager->GetMobY(sourceID);
+			mapID = gGame->mMobManager->GetMobMap(sourceID);
 		}
 	break;
 	}
 
-	Map* m = getMap(gGame->GetCurrentMap());
-	m->map->computeFov(baseX, baseY, range, true, FOV_BASIC);
-
 	int targetX, targetY;
+	int targetMap = -1;
 	switch (targetManager)
 	{
 		case MANAGER_CHARACTER:
 		{
 			targetX = gGame->mCharacterManager->GetPlayerX(targetID);
 			targetY = gGame->mCharacterManager->GetPlayerY(targetID);
+			targetMap = gGame->mCharacterManager->GetPlayerMap(targetID);
 		}
 		break;
 
@@ -325,11 +415,17 @@ bool MapManager::isInFOV(int sourceManager, int sourceID, int targetManager, int
 		{
 			targetX = gGame->mMobManager->GetMobX(targetID);
 			targetY = gGame->mMobManager->GetMobY(targetID);
+			targetMap = gGame->mMobManager->GetMobMap(targetID);
 		}
 		break;
 	}
 
-	return m->map->isInFov(targetX, targetY);
+	// nobody sees across maps
+	if (mapID < 0 || targetMap != mapID)
+		return false;
+
+	// a single target only needs a ray, not a whole FOV
+	return visibility->HasLineOfSight(mapID, baseX, baseY, targetX, targetY, range);
 
 }
 
@@ -338,6 +434,7 @@ std::vector<int> MapManager::filterByFOV(int sourceManager, int sourceID, int ta
 	std::vector<int> output;
 
 	int baseX, baseY;
+	int mapID = -1;
 
 	switch (sourceManager)
 	{
@@ -345,6 +442,7 @@ std::vector<int> MapManager::filterByFOV(int sourceManager, int sourceID, int ta
 		{
 			baseX = gGame->mCharacterManager->GetPlayerX(sourceID);
 			baseY = gGame->mCharacterManager->GetPlayerY(sourceID);
+			mapID = gGame->mCharacterManager->GetPlayerMap(sourceID);
 		}
 		break;
 
@@ -352,24 +450,26 @@ std::vector<int> MapManager::filterByFOV(int sourceManager, int sourceID, int ta
 		{
 			baseX = gGame->mMobManager->GetMobX(sourceID);
 			baseY = gGame->mMobManager->GetMobY(sourceID);
+			mapID = gGame->mMobManager->GetMobMap(sourceID);
 		}
 		break;
 	}
 
-	Map* m = getMap(gGame->GetCurrentMap());
-	m->map->computeFov(baseX, baseY, range, true,FOV_BASIC);
+	// the observer's own cached FOV (on the observer's own map), so this neither recomputes it every time nor touches the player's
+	if (mapID < 0)
+		return output;
 
-	gGame->RecalculateFOV(); // this makes the player fix the FOV next time we render
-	
 	for(int target : targets)
 	{
 		int targetX, targetY;
+		int targetMap = -1;
 		switch(targetManager)
 		{
 		case MANAGER_CHARACTER:
 			{
 				targetX = gGame->mCharacterManager->GetPlayerX(target);
 				targetY = gGame->mCharacterManager->GetPlayerY(target);
+				targetMap = gGame->mCharacterManager->GetPlayerMap(target);
 			}
 			break;
 
@@ -377,11 +477,15 @@ std::vector<int> MapManager::filterByFOV(int sourceManager, int sourceID, int ta
 			{
 				targetX = gGame->mMobManager->GetMobX(target);
 				targetY = gGame->mMobManager->GetMobY(target);
+				targetMap = gGame->mMobManager->GetMobMap(target);
 			}
 			break;
 		}
+
+		if (targetMap != mapID)
+			continue;
 		
-		bool fov = m->map->isInFov(targetX, targetY);
+		bool fov = visibility->CanSee(sourceManager, sourceID, mapID, baseX, baseY, targetX, targetY, range);
 		if (fov)
 			output.push_back(target);
 	}
@@ -393,13 +497,11 @@ std::vector<int> MapManager::filterByFOV(int sourceManager, int sourceID, int ta
 MapManager* MapManager::LoadMaps()
 {
 	
-	gLog->Log("Map Manager", "Started");
+	RCK_LOG_INFO(LogCategory, "Started");
 
 	const std::string mapsFilename = "RCK/prefabs/maps.json";
 
-	std::ifstream is(mapsFilename);
-
-	MapManager* newManager = new MapManager(jsoncons::decode_json<TerrainTypeSet>(is));
+	MapManager* newManager = new MapManager(DataPack::LoadJson<TerrainTypeSet>(mapsFilename));
 
 	// load prefabs (could do this later?)
 
@@ -449,8 +551,8 @@ int MapManager::buildEmptyMap(int width, int height, int type)
 	newMap->transition.resize(width * height);
 	newMap->items.resize(width * height);
 
-	newMap->mobs.resize(width * height);
-	newMap->characters.resize(width * height);
+	newMap->occupancy.resize(width * height, OCCUPANT_NONE);
+	newMap->walkCost.resize(width * height, content_move_cost[CONTENT_NONE]);
 	
 	newMap->map = new TCODMap(width, height);
     newMap->map->clear(true, true);
@@ -509,16 +611,16 @@ int MapManager::buildMapFromText(std::vector<std::string> hmap,bool outdoor)
 			int cell_y = (int)y;
 			if (value == '.')
 			{
-				newMap->map->setProperties(cell_x, cell_y, true, true);	// ground
+				newMap->setProperties(cell_x, cell_y, true, true);	// ground
 			}
 			if (value == 'T')
 			{
-				newMap->map->setProperties(cell_x, cell_y, true, false);		// tree
+				newMap->setProperties(cell_x, cell_y, true, false);		// tree
 				newMap->setContent(cell_x, cell_y, CONTENT_TREE);
 			}
 			if (value == '#')
 			{
-				newMap->map->setProperties(cell_x, cell_y, false, false); // wall
+				newMap->setProperties(cell_x, cell_y, false, false); // wall
 				newMap->setContent(cell_x, cell_y, outdoor ? CONTENT_ROCKS : CONTENT_WALL);
 			}
 		}
@@ -630,7 +732,7 @@ float MapManager::getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* user
 		if (mapStore[mapID]->outdoor)
 		{
 			// if the value is in the hex move map, we can move there, otherwise we can't
-			bool odd = !yFrom & 0x1;
+			bool odd = yFrom & 0x1;
 			bool found = false;
 			for (int i = 0; i < 6; i++)
 			{
@@ -691,7 +793,7 @@ void MapManager::connectMaps(int map1, int map2, int x1, int y1, int x2, int y2)
 	}
 
 	// connect map1 to map2
-	m1->map->setProperties(x1, y1, true, true);
+	m1->setProperties(x1, y1, true, true);
 	m1->setContent(x1, y1, type);
 	m1->setTransition(x1, y1, map2);
 
@@ -700,7 +802,7 @@ void MapManager::connectMaps(int map1, int map2, int x1, int y1, int x2, int y2)
 	m1->reverse_transition_ypos.push_back(y1);
 
 	// connect map2 to map1
-	m2->map->setProperties(x2, y2, true, true);
+	m2->setProperties(x2, y2, true, true);
 	m2->setContent(x2, y2, type);
 	m2->setTransition(x2, y2, map1);
 
@@ -900,10 +1002,10 @@ void MapManager::renderMap(TCODConsole* sampleConsole, int index, int centroid_x
 	for(int mob: map->mobs)
 	{
 		TCODColor baseColor = TCODColor::lighterGrey;
-		Creature& c = gGame->mMobManager->GetMonster(mob);
+		Creature c = gGame->mMobManager->GetMonster(mob);
 		std::string s = c.GetVisual();
 		int cs = s[0];
-		if (c.HasCondition("Unconscious")) baseColor = baseColor * TCODColor::grey;
+		if (c.HasCondition(gGame->mConditionManager->UnconsciousIndex)) baseColor = baseColor * TCODColor::grey;
 
 		renderAtPosition(sampleConsole, index, centroid_x, centroid_y, gGame->mMobManager->GetMobX(mob), gGame->mMobManager->GetMobY(mob), cs, baseColor);
 	}
@@ -995,6 +1097,7 @@ int MapManager::TakeTopItem(int mapID, int x, int y)
 	if (is->empty()) return -1;
 	int item = is->top();
 	is->pop();
+	mapStore[mapID]->itemVersion++;
 	return item;
 }
 
@@ -1059,7 +1162,243 @@ bool MapManager::isOutOfBounds(int mapID, int x, int y)
 	return in;
 }
 
+void MapManager::BenchmarkOccupancy(int mobCount)
+{
+	// Needs the managers loaded (StartGame) but no window. Everything goes through the real spawn/move code, so the numbers include the manager work too.
+	// The "scan" figure is the old find_if over the map's mob list, for comparison with the occupancy grid.
+
+	typedef std::chrono::high_resolution_clock clock;
+
+	auto nsPerOp = [](clock::time_point start, clock::time_point end, int ops)
+	{
+		return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+	};
+
+	// character 0 is the "nobody" character, same as the test game. Mob moves look at the selected character's position so it has to exist.
+	gGame->mCharacterManager->GenerateTestCharacter("NULL", "Fighter");
+
+	const int size = 1000;
+	int mapID = gGame->mMapManager->buildEmptyMap(size, size, MAP_WILDERNESS);
+	Map* m = gGame->mMapManager->getMap(mapID);
+
+	clock::time_point start = clock::now();
+	int firstMob = -1;
+	for (int i = 0; i < mobCount; i++)
+	{
+		int id = gGame->mMobManager->GenerateMonster("Goblin", mapID, size / 2, size / 2);
+		if (firstMob == -1) firstMob = id;
+	}
+	double spawnCost = nsPerOp(start, clock::now(), mobCount);
+
+	const int queries = 100000;
+	int hits = 0;
+	start = clock::now();
+	for (int i = 0; i < queries; i++)
+	{
+		int x = gGame->randomiser->getInt(0, size - 1);
+		int y = gGame->randomiser->getInt(0, size - 1);
+		if (m->getMobAt(x, y) || m->getCharacterAt(x, y)) hits++;
+	}
+	double lookupCost = nsPerOp(start, clock::now(), queries);
+
+	const int scanQueries = 1000;
+	start = clock::now();
+	for (int i = 0; i < scanQueries; i++)
+	{
+		int x = gGame->randomiser->getInt(0, size - 1);
+		int y = gGame->randomiser->getInt(0, size - 1);
+		auto g = std::find_if(m->mobs.begin(), m->mobs.end(),
+			[&](int mobID) { return gGame->mMobManager->GetMobX(mobID) == x && gGame->mMobManager->GetMobY(mobID) == y; });
+		if (g != m->mobs.end()) hits++;
+	}
+	double scanCost = nsPerOp(start, clock::now(), scanQueries);
+
+	start = clock::now();
+	for (int id = firstMob; id < firstMob + mobCount; id++)
+	{
+		int x = gGame->mMobManager->GetMobX(id) + gGame->randomiser->getInt(-1, 1);
+		int y = gGame->mMobManager->GetMobY(id) + gGame->randomiser->getInt(-1, 1);
+		gGame->mMobManager->MoveTo(id, x, y, 0);
+	}
+	double moveCost = nsPerOp(start, clock::now(), mobCount);
+
+	ReportLine(LogCategory, "%d goblins on %dx%d: spawn %.1fns, lookup %.1fns (scan %.1fns), move %.1fns (per op, %d hits)",
+		mobCount, size, size, spawnCost, lookupCost, scanCost, moveCost, hits);
+}
+
 void MapManager::DebugLog(std::string message)
 {
-	gLog->Log("MapManager", message);
+	DEBUG_LOG(message);
+}
+
+static void SaveCellFlags(SnapshotWriter& w, TCODMap* map, int width, int height)
+{
+	std::vector<unsigned char> flags(width * height);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			flags[y * width + x] = (map->isTransparent(x, y) ? 1 : 0) | (map->isWalkable(x, y) ? 2 : 0);
+		}
+	}
+	w.Write(flags);
+}
+
+static TCODMap* LoadCellFlags(SnapshotReader& r, int width, int height)
+{
+	std::vector<unsigned char> flags;
+	r.Read(flags);
+	if (!r.Ok() || width <= 0 || height <= 0 || flags.size() != (size_t)(width * height))
+		return NULL;
+
+	TCODMap* map = new TCODMap(width, height);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char f = flags[y * width + x];
+			map->setProperties(x, y, (f & 1) != 0, (f & 2) != 0);
+		}
+	}
+	return map;
+}
+
+void Map::SaveSnapshot(SnapshotWriter& w)
+{
+	w.Write(outdoor);
+	w.Write(mapType);
+	w.Write(width);
+	w.Write(height);
+	w.Write(version);
+	w.Write(itemVersion);
+
+	SaveCellFlags(w, map, width, height);
+	w.Write(walkCost);
+
+	w.Write(items);
+	w.Write(content);
+	w.Write(transition);
+
+	w.Write(reverse_transition_mapindex);
+	w.Write(reverse_transition_xpos);
+	w.Write(reverse_transition_ypos);
+
+	w.Write(mobs);
+	w.Write(characters);
+
+	w.Write(occupancy);
+	w.Write(occupancyOverflow);
+	w.Write(occupantCells);
+}
+
+bool Map::LoadSnapshot(SnapshotReader& r)
+{
+	r.Read(outdoor);
+	r.Read(mapType);
+	r.Read(width);
+	r.Read(height);
+	r.Read(version);
+	r.Read(itemVersion);
+
+	map = LoadCellFlags(r, width, height);
+	if (map == NULL)
+		return false;
+	r.Read(walkCost);
+
+	r.Read(items);
+	r.Read(content);
+	r.Read(transition);
+
+	r.Read(reverse_transition_mapindex);
+	r.Read(reverse_transition_xpos);
+	r.Read(reverse_transition_ypos);
+
+	r.Read(mobs);
+	r.Read(characters);
+
+	r.Read(occupancy);
+	r.Read(occupancyOverflow);
+	r.Read(occupantCells);
+
+	return r.Ok();
+}
+
+void MapManager::SaveSnapshot(SnapshotWriter& w)
+{
+	w.Section("MAPS");
+
+	w.Write(regionMap != NULL);
+	if (regionMap != NULL)
+	{
+		w.Write(regionMap->width);
+		w.Write(regionMap->height);
+		SaveCellFlags(w, regionMap->map, regionMap->width, regionMap->height);
+		w.Write(regionMap->localMap);
+		w.Write(regionMap->terrain);
+		w.Write(regionMap->sites);
+		w.Write(regionMap->bases);
+	}
+
+	// map 0 is the "no local map" placeholder
+	w.Write((uint64_t)mapStore.size());
+	for (size_t i = 1; i < mapStore.size(); i++)
+	{
+		mapStore[i]->SaveSnapshot(w);
+	}
+}
+
+bool MapManager::LoadSnapshot(SnapshotReader& r)
+{
+	if (!r.Section("MAPS"))
+		return false;
+
+	if (regionMap != NULL)
+	{
+		delete regionMap->map;
+		delete regionMap;
+		regionMap = NULL;
+	}
+	for (Map* m : mapStore)
+	{
+		if (m != NULL)
+		{
+			delete m->map;
+			delete m;
+		}
+	}
+	mapStore.assign(1, NULL);
+
+	bool hasRegion = false;
+	r.Read(hasRegion);
+	if (hasRegion)
+	{
+		createRegionMap();
+		r.Read(regionMap->width);
+		r.Read(regionMap->height);
+		regionMap->map = LoadCellFlags(r, regionMap->width, regionMap->height);
+		r.Read(regionMap->localMap);
+		r.Read(regionMap->terrain);
+		r.Read(regionMap->sites);
+		r.Read(regionMap->bases);
+		if (regionMap->map == NULL)
+			return false;
+	}
+
+	uint64_t count = 0;
+	r.Read(count);
+	for (uint64_t i = 1; i < count && r.Ok(); i++)
+	{
+		Map* m = new Map();
+		mapStore.push_back(m);
+		if (!m->LoadSnapshot(r))
+			return false;
+	}
+
+	// anything cached against the old maps is meaningless now
+	delete pathPlanner;
+	delete visibility;
+	pathPlanner = new PathPlanner(this);
+	visibility = new VisibilityService(this);
+
+	return r.Ok();
 }
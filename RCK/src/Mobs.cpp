@@ -1,22 +1,25 @@
 #include "Mobs.h"
 #include "Game.h"
+#include "DataPack.h"
+#include "Pathing.h"
+#include "Snapshot.h"
+#include "Visibility.h"
+#include "JobSystem.h"
+#include <algorithm>
 #include <string>
 #include <locale>
+#include <chrono>
 #include <cmath>
 
 MobManager* MobManager::LoadMobData()
 {
-	gLog->Log("Monster Loader", "Started");
+	RCK_LOG_INFO("Monster Loader", "Started");
 
 	std::string mobFilename = "RCK/scripts/creatures.json";
-	
-	std::ifstream is(mobFilename);
-
-	MobManager* output = new MobManager(jsoncons::decode_json<CreatureSet>(is));
 
-	is.close();
+	MobManager* output = new MobManager(DataPack::LoadJson<CreatureSet>(mobFilename));
 
-	gLog->Log("Monster Loader", "Decoded " + mobFilename);
+	RCK_LOG_INFO("Monster Loader", "Decoded " + mobFilename);
 	
 	const std::vector<CreatureTemplate>& creatureList = output->CreatureTemplates().CreatureTemplates();
 
@@ -26,9 +29,58 @@ MobManager* MobManager::LoadMobData()
 		
 		// add this class to the index list
 		output->creatureNameLookup[c.Name()] = i;
+
+		// and compile the parts every creature of this kind shares
+		CreatureProfile profile;
+		profile.Name = c.Name();
+		profile.Visual = c.Visual();
+		profile.SaveAs = c.SaveAs();
+		profile.Alignment = c.Alignment();
+		profile.HitDie = c.HitDie();
+		profile.HitDieModifier = c.HitDieModifier();
+		profile.ArmourClass = c.ArmourClass();
+		profile.Morale = c.Morale();
+		profile.Movement = c.Movement();
+		profile.XP = c.XP();
+
+		profile.Attacks = c.Attacks();
+		for (int a = 0; a < profile.Attacks.size(); a++)
+		{
+			profile.AttackLookup[profile.Attacks[a].Name()] = a;
+		}
+
+		for (const std::vector<std::string>& sequence : c.AttackSequences())
+		{
+			std::vector<int> resolved;
+			for (const std::string& attack : sequence)
+			{
+				auto it = profile.AttackLookup.find(attack);
+				if (it == profile.AttackLookup.end())
+				{
+					RCK_LOG_WARNING("Monster Loader", c.Name() + " attack sequence uses unknown attack " + attack);
+					continue;
+				}
+				resolved.push_back(it->second);
+			}
+			profile.AttackSequences.push_back(resolved);
+		}
+
+		profile.Abilities = c.Abilities();
+		for (const std::string& bs : c.Behaviours())
+		{
+			auto it = output->behaviourLookup.find(bs);
+			if (it == output->behaviourLookup.end())
+			{
+				RCK_LOG_WARNING("Monster Loader", c.Name() + " has unknown behaviour " + bs);
+				continue;
+			}
+			profile.Behaviours.push_back(it->second);
+		}
+
+		output->creatureProfiles.push_back(profile);
 	}
 
-	gLog->Log("Monster Loader", "Creature Lookup Populated");
+	RCK_LOG_INFO("Monster Loader", "Creature Lookup Populated");
 	
 	return output;
 }
@@ -36,33 +88,266 @@ MobManager* MobManager::LoadMobData()
 
 void MobManager::SetMobX(int entityID, int x)
 {
-	mobXPos[entityID] = x;
+	monsters.Get<MOB_X>(entityID) = x;
 }
 
 void MobManager::SetMobY(int entityID, int y)
 {
-	mobYPos[entityID] = y;
+	monsters.Get<MOB_Y>(entityID) = y;
 }
 
 int MobManager::GetMobX(int entityID)
 {
-	return mobXPos[entityID];
+	return monsters.Get<MOB_X>(entityID);
 }
 
 int MobManager::GetMobY(int entityID)
 {
-	return mobYPos[entityID];
+	return monsters.Get<MOB_Y>(entityID);
 }
 
 bool MobManager::TurnHandler(int entityID, double time)
+{
+	std::vector<int> entities(1, entityID);
+	int handled = 0;
+	return TurnHandler(entities, time, handled);
+}
+
+bool MobManager::TurnHandler(std::vector<int>& entities, double time, int& handled)
+{
+	// a batch of monsters that can all move or act again at the same moment.
+	// Anything that only needs looking at (who's in sight, which way is downhill on the distance fields) is worked out for all of
+	// them up front, on the job system. Then they act one at a time, which is where anything random or anything that moves happens.
+	std::sort(entities.begin(), entities.end());
+
+	PrepareDecisions(entities);
+	DecideAll(entities, gGame->mJobs);
+
+	TimeManager* tm = gGame->mTimeManager;
+	handled = 0;
+	bool interrupted = false;
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		handled++;
+
+		// an earlier turn in the batch might have killed it off
+		if (!MonsterExists(entities[i]))
+			continue;
+
+		tm->TraceTurn(TRACE_FIRE, MANAGER_MOB, entities[i], time);
+		interrupted = CommitTurn(entities[i], time, decisions[i]);
+		tm->TraceTurn(TRACE_FIRE_END, MANAGER_MOB, entities[i], time);
+		if (interrupted)
+			break;
+	}
+
+	// anything that fell during the batch is gone by the end of it
+	ClearFallen();
+
+	return interrupted;
+}
+
+void MobManager::MarkFallen(int monsterID)
+{
+	fallen.push_back(GetMonsterHandle(monsterID));
+}
+
+void MobManager::ClearFallen()
+{
+	// by handle, as an earlier removal can hand the ID straight back out
+	for (const EntityHandle& h : fallen)
+	{
+		if (IsValid(h))
+			RemoveMonster(h.id);
+	}
+	fallen.clear();
+}
+
+bool MobManager::LocateTarget(int entityID, int& x, int& y)
+{
+	int mapID = monsters.Get<MOB_MAP>(entityID);
+	int targetID = monsters.Get<MOB_TARGET_ID>(entityID);
+	int targetManager = monsters.Get<MOB_TARGET_MANAGER>(entityID);
+	CharacterManager* cm = gGame->mCharacterManager;
+
+	if (targetManager == MANAGER_CHARACTER && targetID >= 0 && cm->GetPlayerMap(targetID) == mapID)
+	{
+		x = cm->GetPlayerX(targetID);
+		y = cm->GetPlayerY(targetID);
+		return true;
+	}
+	if (targetManager == MANAGER_MOB && MonsterExists(targetID) && GetMobMap(targetID) == mapID)
+	{
+		x = GetMobX(targetID);
+		y = GetMobY(targetID);
+		return true;
+	}
+
+	// a path to somewhere on another map is no use to us
+	monsters.Get<MOB_TARGET_ID>(entityID) = -1;
+	monsters.Get<MOB_TARGET_MANAGER>(entityID) = -1;
+	gGame->mMapManager->getPathPlanner()->Forget(MANAGER_MOB, entityID);
+	return false;
+}
+
+void MobManager::PrepareDecisions(const std::vector<int>& entities)
+{
+	// every map with someone in the batch on it, not just the one on screen - each mob decides against its own map
+	std::vector<int> mapIDs;
+	for (int id : entities)
+	{
+		if (MonsterExists(id) && GetMobMap(id) >= 0)
+			mapIDs.push_back(GetMobMap(id));
+	}
+	std::sort(mapIDs.begin(), mapIDs.end());
+	mapIDs.erase(std::unique(mapIDs.begin(), mapIDs.end()), mapIDs.end());
+
+	// bring the shared fields up to date now, before anyone reads them - Decide can only read them. Each map's are rebuilt side by side.
+	PathPlanner* planner = gGame->mMapManager->getPathPlanner();
+	planner->UpdateFields(mapIDs, { FIELD_PARTY, FIELD_PLAYER });
+
+	decideMaps.resize(mapIDs.size());
+	std::fill(decideMapSlot.begin(), decideMapSlot.end(), -1);
+	for (size_t i = 0; i < mapIDs.size(); i++)
+	{
+		int mapID = mapIDs[i];
+		if (mapID >= (int)decideMapSlot.size())
+			decideMapSlot.resize(mapID + 1, -1);
+		decideMapSlot[mapID] = (int)i;
+
+		DecideMap& dm = decideMaps[i];
+		dm.mapID = mapID;
+		dm.fields.assign(FIELD_MAX, NULL);
+		dm.fieldRebuilds.assign(FIELD_MAX, 0);
+		for (int f : { FIELD_PARTY, FIELD_PLAYER })
+		{
+			dm.fields[f] = planner->GetField(mapID, f);
+			dm.fieldRebuilds[f] = dm.fields[f]->GetRebuildCount();
+		}
+		dm.candidates = gGame->mCharacterManager->GetConditionCharactersOnMap(mapID, gGame->mConditionManager->UnconsciousIndex, false);
+	}
+}
+
+void MobManager::DecideAll(const std::vector<int>& entities, JobSystem* jobs)
+{
+	decisions.assign(entities.size(), MobDecision());
+
+	auto decideRange = [this, &entities](int begin, int end, JobContext&)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			if (MonsterExists(entities[i]))
+				Decide(entities[i], decisions[i]);
+		}
+	};
+
+	if (jobs == nullptr)
+	{
+		ScratchArena scratch;
+		JobContext context{ 0, scratch };
+		decideRange(0, (int)entities.size(), context);
+	}
+	else
+	{
+		jobs->ParallelFor((int)entities.size(), 32, decideRange);
+	}
+}
+
+void MobManager::Decide(int entityID, MobDecision& d)
+{
+	// Runs on the worker threads: only reads, and only writes to d. In particular no FOV (the observer cache isn't safe to share),
+	// no path planner (same) and no random numbers (the order they're drawn in has to stay fixed).
+	int behaviour = monsters.Get<MOB_BEHAVIOUR>(entityID);
+	if (behaviour != MOB_BEHAVIOUR_SEEK_ENEMY && behaviour != MOB_BEHAVIOUR_SEEK_PLAYER)
+		return;
+
+	int mapID = GetMobMap(entityID);
+	if (mapID < 0 || mapID >= (int)decideMapSlot.size() || decideMapSlot[mapID] == -1)
+		return;
+	const DecideMap& dm = decideMaps[decideMapSlot[mapID]];
+	Map* m = gGame->mMapManager->getMap(mapID);
+	d.mapID = mapID;
+	int ox = GetMobX(entityID);
+	int oy = GetMobY(entityID);
+	int targetID = monsters.Get<MOB_TARGET_ID>(entityID);
+	int targetManager = monsters.Get<MOB_TARGET_MANAGER>(entityID);
+
+	int fieldType = -1;
+	if (behaviour == MOB_BEHAVIOUR_SEEK_ENEMY)
+	{
+		if (targetID == -1 && targetManager == -1)
+		{
+			// the nearest conscious character we've got a clear line to
+			CharacterManager* cm = gGame->mCharacterManager;
+			VisibilityService* visibility = gGame->mMapManager->getVisibility();
+			double closest_sqr_dist = 10e10;
+			for (int j : dm.candidates)
+			{
+				int playerX = cm->GetPlayerX(j);
+				int playerY = cm->GetPlayerY(j);
+				double dist = ((playerX - ox) * (playerX - ox)) + ((playerY - oy) * (playerY - oy));
+				if (dist < closest_sqr_dist && visibility->HasLineOfSight(mapID, ox, oy, playerX, playerY))
+				{
+					d.targetID = j;
+					d.targetManager = MANAGER_CHARACTER;
+					closest_sqr_dist = dist;
+				}
+			}
+			targetID = d.targetID;
+			targetManager = d.targetManager;
+		}
+
+		if (targetManager == MANAGER_CHARACTER && targetID != -1
+			&& !gGame->mCharacterManager->getCharacterHasCondition(targetID, gGame->mConditionManager->UnconsciousIndex))
+		{
+			fieldType = FIELD_PARTY;
+		}
+	}
+	else if ((targetID == -1 && targetManager == -1) || targetManager == MANAGER_CHARACTER)
+	{
+		fieldType = FIELD_PLAYER;
+	}
+
+	if (fieldType == -1)
+		return;
+
+	d.fieldType = fieldType;
+	d.fieldRebuilds = dm.fieldRebuilds[fieldType];
+	d.fieldResult = dm.fields[fieldType]->NextStep(m, ox, oy, d.stepX, d.stepY);
+}
+
+int MobManager::StepOnField(const MobDecision& d, int fieldType, int mapID, int ox, int oy, int& nx, int& ny)
+{
+	// use the step from the decide phase if nothing it depended on has changed since. The field can have been rebuilt by an earlier
+	// turn in the batch (someone went down), and another mob can have stepped into the cell we were heading for.
+	DistanceField* field = gGame->mMapManager->getPathPlanner()->GetField(mapID, fieldType);
+	Map* m = gGame->mMapManager->getMap(mapID);
+	if (d.fieldType == fieldType && mapID == d.mapID && field->GetRebuildCount() == d.fieldRebuilds)
+	{
+		if (d.fieldResult == PATH_ARRIVED || d.fieldResult == PATH_BLOCKED)
+			return d.fieldResult;
+
+		if (d.fieldResult == PATH_STEP && !m->getMobAt(d.stepX, d.stepY))
+		{
+			nx = d.stepX;
+			ny = d.stepY;
+			return PATH_STEP;
+		}
+	}
+
+	// waiting on a crowd, or things have moved on - look again
+	return field->NextStep(m, ox, oy, nx, ny);
+}
+
+bool MobManager::CommitTurn(int entityID, double time, const MobDecision& d)
 {
 	// this fires every time one of our monster is able to move or act again
 
 	// If we don't have a current behaviour, pick one.
 	bool pickNew = false;
 	double timeToMove = 0.0;
-	Creature& c = Monsters_[entityID];
-	if(currentBehaviour[entityID] == -1)
+	Creature c = GetMonster(entityID);
+	if(monsters.Get<MOB_BEHAVIOUR>(entityID) == -1)
 	{
 		pickNew = true;
 	}
@@ -74,7 +359,7 @@ bool MobManager::TurnHandler(int entityID, double time)
 		// (Actually that sounds like a bloody amazing idea if there's some way to make them visible in a Roguelike. Maybe a battle sim where every unit is calculated?)
 		// But in all seriousness there's not a lot of call to split the timing table n ways for existence-based processing if we only call this at each timing point, and it's complicated enough
 		
-		switch(currentBehaviour[entityID])
+		switch(monsters.Get<MOB_BEHAVIOUR>(entityID))
 		{
 		case MOB_BEHAVIOUR_IDLE:
 			{
@@ -83,7 +368,7 @@ bool MobManager::TurnHandler(int entityID, double time)
 
 				// randomly determine how long we do this for
 				timeToMove = gGame->randomiser->getDouble(1.0, 17.0);
-				currentBehaviour[entityID] = MOB_BEHAVIOUR_UNSET;
+				monsters.Get<MOB_BEHAVIOUR>(entityID) = MOB_BEHAVIOUR_UNSET;
 			}
 			break;
 
@@ -91,7 +376,7 @@ bool MobManager::TurnHandler(int entityID, double time)
 			{
 				// move in a random direction
 				int moveX, moveY, move_value;
-				int mapID = gGame->GetCurrentMap();
+				int mapID = monsters.Get<MOB_MAP>(entityID);
 				if (gGame->mMapManager->getMap(mapID)->outdoor)
 				{
 					move_value = gGame->randomiser->getInt(0, 5);
@@ -100,7 +385,7 @@ bool MobManager::TurnHandler(int entityID, double time)
 				{
 					move_value = gGame->randomiser->getInt(0, 7);
 				}
-				gGame->mMapManager->shift(gGame->GetCurrentMap(), moveX, moveY, GetMobX(entityID), GetMobY(entityID), move_value);
+				gGame->mMapManager->shift(mapID, moveX, moveY, GetMobX(entityID), GetMobY(entityID), move_value);
 
 				timeToMove = MoveTo(entityID, moveX, moveY, time);
 			}
@@ -115,67 +400,50 @@ bool MobManager::TurnHandler(int entityID, double time)
 			//if (paths[entityID] == NULL)
 			//{
 				// do we have a target already selected? If not, pick the player
-			if (targetID[entityID] == -1 && targetManager[entityID] == -1)
+			if (monsters.Get<MOB_TARGET_ID>(entityID) == -1 && monsters.Get<MOB_TARGET_MANAGER>(entityID) == -1)
 			{
-				targetManager[entityID] = MANAGER_CHARACTER;
-				targetID[entityID] == gGame->GetSelectedCharacterID();
+				monsters.Get<MOB_TARGET_MANAGER>(entityID) = MANAGER_CHARACTER;
+				monsters.Get<MOB_TARGET_ID>(entityID) = gGame->GetSelectedCharacterID();
 			}
 
 			int ox = GetMobX(entityID);
 			int oy = GetMobY(entityID);
 
 			int dx, dy;
-			if (targetManager[entityID] == MANAGER_CHARACTER)
+			if (!LocateTarget(entityID, dx, dy))
 			{
-				dx = gGame->mCharacterManager->GetPlayerX(gGame->GetSelectedCharacterID());
-				dy = gGame->mCharacterManager->GetPlayerY(gGame->GetSelectedCharacterID());
-			}
-			else if (targetManager[entityID] == MANAGER_MOB)
-			{
-				Creature t = Monsters_[targetID[entityID]];
-				dx = GetMobX(targetID[entityID]);
-				dy = GetMobY(targetID[entityID]);
-			}
-			else
-			{
-				// do nothing. We should normally have a different element for seeking an item?
+				// the target's on another map now, or gone altogether, so there's nobody here to go after
+				timeToMove = 3.0;
+				pickNew = true;
+				break;
 			}
 
 			int dist = sqrt(pow(abs(dx - ox), 2) + pow(abs(dy - oy), 2));
 			if (dist > 2)
 			{
-				int* mapID_ptr = &(gGame->GetCurrentMap());
-				int mapID = gGame->GetCurrentMap();
-				Map* map = gGame->mMapManager->getMap(mapID);
-				paths[entityID] = new TCODPath(map->width, map->height, gGame->mMapManager, (void*)mapID_ptr, 1.0f);
-				paths[entityID]->compute(ox, oy, dx, dy);
-				//}
-
-				if (paths[entityID]->isEmpty())
+				int mapID = monsters.Get<MOB_MAP>(entityID);
+				PathPlanner* planner = gGame->mMapManager->getPathPlanner();
+				int tx, ty;
+				PathResult result = planner->NextStep(MANAGER_MOB, entityID, mapID, ox, oy, dx, dy, tx, ty);
+
+				if (result == PATH_ARRIVED)
 				{
 					// we've reached our destination, so now we need a different behaviour
-					delete paths[entityID];
-					paths[entityID] = NULL;
+					planner->Forget(MANAGER_MOB, entityID);
 					timeToMove = 1.0;
 					pickNew = true;
 				}
+				else if (result == PATH_STEP)
+				{
+					// go there!
+					timeToMove = MoveTo(entityID, tx, ty, time);
+				}
 				else
 				{
-					int tx, ty;
-					bool canWalk = paths[entityID]->walk(&tx, &ty, true);
-					if (canWalk)
-					{
-						// go there!
-						timeToMove = MoveTo(entityID, tx, ty, time);
-					}
-					else
-					{
-						// we can't find a route, so pick another behaviour
-						delete paths[entityID];
-						paths[entityID] = NULL;
-						timeToMove = 3.0;
-						pickNew = true;
-					}
+					// we can't find a route, so pick another behaviour
+					planner->Forget(MANAGER_MOB, entityID);
+					timeToMove = 3.0;
+					pickNew = true;
 				}
 			}
 		}
@@ -190,64 +458,55 @@ bool MobManager::TurnHandler(int entityID, double time)
 			//if (paths[entityID] == NULL)
 			//{
 				// do we have a target already selected? If not, pick the current character
-			if (targetID[entityID] == -1 && targetManager[entityID] == -1)
+			if (monsters.Get<MOB_TARGET_ID>(entityID) == -1 && monsters.Get<MOB_TARGET_MANAGER>(entityID) == -1)
 			{
-				targetManager[entityID] = MANAGER_CHARACTER;
-				targetID[entityID] == gGame->GetSelectedCharacterID();
+				monsters.Get<MOB_TARGET_MANAGER>(entityID) = MANAGER_CHARACTER;
+				monsters.Get<MOB_TARGET_ID>(entityID) = gGame->GetSelectedCharacterID();
 			}
 
 			int ox = GetMobX(entityID);
 			int oy = GetMobY(entityID);
 
 			int dx, dy;
-			if (targetManager[entityID] == MANAGER_CHARACTER)
-			{
-				dx = gGame->mCharacterManager->GetPlayerX(gGame->GetSelectedCharacterID());
-				dy = gGame->mCharacterManager->GetPlayerY(gGame->GetSelectedCharacterID());
-			}
-			else if (targetManager[entityID] == MANAGER_MOB)
-			{
-				Creature t = Monsters_[targetID[entityID]];
-				dx = GetMobX(targetID[entityID]);
-				dy = GetMobY(targetID[entityID]);
-			}
-			else
+			if (!LocateTarget(entityID, dx, dy))
 			{
-				// do nothing. We should normally have a different element for seeking an item?
+				// the target's on another map now, or gone altogether, so there's nobody here to go after
+				timeToMove = 3.0;
+				pickNew = true;
+				break;
 			}
 
-			int* mapID_ptr = &(gGame->GetCurrentMap());
-			int mapID = gGame->GetCurrentMap();
-			Map* map = gGame->mMapManager->getMap(mapID);
-			paths[entityID] = new TCODPath(map->width, map->height, gGame->mMapManager, (void*)mapID_ptr, 1.0f);
-			paths[entityID]->compute(ox, oy, dx, dy);
-			//}
+			int mapID = monsters.Get<MOB_MAP>(entityID);
+			PathPlanner* planner = gGame->mMapManager->getPathPlanner();
+			int tx, ty;
+
+			// everyone chasing the player shares one distance field, so we just walk downhill on it
+			PathResult result = (monsters.Get<MOB_TARGET_MANAGER>(entityID) == MANAGER_CHARACTER)
+				? (PathResult)StepOnField(d, FIELD_PLAYER, mapID, ox, oy, tx, ty)
+				: planner->NextStep(MANAGER_MOB, entityID, mapID, ox, oy, dx, dy, tx, ty);
 
-			if (paths[entityID]->isEmpty())
+			if (result == PATH_ARRIVED)
 			{
 				// we've reached our destination, so now we need a different behaviour
-				delete paths[entityID];
-				paths[entityID] = NULL;
+				planner->Forget(MANAGER_MOB, entityID);
 				timeToMove = 1.0;
 				pickNew = true;
 			}
+			else if (result == PATH_STEP)
+			{
+				// go there!
+				timeToMove = MoveTo(entityID, tx, ty, time);
+			}
+			else if (result == PATH_WAITING)
+			{
+				// the way is crowded, hang about until it clears
+			}
 			else
 			{
-				int tx, ty;
-				bool canWalk = paths[entityID]->walk(&tx, &ty, true);
-				if (canWalk)
-				{
-					// go there!
-					timeToMove = MoveTo(entityID, tx, ty, time);
-				}
-				else
-				{
-					// we can't find a route, so pick another behaviour
-					delete paths[entityID];
-					paths[entityID] = NULL;
-					timeToMove = 3.0;
-					pickNew = true;
-				}
+				// we can't find a route, so pick another behaviour
+				planner->Forget(MANAGER_MOB, entityID);
+				timeToMove = 3.0;
+				pickNew = true;
 			}
 		}
 		break;
@@ -256,48 +515,20 @@ bool MobManager::TurnHandler(int entityID, double time)
 			{
 				// try to move towards the nearest enemy and attack them
 
-				int mapID = gGame->GetCurrentMap();
-				Map* map = gGame->mMapManager->getMap(mapID);
+				int mapID = monsters.Get<MOB_MAP>(entityID);
 
 				int ox = GetMobX(entityID);
 				int oy = GetMobY(entityID);
 				
-				// do we have a target already selected? If not, pick the nearest enemy
-				if (targetID[entityID] == -1 && targetManager[entityID] == -1)
+				// do we have a target already selected? If not, take the nearest enemy in sight - the decide phase has already looked
+				if (monsters.Get<MOB_TARGET_ID>(entityID) == -1 && monsters.Get<MOB_TARGET_MANAGER>(entityID) == -1 && d.targetID != -1)
 				{
-					// take the total set of conscious PCs and Henchmen, then filter them by POV
-					std::vector<int> characters = gGame->mCharacterManager->GetConditionCharactersOnMap(mapID, "Unconscious", false);
-					std::vector<int> targets = gGame->mMapManager->filterByFOV(MANAGER_MOB, entityID, MANAGER_CHARACTER, characters);
-					
-					int selected = -1;
-
-					// if we have no target options, set off another action select
-					if (targets.size() > 0)
-					{
-						// get the closest
-						double closest_sqr_dist = 10e10;
-						for (int j : targets)
-						{
-							int playerX = gGame->mCharacterManager->GetPlayerX(j);
-							int playerY = gGame->mCharacterManager->GetPlayerY(j);
-
-							double dist = ((playerX - ox) * (playerX - ox)) + ((playerY - oy) * (playerY - oy));
-							if (dist < closest_sqr_dist)
-							{
-								selected = j;
-								closest_sqr_dist = dist;
-							}
-						}
-						// if no closest found somehow, pick the first
-						if (selected == -1) selected = targets[0];
-
-						targetManager[entityID] = MANAGER_CHARACTER;
-						targetID[entityID] = selected;
-					}
+					monsters.Get<MOB_TARGET_MANAGER>(entityID) = d.targetManager;
+					monsters.Get<MOB_TARGET_ID>(entityID) = d.targetID;
 				}
 
 				// if we still don't have a target selected, pick a new behaviour.
-				if (targetID[entityID] == -1 && targetManager[entityID] == -1)
+				if (monsters.Get<MOB_TARGET_ID>(entityID) == -1 && monsters.Get<MOB_TARGET_MANAGER>(entityID) == -1)
 				{
 					pickNew = true;
 					timeToMove = 3.0;
@@ -307,57 +538,57 @@ bool MobManager::TurnHandler(int entityID, double time)
 					// otherwise, continue tracking our target.
 					
 					int dx, dy;
-					bool unconscious = false;
-					if (targetManager[entityID] == MANAGER_CHARACTER)
-					{
-						dx = gGame->mCharacterManager->GetPlayerX(targetID[entityID]);
-						dy = gGame->mCharacterManager->GetPlayerY(targetID[entityID]);
-						unconscious = gGame->mCharacterManager->getCharacterHasCondition(targetID[entityID], "Unconscious");
-					}
-					else if (targetManager[entityID] == MANAGER_MOB)
+					if (!LocateTarget(entityID, dx, dy))
 					{
-						Creature t = Monsters_[targetID[entityID]];
-						dx = GetMobX(targetID[entityID]);
-						dy = GetMobY(targetID[entityID]);
-						unconscious = t.GetHitPoints() <= 0;
+						// the target's on another map now, or gone altogether, so there's nobody here to go after
+						timeToMove = 3.0;
+						pickNew = true;
+						break;
 					}
-					else
+
+					// only looked at once we know the target's still there
+					int targetID = monsters.Get<MOB_TARGET_ID>(entityID);
+					bool unconscious = (monsters.Get<MOB_TARGET_MANAGER>(entityID) == MANAGER_CHARACTER)
+						? gGame->mCharacterManager->getCharacterHasCondition(targetID, gGame->mConditionManager->UnconsciousIndex)
+						: GetMonster(targetID).GetHitPoints() <= 0;
+
+					PathPlanner* planner = gGame->mMapManager->getPathPlanner();
+					int tx, ty;
+					PathResult result = PATH_ARRIVED;
+					if (!unconscious)
 					{
-						// do nothing. We should normally have a different element for seeking an item?
+						// characters are chased down the shared party field (which leads to the nearest of them), anything else gets its own path
+						result = (monsters.Get<MOB_TARGET_MANAGER>(entityID) == MANAGER_CHARACTER)
+							? (PathResult)StepOnField(d, FIELD_PARTY, mapID, ox, oy, tx, ty)
+							: planner->NextStep(MANAGER_MOB, entityID, mapID, ox, oy, dx, dy, tx, ty);
 					}
 
-					paths[entityID] = new TCODPath(map->width, map->height, gGame->mMapManager, (void*)&mapID, 1.0f);
-					paths[entityID]->compute(ox, oy, dx, dy);
-
-					if (paths[entityID]->isEmpty() || unconscious)
+					if (result == PATH_ARRIVED)
 					{
 						// we've reached our destination, so now we need a different behaviour
-						delete paths[entityID];
-						paths[entityID] = NULL;
+						planner->Forget(MANAGER_MOB, entityID);
 						timeToMove = 1.0;
 						pickNew = true;
-						targetID[entityID] = -1;
-						targetManager[entityID] = -1;
+						monsters.Get<MOB_TARGET_ID>(entityID) = -1;
+						monsters.Get<MOB_TARGET_MANAGER>(entityID) = -1;
+					}
+					else if (result == PATH_STEP)
+					{
+						// go there!
+						timeToMove = MoveTo(entityID, tx, ty, time);
+					}
+					else if (result == PATH_WAITING)
+					{
+						// the way is crowded, hang about until it clears
 					}
 					else
 					{
-						int tx, ty;
-						bool canWalk = paths[entityID]->walk(&tx, &ty, true);
-						if (canWalk)
-						{
-							// go there!
-							timeToMove = MoveTo(entityID, tx, ty, time);
-						}
-						else
-						{
-							// we can't find a route, so pick another behaviour
-							delete paths[entityID];
-							paths[entityID] = NULL;
-							targetID[entityID] = -1;
-							targetManager[entityID] = -1;
-							timeToMove = 3.0;
-							pickNew = true;
-						}
+						// we can't find a route, so pick another behaviour
+						planner->Forget(MANAGER_MOB, entityID);
+						monsters.Get<MOB_TARGET_ID>(entityID) = -1;
+						monsters.Get<MOB_TARGET_MANAGER>(entityID) = -1;
+						timeToMove = 3.0;
+						pickNew = true;
 					}
 				}
 			}
@@ -375,7 +606,7 @@ bool MobManager::TurnHandler(int entityID, double time)
 	{
 		// we didn't move. Wait a while, then do it again
 		// how long? Depends on the map. Wait about 150 units of movement
-		timeToMove = gGame->mMapManager->getMovementTime(mapIDs[entityID], c.GetMovement());
+		timeToMove = gGame->mMapManager->getMovementTime(monsters.Get<MOB_MAP>(entityID), c.GetMovement());
 	}
 	gGame->mTimeManager->SetEntityTime(entityID, MANAGER_MOB, time + timeToMove);
 
@@ -385,8 +616,8 @@ bool MobManager::TurnHandler(int entityID, double time)
 	// pick a new behaviour
 	if(pickNew)
 	{
-		currentBehaviour[entityID] = SelectBehaviour(entityID);
-		std::string bhname = Monsters_[entityID].GetName() + " sets behaviour:" + MobBehaviourNames[currentBehaviour[entityID]] + ".";
+		monsters.Get<MOB_BEHAVIOUR>(entityID) = SelectBehaviour(entityID);
+		std::string bhname = c.GetName() + " sets behaviour:" + MobBehaviourNames[monsters.Get<MOB_BEHAVIOUR>(entityID)] + ".";
 		gGame->AddActionLogText(bhname);
 	}
 
@@ -402,9 +633,9 @@ int MobManager::SelectBehaviour(int entityID)
 	// temporary version - pick randomly from available set
 	// unless we're unconscious, in which case just fucking lie there biznitch
 
-	Creature& c = Monsters_[entityID];
-	if (c.HasCondition("Unconscious")) return MOB_BEHAVIOUR_UNCONSCIOUS;
-	std::vector<int> behaviours = c.GetBehaviours();
+	Creature c = GetMonster(entityID);
+	if (c.HasCondition(gGame->mConditionManager->UnconsciousIndex)) return MOB_BEHAVIOUR_UNCONSCIOUS;
+	const std::vector<int>& behaviours = c.GetBehaviours();
 	if (behaviours.size() > 0)
 	{
 		int select = gGame->randomiser->get(0, behaviours.size() - 1);
@@ -415,13 +646,13 @@ int MobManager::SelectBehaviour(int entityID)
 
 void MobManager::SetBehaviour(int entityID, int behaviourType)
 {
-	currentBehaviour[entityID] = behaviourType;
+	monsters.Get<MOB_BEHAVIOUR>(entityID) = behaviourType;
 }
 
 double MobManager::MoveTo(int entityID, int new_x, int new_y, int currentTime)
 {
-	Creature& c = Monsters_[entityID];
-	int mapID = mapIDs[entityID];
+	Creature c = GetMonster(entityID);
+	int mapID = monsters.Get<MOB_MAP>(entityID);
 	Map* m = gGame->mMapManager->getMap(mapID);
 	double timeExpended = 0.0;
 	if (!gGame->mMapManager->isOutOfBounds(mapID, new_x, new_y))
@@ -431,9 +662,10 @@ double MobManager::MoveTo(int entityID, int new_x, int new_y, int currentTime)
 			if (new_x >= 0 && new_y >= 0)
 			{
 				int baseCharacter = 0;
-				if ((gGame->mCharacterManager->GetPlayerX(gGame->GetSelectedCharacterID()) == new_x) && (gGame->mCharacterManager->GetPlayerY(gGame->GetSelectedCharacterID()) == new_y))
+				int selected = gGame->GetSelectedCharacterID();
+				if (gGame->mCharacterManager->GetPlayerMap(selected) == mapID && gGame->mCharacterManager->GetPlayerX(selected) == new_x && gGame->mCharacterManager->GetPlayerY(selected) == new_y)
 				{
-					baseCharacter = gGame->GetSelectedCharacterID();
+					baseCharacter = selected;
 				}
 				else
 				{
@@ -477,26 +709,105 @@ int MobManager::GetTemplateIndex(const std::string creatureName)
 	return creatureNameLookup[creatureName];
 }
 
-void MobManager::EmptyCreature(Creature c)
+int MobManager::AddRow(int templateIndex, int hitPoints, int flags)
 {
-	Monsters_.push_back(c);
-	mapIDs.push_back(-1);
-	// behaviour data
-	targetID.push_back(-1);
-	targetManager.push_back(-1);
-	currentBehaviour.push_back(-1);
+	const CreatureProfile* profile = templateIndex < creatureProfiles.size() ? &creatureProfiles[templateIndex] : NULL;
+	int armourClass = profile ? profile->ArmourClass : 0;
+	int movement = profile ? profile->Movement : 0;
 
-	mobXPos.push_back(-1);
-	mobYPos.push_back(-1);
+	return monsters.Add(templateIndex, hitPoints, hitPoints, armourClass, movement, flags, 0, MOB_BEHAVIOUR_UNSET, -1, -1, -1, -1, -1,
+		std::vector<int>(), std::vector<int>(), std::vector<int>());
+}
+
+void MobManager::RemoveMonster(int monsterID)
+{
+	if (!MonsterExists(monsterID))
+		return;
 
-	paths.push_back(NULL);
+	int mapID = monsters.Get<MOB_MAP>(monsterID);
+	if (mapID != -1)
+	{
+		// whatever it was carrying stays behind
+		Map* m = gGame->mMapManager->getMap(mapID);
+		int x = monsters.Get<MOB_X>(monsterID);
+		int y = monsters.Get<MOB_Y>(monsterID);
+		for (int item : monsters.Get<MOB_EQUIPPED>(monsterID))
+		{
+			if (item > 0)
+				m->addItem(x, y, item);
+		}
+		for (int item : monsters.Get<MOB_HELD>(monsterID))
+		{
+			m->addItem(x, y, item);
+		}
+		m->removeMob(monsterID);
+	}
+	gGame->mTimeManager->DeregisterEntity(monsterID, MANAGER_MOB);
+	gGame->mMapManager->getPathPlanner()->Forget(MANAGER_MOB, monsterID);
+	gGame->mMapManager->getVisibility()->Forget(MANAGER_MOB, monsterID);
+	gGame->mPartyManager->RemoveAnimalFromAll(monsterID);
+
+	// the ID is about to go back on the free list, so nobody can carry on chasing it
+	std::vector<int>& targets = monsters.Column<MOB_TARGET_ID>();
+	std::vector<int>& targetManagers = monsters.Column<MOB_TARGET_MANAGER>();
+	for (int row = 0; row < targets.size(); row++)
+	{
+		if (targetManagers[row] == MANAGER_MOB && targets[row] == monsterID)
+		{
+			targets[row] = -1;
+			targetManagers[row] = -1;
+		}
+	}
+
+	monsters.Remove(monsterID);
+}
+
+void MobManager::SaveSnapshot(SnapshotWriter& w)
+{
+	w.Section("MOBS");
+	monsters.Save(w);
+	w.Write(mapDetail);
+	w.Write(mapDemotedAt);
+	w.Write((int64_t)abstractTurn);
+}
+
+bool MobManager::LoadSnapshot(SnapshotReader& r)
+{
+	if (!r.Section("MOBS"))
+		return false;
+	monsters.Load(r);
+	r.Read(mapDetail);
+	r.Read(mapDemotedAt);
+	int64_t turn = 0;
+	r.Read(turn);
+	abstractTurn = turn;
+
+	// the condition data may have changed since the save, so work the masks out again
+	std::vector<unsigned long long>& masks = monsters.Column<MOB_CONDITION_MASK>();
+	const std::vector<std::vector<int>>& conditions = monsters.Column<MOB_CONDITIONS>();
+	for (int row = 0; row < masks.size() && row < conditions.size(); row++)
+	{
+		masks[row] = gGame->mConditionManager->ExpandConditions(conditions[row]);
+	}
+
+	// saved between a kill and the end of that batch, so the fallen still need clearing away
+	fallen.clear();
+	int unconscious = gGame->mConditionManager->UnconsciousIndex;
+	for (int row = 0; row < masks.size(); row++)
+	{
+		int id = monsters.IdOf(row);
+		if (id > 0 && ConditionManager::MaskHasCondition(masks[row], unconscious))
+			fallen.push_back(GetMonsterHandle(id));
+	}
+
+	return r.Ok();
 }
 
 void MobManager::SpawnOnMap(int entityID, int mapID, int spawn_x, int spawn_y)
 {
-	DebugLog("Spawning " + GetMonster(entityID).GetName() + " onto map #" + std::to_string(mapID));
+	DEBUG_LOG("Spawning " + GetMonster(entityID).GetName() + " onto map #" + std::to_string(mapID));
 	
-	mapIDs[entityID] = mapID;
+	monsters.Get<MOB_MAP>(entityID) = mapID;
 
 	const int MAX_SPAWN_DIST = 255;
 
@@ -525,10 +836,12 @@ void MobManager::SpawnOnMap(int entityID, int mapID, int spawn_x, int spawn_y)
 						{
 							// square is clear, put it there
 							double moveTime = MoveTo(entityID, new_x, new_y, 0);
-							gGame->mTimeManager->SetEntityTime(entityID, MANAGER_MOB, moveTime);
+							// nobody's watching an abstract map, so there are no turns to take there
+							if (GetMapDetail(mapID) == DETAIL_FULL)
+								gGame->mTimeManager->SetEntityTime(entityID, MANAGER_MOB, moveTime);
 							found = true;
 
-							DebugLog("Spawned " + GetMonster(entityID).GetName() + " onto map #" + std::to_string(mapID) + " at position (" + std::to_string(new_x) + "," + std::to_string(new_y) + ")");
+							DEBUG_LOG("Spawned " + GetMonster(entityID).GetName() + " onto map #" + std::to_string(mapID) + " at position (" + std::to_string(new_x) + "," + std::to_string(new_y) + ")");
 						}
 					}
 				}
@@ -541,78 +854,50 @@ void MobManager::SpawnOnMap(int entityID, int mapID, int spawn_x, int spawn_y)
 
 int MobManager::GenerateMonster(int templateIndex, int mapID, int x, int y, bool hostile)
 {
-	Creature c = Creature::GenerateCreature(templateIndex);
-	c.SetHostile(hostile);
-	EmptyCreature(c);
-	
-	if(mapID != -1)
-		SpawnOnMap(nextMonsterIndex, mapID, x, y);
-
-	return nextMonsterIndex++;
-}
-
-void Creature::AddAttack(std::string name, int damageDie, int damageBonus)
-{
-	
-}
-
-//Creature Creature::GenerateCreature(const CreatureTemplate& ct)
-Creature Creature::GenerateCreature(int templateIndex)
-{
-	Creature output;
-	CreatureTemplate ct = gGame->mMobManager->CreatureTemplates().CreatureTemplates()[templateIndex];
-	output.SetName(ct.Name());			// potentially allow for monster name generation?
-	output.SetVisual(ct.Visual());
-	output.SetSaveAs(ct.SaveAs());
-	output.SetAlignment(ct.Alignment()); // replace with actual saves?
-
-	output.SetHitDie(ct.HitDie());
+	const CreatureProfile& profile = GetProfile(templateIndex);
 
 	// Generate HitPoints
 	TCOD_dice_t hitDice;
 	hitDice.nb_faces = 8;
-	hitDice.nb_rolls = ct.HitDie();
-	hitDice.addsub = ct.HitDieModifier();
+	hitDice.nb_rolls = profile.HitDie;
+	hitDice.addsub = profile.HitDieModifier;
 	hitDice.multiplier = 1;
 	int hitPoints = gGame->randomiser->diceRoll(hitDice);
 	if (hitPoints < 1) hitPoints = 1; // can't have less than 1 HP at character gen!
-	output.SetHitPoints(hitPoints);
 
+	int monsterID = AddRow(templateIndex, hitPoints, hostile ? MOB_FLAG_HOSTILE : 0);
 	
-	output.SetArmourClass(ct.ArmourClass());
-	output.SetMorale(ct.Morale());
-	output.SetMovement(ct.Movement());
-	output.SetXP(ct.XP());					// generate from HD and abilities?
-
-	// break out attacks into a map for lookups
-	for(AttackType at : ct.Attacks())
-	{
-		output.Attacks_[at.Name()] = at;
-	}
-	
-	output.Abilities_ = ct.Abilities();
-	output.AttackSequences_ = ct.AttackSequences();
+	if(mapID != -1)
+		SpawnOnMap(monsterID, mapID, x, y);
 
-	output.CreatureType_ = templateIndex;
-	
-	std::vector<std::string> behaviourStrings = ct.Behaviours();
-	for(std::string bs : ct.Behaviours())
-	{
-		output.Behaviours_.push_back(gGame->mMobManager->behaviourLookup[bs]);
-	}
+	return monsterID;
+}
 
-	output.SetHostile(true);
+AttackType Creature::GetAttack(std::string in) const
+{
+	const CreatureProfile& profile = Profile();
+	auto it = profile.AttackLookup.find(in);
+	return it == profile.AttackLookup.end() ? AttackType() : profile.Attacks[it->second];
+}
 
-	return output;
+void Creature::SetHostile(bool isHostile)
+{
+	int& flags = manager->monsters.Get<MOB_FLAGS>(id);
+	flags = isHostile ? (flags | MOB_FLAG_HOSTILE) : (flags & ~MOB_FLAG_HOSTILE);
 }
 
-bool Creature::IsBlocking()
+bool Creature::IsBlocking() const
 {
 	// currently this is just "are we unconscious"
-	return !HasCondition("Unconscious");
+	return !HasCondition(gGame->mConditionManager->UnconsciousIndex);
 }
 
-bool Creature::HasCondition(std::string condition)
+bool Creature::HasCondition(int condition) const
+{
+	return ConditionManager::MaskHasCondition(GetConditionMask(), condition);
+}
+
+bool Creature::HasCondition(std::string condition) const
 {
 	int index = gGame->mConditionManager->GetConditionIndex(condition);
 	return HasCondition(index);
@@ -628,10 +913,15 @@ int Creature::SetCondition(std::string condition)
 // Set a condition. Usually inflicted on us by others.
 int Creature::SetCondition(int condition)
 {
-	// don't duplicate
-	if (!HasCondition(condition))
+	if (condition < 0)
+		return -1;
+
+	// don't duplicate (what's held, not what's included)
+	std::vector<int>& Conditions = manager->monsters.Get<MOB_CONDITIONS>(id);
+	if (std::find(Conditions.begin(), Conditions.end(), condition) == Conditions.end())
 	{
 		Conditions.push_back(condition);
+		manager->monsters.Get<MOB_CONDITION_MASK>(id) = gGame->mConditionManager->ExpandConditions(Conditions);
 		return condition;
 	}
 
@@ -650,11 +940,13 @@ int Creature::RemoveCondition(std::string condition)
 
 int Creature::RemoveCondition(int condition)
 {
+	std::vector<int>& Conditions = manager->monsters.Get<MOB_CONDITIONS>(id);
 	std::vector<int>::iterator iter = std::find(Conditions.begin(), Conditions.end(), condition);
 	if (iter != Conditions.end())
 	{
 		int value = *iter;
 		Conditions.erase(iter);
+		manager->monsters.Get<MOB_CONDITION_MASK>(id) = gGame->mConditionManager->ExpandConditions(Conditions);
 		return value;
 	}
 
@@ -669,22 +961,210 @@ bool MobManager::TargetHandler(int entityID, int returnCode)
 
 bool MobManager::TimeHandler(int rounds, int turns, int hours, int days, int weeks, int months)
 {
+	// the counts we're handed lose anything short of a whole period on every call (see AdvanceTimeBy), so the abstract maps keep
+	// their own place on the clock instead
+	const long double turnLength = TimeManager::GetTimePeriodInSeconds(TIME_TURN);
+	const long double dayLength = TimeManager::GetTimePeriodInSeconds(TIME_DAY);
+	const long long turnsPerDay = (long long)(dayLength / turnLength);
+	long double now = gGame->mTimeManager->GetRunningTime();
+	long long turn = (long long)(now / turnLength);
+	if (turn <= abstractTurn)
+		return true;
+
+	long long turnsPassed = turn - abstractTurn;
+	long long daysPassed = turn / turnsPerDay - abstractTurn / turnsPerDay;
+	abstractTurn = turn;
+
+	// somewhere nobody has been for a day settles down to daily updates
+	for (int mapID = 0; mapID < mapDetail.size(); mapID++)
+	{
+		if (mapDetail[mapID] == DETAIL_TURN && now - mapDemotedAt[mapID] >= dayLength)
+		{
+			mapDetail[mapID] = DETAIL_DAY;
+		}
+	}
+
+	// after a day or so of wandering, another day's looks much the same - a long rest doesn't need walking out step by step
+	SimulateAbstract((int)std::min(turnsPassed, turnsPerDay), (int)std::min(daysPassed, (long long)MAX_ABSTRACT_DAYS));
+	return true;
+}
+
+void MobManager::UpdateMapDetail()
+{
+	// the party's changed maps, so don't leave anything that fell lying about on the old one
+	ClearFallen();
+
+	// a map has a party on it if it's the one on screen, or anyone's standing on it - so a split party keeps both halves going
+	std::vector<char> occupied;
+	auto mark = [&occupied](int mapID)
+	{
+		if (mapID < 0)
+			return;
+		if (mapID >= (int)occupied.size())
+			occupied.resize(mapID + 1, 0);
+		occupied[mapID] = 1;
+	};
+	mark(gGame->GetCurrentMap());
+	CharacterManager* cm = gGame->mCharacterManager;
+	for (int c = 1; c < cm->GetCharacterCount(); c++)
+	{
+		mark(cm->GetPlayerMap(c));
+	}
+
+	// only maps with mobs on them have anything to change
+	int highest = -1;
+	for (int mapID : monsters.Column<MOB_MAP>())
+	{
+		highest = std::max(highest, mapID);
+	}
+	if (highest >= (int)mapDetail.size())
+	{
+		mapDetail.resize(highest + 1, DETAIL_FULL);
+		mapDemotedAt.resize(highest + 1, 0.0);
+	}
+
+	for (int mapID = 0; mapID < mapDetail.size(); mapID++)
+	{
+		bool here = mapID < occupied.size() && occupied[mapID];
+		if (here && mapDetail[mapID] != DETAIL_FULL)
+			PromoteMap(mapID);
+		else if (!here && mapDetail[mapID] == DETAIL_FULL)
+			DemoteMap(mapID);
+	}
+}
+
+void MobManager::DemoteMap(int mapID)
+{
+	// out of the time list, and nothing carried over - they'll pick a fresh behaviour when someone turns up again
+	mapDetail[mapID] = DETAIL_TURN;
+	mapDemotedAt[mapID] = (double)gGame->mTimeManager->GetRunningTime();
+
+	PathPlanner* planner = gGame->mMapManager->getPathPlanner();
+	VisibilityService* visibility = gGame->mMapManager->getVisibility();
+	const std::vector<int>& maps = monsters.Column<MOB_MAP>();
+	int count = 0;
+	for (int row = 0; row < maps.size(); row++)
+	{
+		if (maps[row] != mapID)
+			continue;
+
+		int id = monsters.IdOf(row);
+		gGame->mTimeManager->DeregisterEntity(id, MANAGER_MOB);
+		planner->Forget(MANAGER_MOB, id);
+		visibility->Forget(MANAGER_MOB, id);
+		monsters.Column<MOB_BEHAVIOUR>()[row] = MOB_BEHAVIOUR_UNSET;
+		monsters.Column<MOB_TARGET_ID>()[row] = -1;
+		monsters.Column<MOB_TARGET_MANAGER>()[row] = -1;
+		count++;
+	}
+
+	DEBUG_LOG("Map #" + std::to_string(mapID) + " goes abstract with " + std::to_string(count) + " mobs");
+}
+
+void MobManager::PromoteMap(int mapID)
+{
+	// back into the time list, spread over their first move so they don't all go at once
+	mapDetail[mapID] = DETAIL_FULL;
+
+	const std::vector<int>& maps = monsters.Column<MOB_MAP>();
+	const std::vector<int>& movement = monsters.Column<MOB_MOVEMENT>();
+	const std::vector<unsigned long long>& masks = monsters.Column<MOB_CONDITION_MASK>();
+	int unconscious = gGame->mConditionManager->UnconsciousIndex;
+	int count = 0;
+	for (int row = 0; row < maps.size(); row++)
+	{
+		// nobody's going to wake the fallen by walking in, so they don't need a turn (or a roll for one)
+		if (maps[row] != mapID || ConditionManager::MaskHasCondition(masks[row], unconscious))
+			continue;
+
+		double firstMove = gGame->mMapManager->getMovementTime(mapID, movement[row]) * gGame->randomiser->getDouble(0.0, 1.0);
+		gGame->mTimeManager->SetEntityTime(monsters.IdOf(row), MANAGER_MOB, 0.01 + firstMove);
+		count++;
+	}
+
+	DEBUG_LOG("Map #" + std::to_string(mapID) + " back to full detail with " + std::to_string(count) + " mobs");
+}
+
+void MobManager::SimulateAbstract(int turns, int days)
+{
+	if (std::count(mapDetail.begin(), mapDetail.end(), (int)DETAIL_FULL) == (int)mapDetail.size())
+		return;
+
+	// One pass down the table for every abstract map at once. Nothing is added or removed on the way, so the rows stay put and
+	// only positions and hit points change.
+	const std::vector<int>& maps = monsters.Column<MOB_MAP>();
+	const std::vector<int>& types = monsters.Column<MOB_TYPE>();
+	const std::vector<unsigned long long>& masks = monsters.Column<MOB_CONDITION_MASK>();
+	std::vector<int>& hitPoints = monsters.Column<MOB_HIT_POINTS>();
+	const std::vector<int>& maxHitPoints = monsters.Column<MOB_MAX_HIT_POINTS>();
+	int unconscious = gGame->mConditionManager->UnconsciousIndex;
+
+	for (int row = 0; row < maps.size(); row++)
+	{
+		int mapID = maps[row];
+		int detail = GetMapDetail(mapID);
+		if (mapID < 0 || detail == DETAIL_FULL)
+			continue;
+
+		// knocked out stays knocked out until somebody comes along
+		if (ConditionManager::MaskHasCondition(masks[row], unconscious))
+			continue;
+
+		// a day's rest is 1d3
+		for (int d = 0; d < days && hitPoints[row] < maxHitPoints[row]; d++)
+		{
+			hitPoints[row] = std::min(maxHitPoints[row], hitPoints[row] + gGame->randomiser->getInt(1, 3));
+		}
+
+		const std::vector<int>& behaviours = creatureProfiles[types[row]].Behaviours;
+		if (std::find(behaviours.begin(), behaviours.end(), MOB_BEHAVIOUR_WANDER) == behaviours.end())
+			continue;
+
+		int id = monsters.IdOf(row);
+		int steps = detail == DETAIL_TURN ? turns * ABSTRACT_TURN_STEPS : days * ABSTRACT_DAY_STEPS;
+		for (int s = 0; s < steps; s++)
+		{
+			AbstractWander(id, mapID);
+		}
+	}
+}
+
+bool MobManager::AbstractWander(int entityID, int mapID)
+{
+	// one step in a random direction, if there's room - same as a wander turn, minus the fighting
+	Map* m = gGame->mMapManager->getMap(mapID);
+	int move_value = gGame->randomiser->getInt(0, m->outdoor ? 5 : 7);
+	int x, y;
+	gGame->mMapManager->shift(mapID, x, y, GetMobX(entityID), GetMobY(entityID), move_value);
+
+	if (gGame->mMapManager->isOutOfBounds(mapID, x, y) || !m->map->isWalkable(x, y) || m->getMobAt(x, y) || m->getCharacterAt(x, y))
+		return false;
+
+	m->setMob(x, y, entityID);
 	return true;
 }
 
+// The scans below read only the columns they need, straight down in row order, and turn a row back into an ID only when it matches.
+// Live means blocking, ie not unconscious (see Creature::IsBlocking).
+
 std::vector<int> MobManager::GetAllMonstersOnMap(int mapID, bool hostileOnly, bool liveOnly)
 {
 	std::vector<int> output;
 
-	for (int i = 0; i < mapIDs.size(); i++)
+	const std::vector<int>& maps = monsters.Column<MOB_MAP>();
+	const std::vector<int>& flags = monsters.Column<MOB_FLAGS>();
+	const std::vector<unsigned long long>& masks = monsters.Column<MOB_CONDITION_MASK>();
+	int unconscious = gGame->mConditionManager->UnconsciousIndex;
+
+	for (int row = 0; row < maps.size(); row++)
 	{
-		if (mapIDs[i] == mapID)
+		if (maps[row] == mapID)
 		{
-			if (!hostileOnly || Monsters_[i].IsHostile())
+			if (!hostileOnly || (flags[row] & MOB_FLAG_HOSTILE))
 			{
-				if (liveOnly && Monsters_[i].IsBlocking())
+				if (liveOnly && !ConditionManager::MaskHasCondition(masks[row], unconscious))
 				{
-					output.push_back(i);
+					output.push_back(monsters.IdOf(row));
 				}
 			}
 		}
@@ -697,15 +1177,20 @@ std::vector<int> MobManager::GetAllEnemyMonstersOnMap(int mapID, bool partyId, b
 {
 	std::vector<int> output;
 
-	for (int i = 0; i < mapIDs.size(); i++)
+	const std::vector<int>& maps = monsters.Column<MOB_MAP>();
+	const std::vector<unsigned long long>& masks = monsters.Column<MOB_CONDITION_MASK>();
+	int unconscious = gGame->mConditionManager->UnconsciousIndex;
+
+	for (int row = 0; row < maps.size(); row++)
 	{
-		if (mapIDs[i] == mapID)
+		if (maps[row] == mapID)
 		{
-			if (!gGame->mPartyManager->IsAnAnimal(partyId, i))
+			int monsterID = monsters.IdOf(row);
+			if (!gGame->mPartyManager->IsAnAnimal(partyId, monsterID))
 			{
-				if (liveOnly && Monsters_[i].IsBlocking())
+				if (liveOnly && !ConditionManager::MaskHasCondition(masks[row], unconscious))
 				{
-					output.push_back(i);
+					output.push_back(monsterID);
 				}
 			}
 		}
@@ -716,36 +1201,234 @@ std::vector<int> MobManager::GetAllEnemyMonstersOnMap(int mapID, bool partyId, b
 
 std::vector<int> MobManager::GetAllMonstersInRange(int mapID, int centerX, int centerY, int range, bool hostileOnly, bool liveOnly)
 {
-	std::vector<int> base = GetAllMonstersOnMap(mapID, hostileOnly);
-	int rangeSquared = pow(range, 2);
 	std::vector<int> output;
+	int rangeSquared = range * range;
+
+	const std::vector<int>& maps = monsters.Column<MOB_MAP>();
+	const std::vector<int>& xs = monsters.Column<MOB_X>();
+	const std::vector<int>& ys = monsters.Column<MOB_Y>();
+	const std::vector<int>& flags = monsters.Column<MOB_FLAGS>();
+	const std::vector<unsigned long long>& masks = monsters.Column<MOB_CONDITION_MASK>();
+	int unconscious = gGame->mConditionManager->UnconsciousIndex;
+
+	for (int row = 0; row < maps.size(); row++)
+	{
+		if (maps[row] != mapID)
+			continue;
+
+		int dx = xs[row] - centerX;
+		int dy = ys[row] - centerY;
+		if (dx * dx + dy * dy > rangeSquared)
+			continue;
+
+		// this has always only returned live monsters, whatever liveOnly says
+		if (hostileOnly && !(flags[row] & MOB_FLAG_HOSTILE))
+			continue;
+		if (ConditionManager::MaskHasCondition(masks[row], unconscious))
+			continue;
+
+		output.push_back(monsters.IdOf(row));
+	}
+
+	return output;
+}
 
-	for(int i=0;i<base.size();i++)
+size_t MobManager::GetMonsterMemory() const
+{
+	size_t total = monsters.GetColumnBytes();
+	for (const std::vector<int>& list : monsters.Column<MOB_CONDITIONS>())
+		total += list.capacity() * sizeof(int);
+	for (const std::vector<int>& list : monsters.Column<MOB_EQUIPPED>())
+		total += list.capacity() * sizeof(int);
+	for (const std::vector<int>& list : monsters.Column<MOB_HELD>())
+		total += list.capacity() * sizeof(int);
+	return total;
+}
+
+void MobManager::BenchmarkCreatureMemory(int count)
+{
+	// Needs the managers loaded (StartGame) but no window or map - the creatures are generated off-map.
+	typedef std::chrono::high_resolution_clock clock;
+	MobManager* mm = gGame->mMobManager;
+
+	size_t before = mm->GetMonsterMemory();
+	int templateIndex = mm->GetTemplateIndex("Goblin");
+
+	clock::time_point start = clock::now();
+	for (int i = 0; i < count; i++)
 	{
-		int monsterID = base[i];
-		int monsterX = GetMobX(monsterID);
-		int monsterY = GetMobY(monsterID);
+		mm->GenerateMonster(templateIndex, -1, 0, 0);
+	}
+	double spawnMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	size_t used = mm->GetMonsterMemory() - before;
+
+	// what the shared part of a goblin costs - which every goblin used to carry its own copy of
+	const CreatureProfile& profile = mm->GetProfile(templateIndex);
+	size_t profileBytes = sizeof(CreatureProfile) + profile.Name.capacity() + profile.Visual.capacity() + profile.SaveAs.capacity() + profile.Alignment.capacity()
+		+ profile.Attacks.capacity() * sizeof(AttackType) + profile.Abilities.capacity() * sizeof(std::string) + profile.Behaviours.capacity() * sizeof(int);
+	for (const AttackType& a : profile.Attacks)
+		profileBytes += a.Name().capacity();
+	for (const std::string& a : profile.Abilities)
+		profileBytes += a.capacity();
+	for (const std::vector<int>& sequence : profile.AttackSequences)
+		profileBytes += sizeof(sequence) + sequence.capacity() * sizeof(int);
+	profileBytes += profile.AttackLookup.size() * (sizeof(std::pair<const std::string, int>) + 4 * sizeof(void*));
+
+	ReportLine(LogCategory, "%d goblins: spawned in %.1fms, %zu bytes (%.1f per creature), shared profile %zu bytes",
+		count, spawnMs, used, (double)used / count, profileBytes);
+}
 
-		int distanceSquared = pow(monsterX - centerX, 2) + pow(monsterX - centerX, 2);
-		if(distanceSquared <= rangeSquared)
+void MobManager::BenchmarkMobTurns(int count)
+{
+	// Needs the managers loaded (StartGame) but no window. A party split over two big pillared maps (a dungeon and the wilderness),
+	// with a crowd of goblins around each half, half of them hunting the nearest of the party and half after the selected character.
+	// Times just the decide phase, which is the part that runs on the job system, and makes sure the jobs come up with exactly what
+	// one thread does.
+	typedef std::chrono::high_resolution_clock clock;
+	MobManager* mm = gGame->mMobManager;
+	CharacterManager* cm = gGame->mCharacterManager;
+
+	const int size = 300;
+	const int repeats = 20;
+	int mapIDs[2] = { gGame->mMapManager->buildEmptyMap(size, size, MAP_DUNGEON), gGame->mMapManager->buildEmptyMap(size, size, MAP_WILDERNESS) };
+	for (int mapID : mapIDs)
+	{
+		Map* m = gGame->mMapManager->getMap(mapID);
+		for (int y = 4; y < size; y += 8)
 		{
-			output.push_back(monsterID);
+			for (int x = 4; x < size; x += 8)
+			{
+				m->setProperties(x, y, false, false);
+				m->setProperties(x + 1, y, false, false);
+			}
 		}
 	}
 
-	return output;
+	// character 0 is the "nobody" character, same as the test game
+	if (cm->GetCharacterCount() == 0)
+		cm->GenerateTestCharacter("NULL", "Fighter");
+	for (int i = 0; i < 4; i++)
+	{
+		int id = cm->GenerateTestCharacter("Bench " + std::to_string(i), "Fighter");
+		cm->SpawnOnMap(id, mapIDs[i % 2], size / 2 + i, size / 2);
+		if (i == 0)
+			gGame->SetSelectedCharacterID(id);
+	}
+
+	int templateIndex = mm->GetTemplateIndex("Goblin");
+	std::vector<int> goblins;
+	for (int i = 0; i < count; i++)
+	{
+		int mapID = mapIDs[(i / 2) % 2];
+		Map* m = gGame->mMapManager->getMap(mapID);
+		int x, y;
+		do
+		{
+			x = gGame->randomiser->getInt(0, size - 1);
+			y = gGame->randomiser->getInt(0, size - 1);
+		} while (!m->map->isWalkable(x, y) || m->getMobAt(x, y));
+		int id = mm->GenerateMonster(templateIndex, mapID, x, y);
+		mm->SetBehaviour(id, i % 2 == 0 ? MOB_BEHAVIOUR_SEEK_ENEMY : MOB_BEHAVIOUR_SEEK_PLAYER);
+		goblins.push_back(id);
+	}
+
+	mm->PrepareDecisions(goblins);
+
+	JobSystem single(1);
+	JobSystem* pools[2] = { &single, gGame->mJobs };
+	double best[2] = { 0.0, 0.0 };
+	std::vector<MobDecision> results[2];
+	for (int p = 0; p < 2; p++)
+	{
+		for (int r = 0; r < repeats; r++)
+		{
+			clock::time_point start = clock::now();
+			mm->DecideAll(goblins, pools[p]);
+			double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+			if (r == 0 || ms < best[p])
+				best[p] = ms;
+		}
+		results[p] = mm->decisions;
+	}
+
+	ReportLine(LogCategory, "%d goblins deciding: %.2fms on one thread, %.2fms on %d threads (x%.1f), decisions %s",
+		count, best[0], best[1], pools[1]->GetThreadCount(), best[0] / best[1], results[0] == results[1] ? "match" : "DIFFER");
+}
+
+void MobManager::BenchmarkMapDetail(int count)
+{
+	// Needs the managers loaded (StartGame) but no window. Wandering goblins spread over eight wilderness maps with one character on
+	// the first, and an hour of game time a round at a time - once with every map at full detail, then again with everything but the
+	// party's map abstracted.
+	typedef std::chrono::high_resolution_clock clock;
+	MobManager* mm = gGame->mMobManager;
+	CharacterManager* cm = gGame->mCharacterManager;
+	TimeManager* tm = gGame->mTimeManager;
+
+	const int size = 100;
+	const int mapCount = 8;
+	std::vector<int> mapIDs;
+	for (int i = 0; i < mapCount; i++)
+	{
+		mapIDs.push_back(gGame->mMapManager->buildEmptyMap(size, size, MAP_WILDERNESS));
+	}
+
+	// character 0 is the "nobody" character, same as the test game
+	if (cm->GetCharacterCount() == 0)
+		cm->GenerateTestCharacter("NULL", "Fighter");
+	int pc = cm->GenerateTestCharacter("Bench", "Fighter");
+	cm->SpawnOnMap(pc, mapIDs[0], size / 2, size / 2);
+	gGame->SetSelectedCharacterID(pc);
+	gGame->GetCurrentMap() = mapIDs[0];
+
+	int templateIndex = mm->GetTemplateIndex("Goblin");
+	for (int i = 0; i < count; i++)
+	{
+		int mapID = mapIDs[i % mapCount];
+		Map* m = gGame->mMapManager->getMap(mapID);
+		int x, y;
+		do
+		{
+			x = gGame->randomiser->getInt(0, size - 1);
+			y = gGame->randomiser->getInt(0, size - 1);
+		} while (!m->map->isWalkable(x, y) || m->getMobAt(x, y) || m->getCharacterAt(x, y));
+		int id = mm->GenerateMonster(templateIndex, mapID, x, y);
+		mm->SetBehaviour(id, MOB_BEHAVIOUR_WANDER);
+	}
+
+	const int rounds = (int)(TimeManager::GetTimePeriodInSeconds(TIME_HOUR) / TimeManager::GetTimePeriodInSeconds(TIME_ROUND));
+	double ms[2];
+	unsigned long long events[2];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (pass == 1)
+			mm->UpdateMapDetail();
+
+		unsigned long long firstEvent = tm->GetEventCount();
+		clock::time_point start = clock::now();
+		for (int r = 0; r < rounds; r++)
+		{
+			tm->AdvanceTimeBy(TimeManager::GetTimePeriodInSeconds(TIME_ROUND));
+		}
+		ms[pass] = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+		events[pass] = tm->GetEventCount() - firstEvent;
+	}
+
+	ReportLine(LogCategory, "%d goblins over %d maps for an hour: %.2fms (%llu turns) all full, %.2fms (%llu turns) with %d abstract (x%.1f)",
+		count, mapCount, ms[0], events[0], ms[1], events[1], mapCount - 1, ms[0] / ms[1]);
 }
 
 void MobManager::DebugLog(std::string message)
 {
-	gLog->Log("MobManager", message);
+	DEBUG_LOG(message);
 }
 
 void MobManager::DumpMob(int mobID)
 {
 	// this dumps all mob details
 
-	DebugLog("Dumping Mob #" + std::to_string(mobID));
+	DEBUG_LOG("Dumping Mob #" + std::to_string(mobID));
 
 	Creature mob = GetMonster(mobID);
 
@@ -762,8 +1445,7 @@ void MobManager::DumpMob(int mobID)
 	dumpLine = "Name:" + name;
 	dumpFile << dumpLine << std::endl;
 
-	CreatureTemplate ct = creatureTemplateSet.CreatureTemplates()[mob.GetCreatureType()];
-	std::string templateName = ct.Name();
+	std::string templateName = GetProfile(mob.GetCreatureType()).Name;
 	dumpLine = "Template:" + templateName;
 	dumpFile << dumpLine << std::endl;
 
@@ -784,12 +1466,12 @@ void MobManager::DumpMob(int mobID)
 	dumpLine = "AC:" + ac;
 	dumpFile << dumpLine << std::endl;
 	
-	int map = mapIDs[mobID];
+	int map = monsters.Get<MOB_MAP>(mobID);
 	std::string map_text = "Current Map:" + (map == -1 ? "None" : std::to_string(map));
 	dumpFile << map_text << std::endl;
 
 	std::string behaviour_name = "Current Behaviour:";
-	int behaviour = currentBehaviour[mobID];
+	int behaviour = monsters.Get<MOB_BEHAVIOUR>(mobID);
 	if (behaviour == -1)
 	{
 		behaviour_name += "None";
@@ -815,7 +1497,7 @@ std::string MobManager::DumpConditions(int mobID)
 	std::string output = "Conditions:";
 
 	Creature mob = GetMonster(mobID);
-	std::vector<int> conditions = mob.GetConditions();
+	const std::vector<int>& conditions = mob.GetConditions();
 	for (int i = 0; i < conditions.size(); i++)
 	{
 		if (i != 0) output += ",";
@@ -1,33 +1,285 @@
 #include "OutputLog.h"
-#include <iomanip>
+#include <chrono>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
 
 OutputLog* gLog;
 
 OutputLog::OutputLog() : OutputLog("game.txt")
 {
-	
+
 }
 
-OutputLog::OutputLog(std::string filename)
+OutputLog::OutputLog(std::string filename, bool threaded, int capacity) : threaded(threaded)
 {
 	outputFile.open(filename, std::ios::out | std::ios::app);
 	previousTime = 0;
+	minimumLevel = LOG_LEVEL_TRACE;
+
+	// round the capacity up to a power of two
+	unsigned long long size = 1;
+	while (size < (unsigned long long)capacity)
+		size <<= 1;
+
+	ring = std::vector<LogEntry>(threaded ? size : 0);
+	for (unsigned long long i = 0; i < ring.size(); i++)
+	{
+		ring[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	mask = size - 1;
+
+	enqueuePos.store(0);
+	dequeuePos.store(0);
+	writtenPos.store(0);
+	droppedCount.store(0);
+	reportedDropped = 0;
+
+	stopping.store(false);
+	flushRequested.store(false);
+
+	if (threaded)
+	{
+		writer = std::thread(&OutputLog::WriterLoop, this);
+	}
 }
 
 OutputLog::~OutputLog()
 {
+	if (threaded)
+	{
+		stopping.store(true);
+		if (writer.joinable())
+			writer.join();
+	}
 	outputFile.close();
 }
 
 void OutputLog::Log(std::string source, std::string message)
+{
+	if (!threaded)
+	{
+		std::string batch;
+		WriteLine(batch, source, message);
+		outputFile << batch;
+		return;
+	}
+
+	// claim a slot. The slot is free when its sequence number matches our position; if it's still a lap behind, the ring is full.
+	unsigned long long pos = enqueuePos.load(std::memory_order_relaxed);
+	LogEntry* entry;
+	while (true)
+	{
+		entry = &ring[pos & mask];
+		unsigned long long seq = entry->sequence.load(std::memory_order_acquire);
+		long long diff = (long long)seq - (long long)pos;
+		if (diff == 0)
+		{
+			if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// full - drop it rather than wait on the disk
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+		{
+			pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	entry->source = std::move(source);
+	entry->message = std::move(message);
+	entry->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool OutputLog::TryDequeue(std::string& source, std::string& message)
+{
+	// only the writer thread consumes, so no CAS needed on this side
+	unsigned long long pos = dequeuePos.load(std::memory_order_relaxed);
+	LogEntry& entry = ring[pos & mask];
+	if (entry.sequence.load(std::memory_order_acquire) != pos + 1)
+		return false; // empty, or the producer hasn't finished writing it yet
+
+	source.swap(entry.source);
+	message.swap(entry.message);
+	entry.source.clear();
+	entry.message.clear();
+
+	// hand the slot back to the producers for the next lap
+	entry.sequence.store(pos + mask + 1, std::memory_order_release);
+	dequeuePos.store(pos + 1, std::memory_order_relaxed);
+	return true;
+}
+
+void OutputLog::WriteLine(std::string& batch, const std::string& source, const std::string& message)
 {
 	std::time_t t = std::time(nullptr);
 	if (t > previousTime)
 	{
-		outputFile << std::put_time(std::gmtime(&t), "%c %Z") << std::endl;
+		char stamp[64];
+		std::strftime(stamp, sizeof(stamp), "%c %Z", std::gmtime(&t));
+		batch += stamp;
+		batch += '\n';
 		previousTime = t;
 	}
-	
-	std::string logLine = source + ":" + message;
-	outputFile << logLine << std::endl;
-}
\ No newline at end of file
+
+	batch += source;
+	batch += ':';
+	batch += message;
+	batch += '\n';
+}
+
+int OutputLog::DrainBatch(std::string& batch)
+{
+	std::string source, message;
+	int count = 0;
+
+	batch.clear();
+	while (TryDequeue(source, message))
+	{
+		WriteLine(batch, source, message);
+		count++;
+	}
+
+	unsigned long long dropped = droppedCount.load(std::memory_order_relaxed);
+	if (dropped != reportedDropped)
+	{
+		WriteLine(batch, "OutputLog", "log buffer full, dropped " + std::to_string(dropped - reportedDropped) + " messages (" + std::to_string(dropped) + " total)");
+		reportedDropped = dropped;
+	}
+
+	if (!batch.empty())
+	{
+		outputFile.write(batch.data(), batch.size());
+		outputFile.flush();
+	}
+
+	writtenPos.store(dequeuePos.load(std::memory_order_relaxed), std::memory_order_release);
+	return count;
+}
+
+void OutputLog::WriterLoop()
+{
+	std::string batch;
+	batch.reserve(64 * 1024);
+
+	while (true)
+	{
+		int written = DrainBatch(batch);
+
+		if (stopping.load())
+		{
+			// one last sweep for anything that arrived while we were writing
+			DrainBatch(batch);
+			break;
+		}
+
+		// nothing to do - have a short nap rather than make the producers signal us on every message
+		if (written == 0 && !flushRequested.load())
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+}
+
+void OutputLog::Flush()
+{
+	if (!threaded)
+	{
+		outputFile.flush();
+		return;
+	}
+
+	unsigned long long target = enqueuePos.load(std::memory_order_acquire);
+
+	if (!writer.joinable() || std::this_thread::get_id() == writer.get_id())
+	{
+		// we're on the writer (or it's gone), so nobody else is going to drain it for us
+		std::string batch;
+		DrainBatch(batch);
+		return;
+	}
+
+	flushRequested.store(true);
+
+	// give up after a second - if we're flushing because we're crashing, the writer might be wedged
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	while (writtenPos.load(std::memory_order_acquire) < target && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+
+	flushRequested.store(false);
+}
+
+bool OutputLog::ParseLevel(const std::string& name, LogLevel& level)
+{
+	static const char* names[] = { "trace", "debug", "info", "warning", "error", "none" };
+	for (int i = LOG_LEVEL_TRACE; i <= LOG_LEVEL_NONE; i++)
+	{
+		if (name == names[i])
+		{
+			level = (LogLevel)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ReportLine(const char* category, const char* format, ...)
+{
+	char buffer[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	printf("%s\n", buffer);
+	RCK_LOG_INFO(category, buffer);
+}
+
+// =============
+// Exit handlers
+// =============
+
+static void FlushLogAtExit()
+{
+	if (gLog != NULL)
+		gLog->Flush();
+}
+
+static void FlushLogOnTerminate()
+{
+	if (gLog != NULL)
+	{
+		gLog->Log("OutputLog", "std::terminate called");
+		gLog->Flush();
+	}
+	std::abort();
+}
+
+static void FlushLogOnSignal(int sig)
+{
+	// Not strictly async-signal-safe, but we're going down anyway and the last few lines are usually the ones we want
+	std::signal(sig, SIG_DFL);
+	if (gLog != NULL)
+	{
+		gLog->Log("OutputLog", "fatal signal " + std::to_string(sig));
+		gLog->Flush();
+	}
+	std::raise(sig);
+}
+
+void OutputLog::InstallExitHandlers()
+{
+	std::atexit(FlushLogAtExit);
+	std::set_terminate(FlushLogOnTerminate);
+
+	std::signal(SIGSEGV, FlushLogOnSignal);
+	std::signal(SIGABRT, FlushLogOnSignal);
+	std::signal(SIGFPE, FlushLogOnSignal);
+	std::signal(SIGILL, FlushLogOnSignal);
+}
@@ -0,0 +1,152 @@
+#include "ParallelLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+int ParallelLoader::Add(std::string name, std::function<void()> run, std::vector<int> dependsOn)
+{
+	// only earlier jobs can be depended on, which rules out cycles (and the deadlock that would come with one)
+	int index = (int)jobs.size();
+	dependsOn.erase(std::remove_if(dependsOn.begin(), dependsOn.end(), [index](int d) { return d < 0 || d >= index; }), dependsOn.end());
+
+	LoaderJob job;
+	job.name = name;
+	job.run = run;
+	job.dependsOn = dependsOn;
+	jobs.push_back(job);
+	return index;
+}
+
+void ParallelLoader::Run(int threadCount)
+{
+	typedef std::chrono::high_resolution_clock clock;
+
+	int count = (int)jobs.size();
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+	threadsUsed = std::max(1, std::min(threadCount, count));
+
+	std::vector<int> waitingOn(count);
+	std::vector<std::vector<int>> dependents(count);
+	std::vector<bool> skip(count, false);
+	std::deque<int> ready;
+	for (int i = 0; i < count; i++)
+	{
+		jobs[i].finished = false;
+		waitingOn[i] = (int)jobs[i].dependsOn.size();
+		for (int d : jobs[i].dependsOn)
+			dependents[d].push_back(i);
+		if (waitingOn[i] == 0)
+			ready.push_back(i);
+	}
+
+	std::mutex lock;
+	std::condition_variable wake;
+	int done = 0;
+	std::exception_ptr firstError;
+
+	clock::time_point start = clock::now();
+
+	auto worker = [&]()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		while (done < count)
+		{
+			if (ready.empty())
+			{
+				wake.wait(guard);
+				continue;
+			}
+
+			int i = ready.front();
+			ready.pop_front();
+
+			bool failed = skip[i];
+			if (!skip[i])
+			{
+				// the job itself runs unlocked, so the others can get on with theirs
+				guard.unlock();
+
+				std::exception_ptr error;
+				clock::time_point jobStart = clock::now();
+				try
+				{
+					jobs[i].run();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				clock::time_point jobEnd = clock::now();
+
+				guard.lock();
+
+				jobs[i].startMs = std::chrono::duration<double, std::milli>(jobStart - start).count();
+				jobs[i].durationMs = std::chrono::duration<double, std::milli>(jobEnd - jobStart).count();
+				if (error)
+				{
+					failed = true;
+					if (!firstError)
+						firstError = error;
+				}
+			}
+
+			jobs[i].finished = !failed;
+			done++;
+
+			for (int d : dependents[i])
+			{
+				if (failed)
+					skip[d] = true;
+				if (--waitingOn[d] == 0)
+					ready.push_back(d);
+			}
+
+			wake.notify_all();
+		}
+	};
+
+	// the calling thread works too, rather than just sitting in join
+	std::vector<std::thread> helpers;
+	for (int t = 1; t < threadsUsed; t++)
+		helpers.emplace_back(worker);
+	worker();
+	for (std::thread& t : helpers)
+		t.join();
+
+	wallMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	if (firstError)
+		std::rethrow_exception(firstError);
+}
+
+std::vector<std::string> ParallelLoader::Report() const
+{
+	std::vector<const LoaderJob*> sorted;
+	double total = 0.0;
+	for (const LoaderJob& job : jobs)
+	{
+		sorted.push_back(&job);
+		total += job.durationMs;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const LoaderJob* a, const LoaderJob* b) { return a->durationMs > b->durationMs; });
+
+	std::vector<std::string> lines;
+	char buffer[256];
+	for (const LoaderJob* job : sorted)
+	{
+		if (job->finished)
+			snprintf(buffer, sizeof(buffer), "%-20s %8.2fms (started at %.2fms)", job->name.c_str(), job->durationMs, job->startMs);
+		else
+			snprintf(buffer, sizeof(buffer), "%-20s   failed or skipped", job->name.c_str());
+		lines.push_back(buffer);
+	}
+
+	snprintf(buffer, sizeof(buffer), "%d jobs on %d threads: %.2fms wall, %.2fms of loading", (int)jobs.size(), threadsUsed, wallMs, total);
+	lines.push_back(buffer);
+	return lines;
+}
@@ -1,4 +1,5 @@
 #include "Party.h"
+#include "Snapshot.h"
 
 PartyManager::PartyManager()
 {
@@ -12,13 +13,11 @@ PartyManager::~PartyManager()
 
 PartyManager* PartyManager::LoadPartyData()
 {
-	gLog->Log("Party Loader", "Started");
+	RCK_LOG_INFO("Party Loader", "Started");
 	
 	PartyManager* output = new PartyManager();
 
-	output->nextPartyID = 0;
-
-	gLog->Log("Party Loader", "Completed");
+	RCK_LOG_INFO("Party Loader", "Completed");
 	
 	return output;
 }
@@ -44,39 +43,53 @@ void PartyManager::RemoveAnimal(int partyID, int entityID)
 	animals[partyID].erase(r);
 }
 
-int PartyManager::shellGenerate()
+void PartyManager::RemoveAnimalFromAll(int mobID)
 {
-	int output = nextPartyID++;
+	for (std::vector<int>& partyAnimals : animals)
+	{
+		partyAnimals.erase(std::remove(partyAnimals.begin(), partyAnimals.end(), mobID), partyAnimals.end());
+	}
+}
 
-	DebugLog("Generating Empty Party #" + std::to_string(output));
-	
-	std::vector<int> pcs;
-	playerCharacters.push_back(pcs);
-	std::vector<int> henchs;
-	henchmen.push_back(henchs);
-	std::vector<int> anims;
-	animals.push_back(anims);
-	std::vector<std::pair<int, int>> inv;
-	partyInventory.push_back(inv);
-	totalCarryCapacity.push_back(0);
-	totalSuppliesFood.push_back(0);
-	partyXPos.push_back(-1);
-	partyYPos.push_back(-1);
-	active.push_back(true);
+int PartyManager::shellGenerate()
+{
+	int output = partyIDs.Allocate();
+
+	DEBUG_LOG("Generating Empty Party #" + std::to_string(output));
+
+	// either a brand new slot or one a merged party gave back - reset it the same either way
+	int size = partyIDs.GetCapacity();
+	playerCharacters.resize(size);
+	henchmen.resize(size);
+	animals.resize(size);
+	partyInventory.resize(size);
+	totalCarryCapacity.resize(size);
+	totalSuppliesFood.resize(size);
+	partyXPos.resize(size);
+	partyYPos.resize(size);
+
+	playerCharacters[output].clear();
+	henchmen[output].clear();
+	animals[output].clear();
+	partyInventory[output].clear();
+	totalCarryCapacity[output] = 0;
+	totalSuppliesFood[output] = 0;
+	partyXPos[output] = -1;
+	partyYPos[output] = -1;
 
 	return output;
 }
 
 int PartyManager::GenerateEmptyParty()
 {
-	DebugLog("Creating empty Party");
+	DEBUG_LOG("Creating empty Party");
 	int output = shellGenerate();
 	return output;
 }
 
 int PartyManager::GenerateBaseTestParty()
 {
-	DebugLog("Creating base test party: 1 Fighter and 1 Mule");
+	DEBUG_LOG("Creating base test party: 1 Fighter and 1 Mule");
 	int output = shellGenerate();
 
 	GeneratePlayerCharacter(output, "BaseTestFighter1", "Fighter");
@@ -87,7 +100,7 @@ int PartyManager::GenerateBaseTestParty()
 
 int PartyManager::GenerateAITestParty()
 {
-	DebugLog("Creating base test party: 2 Fighters, 1 Henchman (NM) and 1 Mule");
+	DEBUG_LOG("Creating base test party: 2 Fighters, 1 Henchman (NM) and 1 Mule");
 	int output = shellGenerate();
 
 	GeneratePlayerCharacter(output, "BaseTestFighter1", "Fighter");
@@ -102,7 +115,7 @@ int PartyManager::GenerateAITestParty()
 void PartyManager::AddPlayerCharacter(int partyID, int characterID)
 {
 	playerCharacters[partyID].push_back(characterID);
-	DebugLog("PC (character ID #" + std::to_string(characterID) + ") added to party #" + std::to_string(partyID));
+	DEBUG_LOG("PC (character ID #" + std::to_string(characterID) + ") added to party #" + std::to_string(partyID));
 }
 void PartyManager::GeneratePlayerCharacter(int partyID, std::string name, const std::string _class)
 {
@@ -113,7 +126,7 @@ void PartyManager::GeneratePlayerCharacter(int partyID, std::string name, const
 void PartyManager::AddHenchman(int partyID, int characterID)
 {
 	henchmen[partyID].push_back(characterID);
-	DebugLog("Henchman (character ID #" + std::to_string(characterID) + ") added to party #" + std::to_string(partyID));
+	DEBUG_LOG("Henchman (character ID #" + std::to_string(characterID) + ") added to party #" + std::to_string(partyID));
 }
 void PartyManager::GenerateHenchman(int partyID, std::string name)
 {
@@ -124,7 +137,7 @@ void PartyManager::GenerateHenchman(int partyID, std::string name)
 void PartyManager::AddAnimal(int partyID, int mobID)
 {
 	animals[partyID].push_back(mobID);
-	DebugLog("Animal (mob ID #" + std::to_string(mobID) + ") added to party #" + std::to_string(partyID));
+	DEBUG_LOG("Animal (mob ID #" + std::to_string(mobID) + ") added to party #" + std::to_string(partyID));
 }
 void PartyManager::GenerateAnimal(int partyID, std::string name)
 {
@@ -197,7 +210,7 @@ void PartyManager::MergeParty(int fromPartyID, int toPartyID)
 	partyXPos[fromPartyID] = -1;
 	partyYPos[fromPartyID] = -1;
 
-	active[fromPartyID] = false;
+	partyIDs.Release(fromPartyID);
 }
 
 int PartyManager::getNextPlayerCharacter(int partyID, int currentPC)
@@ -273,7 +286,7 @@ bool PartyManager::IsAnAnimal(int partyID, int entityID)
 
 void PartyManager::DebugLog(std::string message)
 {
-	gLog->Log("Party Manager", message);
+	DEBUG_LOG(message);
 }
 
 bool PartyManager::TurnHandler(int entityID, double time)
@@ -288,7 +301,7 @@ bool PartyManager::TimeHandler(int rounds, int turns, int hours, int days, int w
 
 void PartyManager::DumpParty(int partyID)
 {
-	DebugLog("Dumping Party");
+	DEBUG_LOG("Dumping Party");
 	
 	for(int character : playerCharacters[partyID])
 	{
@@ -305,3 +318,33 @@ void PartyManager::DumpParty(int partyID)
 		gGame->mMobManager->DumpMob(beast);
 	}
 }
+
+void PartyManager::SaveSnapshot(SnapshotWriter& w)
+{
+	w.Section("PRTY");
+	partyIDs.Save(w);
+	w.Write(playerCharacters);
+	w.Write(henchmen);
+	w.Write(animals);
+	w.Write(partyInventory);
+	w.Write(totalCarryCapacity);
+	w.Write(totalSuppliesFood);
+	w.Write(partyXPos);
+	w.Write(partyYPos);
+}
+
+bool PartyManager::LoadSnapshot(SnapshotReader& r)
+{
+	if (!r.Section("PRTY"))
+		return false;
+	partyIDs.Load(r);
+	r.Read(playerCharacters);
+	r.Read(henchmen);
+	r.Read(animals);
+	r.Read(partyInventory);
+	r.Read(totalCarryCapacity);
+	r.Read(totalSuppliesFood);
+	r.Read(partyXPos);
+	r.Read(partyYPos);
+	return r.Ok();
+}
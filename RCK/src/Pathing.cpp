@@ -0,0 +1,601 @@
+#include "Pathing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include "Game.h"
+#include "JobSystem.h"
+
+int GetWalkableNeighbours(Map* m, int x, int y, int* cells, int* costs)
+{
+	int count = 0;
+	if (m->outdoor)
+	{
+		// hex map, odd rows are shifted right
+		int (*offsets)[2] = (y & 0x1) ? move_map_odd : move_map_even;
+		for (int i = 0; i < HEX_MAX; i++)
+		{
+			int nx = x + offsets[i][0];
+			int ny = y + offsets[i][1];
+			if (nx < 0 || ny < 0 || nx >= m->width || ny >= m->height)
+				continue;
+
+			int cell = ny * m->width + nx;
+			if (m->walkCost[cell] == 0)
+				continue;
+
+			cells[count] = cell;
+			costs[count] = STEP_COST_STRAIGHT * m->walkCost[cell];
+			count++;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < ORTHO_MAX; i++)
+		{
+			int nx = x + move_map_ortho[i][0];
+			int ny = y + move_map_ortho[i][1];
+			if (nx < 0 || ny < 0 || nx >= m->width || ny >= m->height)
+				continue;
+
+			int cell = ny * m->width + nx;
+			if (m->walkCost[cell] == 0)
+				continue;
+
+			cells[count] = cell;
+			costs[count] = ((move_map_ortho[i][0] != 0 && move_map_ortho[i][1] != 0) ? STEP_COST_DIAGONAL : STEP_COST_STRAIGHT) * m->walkCost[cell];
+			count++;
+		}
+	}
+	return count;
+}
+
+// lower bound on the cost between two cells, for A*. Assumes every cell costs the minimum to walk through.
+static int EstimateCost(Map* m, int from, int to)
+{
+	int fx = from % m->width, fy = from / m->width;
+	int tx = to % m->width, ty = to / m->width;
+
+	if (m->outdoor)
+	{
+		// convert the offset rows (odd rows shifted right) to cube coordinates and take the hex distance
+		int fq = fx - (fy - (fy & 0x1)) / 2;
+		int tq = tx - (ty - (ty & 0x1)) / 2;
+		int dq = tq - fq;
+		int dr = ty - fy;
+		int ds = -dq - dr;
+		return STEP_COST_STRAIGHT * std::max(abs(dq), std::max(abs(dr), abs(ds)));
+	}
+
+	// octile distance
+	int dx = abs(tx - fx);
+	int dy = abs(ty - fy);
+	return STEP_COST_STRAIGHT * std::max(dx, dy) + (STEP_COST_DIAGONAL - STEP_COST_STRAIGHT) * std::min(dx, dy);
+}
+
+void DistanceField::Relax(Map* m)
+{
+	// plain Dijkstra out from whatever is on the open heap. Distances only ever go down, so this works for extending a field too.
+	int cells[8];
+	int costs[8];
+	auto further = std::greater<std::pair<int, int>>();
+
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), further);
+		std::pair<int, int> current = open.back();
+		open.pop_back();
+
+		int cell = current.second;
+		if (current.first > distance[cell])
+			continue; // already found a shorter way here
+
+		int count = GetWalkableNeighbours(m, cell % m->width, cell / m->width, cells, costs);
+		for (int i = 0; i < count; i++)
+		{
+			int d = current.first + costs[i];
+			if (d < distance[cells[i]])
+			{
+				distance[cells[i]] = d;
+				open.push_back(std::make_pair(d, cells[i]));
+				std::push_heap(open.begin(), open.end(), further);
+			}
+		}
+	}
+}
+
+void DistanceField::Update(int _mapID, Map* m, std::vector<int>& newSources)
+{
+	std::sort(newSources.begin(), newSources.end());
+	newSources.erase(std::unique(newSources.begin(), newSources.end()), newSources.end());
+
+	bool sameLayout = mapID == _mapID && mapVersion == m->version;
+	if (sameLayout && newSources == sources)
+		return;
+
+	auto further = std::greater<std::pair<int, int>>();
+	open.clear();
+
+	if (sameLayout && std::includes(newSources.begin(), newSources.end(), sources.begin(), sources.end()))
+	{
+		// only additions, so we can keep what we have and spread out from the new ones
+		for (int cell : newSources)
+		{
+			if (distance[cell] != 0)
+			{
+				distance[cell] = 0;
+				open.push_back(std::make_pair(0, cell));
+			}
+		}
+	}
+	else
+	{
+		distance.assign(m->width * m->height, FIELD_UNREACHABLE);
+		for (int cell : newSources)
+		{
+			distance[cell] = 0;
+			open.push_back(std::make_pair(0, cell));
+		}
+	}
+	std::make_heap(open.begin(), open.end(), further);
+
+	mapID = _mapID;
+	mapVersion = m->version;
+	width = m->width;
+	sources = newSources;
+	rebuilds++;
+
+	Relax(m);
+}
+
+int DistanceField::GetDistance(int x, int y)
+{
+	if (distance.empty())
+		return FIELD_UNREACHABLE;
+
+	return distance[y * width + x];
+}
+
+bool DistanceField::Descend(Map* m, int x, int y, int& nx, int& ny)
+{
+	if (distance.empty())
+		return false;
+
+	int cells[8];
+	int costs[8];
+	int best = distance[y * m->width + x];
+	int bestCell = -1;
+
+	int count = GetWalkableNeighbours(m, x, y, cells, costs);
+	for (int i = 0; i < count; i++)
+	{
+		int d = distance[cells[i]];
+		if (d >= best)
+			continue;
+
+		// sources are where the party is standing, so we step onto them (and attack) rather than going round
+		if (d != 0 && m->getMobAt(cells[i] % m->width, cells[i] / m->width))
+			continue;
+
+		best = d;
+		bestCell = cells[i];
+	}
+
+	if (bestCell == -1)
+		return false;
+
+	nx = bestCell % m->width;
+	ny = bestCell / m->width;
+	return true;
+}
+
+PathResult DistanceField::NextStep(Map* m, int x, int y, int& nx, int& ny)
+{
+	int d = GetDistance(x, y);
+
+	if (d == 0)
+		return PATH_ARRIVED;
+
+	if (d == FIELD_UNREACHABLE)
+		return PATH_BLOCKED;
+
+	return Descend(m, x, y, nx, ny) ? PATH_STEP : PATH_WAITING;
+}
+
+PathPlanner::~PathPlanner()
+{
+	for (MapPathSlot* slot : slots)
+	{
+		delete slot;
+	}
+
+	for (DistanceField* field : fields)
+	{
+		delete field;
+	}
+}
+
+PathPlanner::MapPathSlot* PathPlanner::GetSlot(int mapID)
+{
+	if (mapID >= (int)slots.size())
+	{
+		slots.resize(mapID + 1, NULL);
+	}
+
+	if (slots[mapID] == NULL)
+	{
+		Map* m = mapManager->getMap(mapID);
+		MapPathSlot* slot = new MapPathSlot();
+		slot->cost.resize(m->width * m->height);
+		slot->parent.resize(m->width * m->height);
+		slot->seen.resize(m->width * m->height, 0);
+		slot->closed.resize(m->width * m->height, 0);
+		slots[mapID] = slot;
+	}
+
+	return slots[mapID];
+}
+
+bool PathPlanner::Search(Map* m, MapPathSlot* slot, int origin, int target, std::vector<int>& steps)
+{
+	if (m->walkCost[target] == 0)
+		return false;
+
+	if (++slot->stamp == 0)
+	{
+		// wrapped round, so old stamps could look current. Start again.
+		std::fill(slot->seen.begin(), slot->seen.end(), 0);
+		std::fill(slot->closed.begin(), slot->closed.end(), 0);
+		slot->stamp = 1;
+	}
+	unsigned int stamp = slot->stamp;
+
+	auto further = std::greater<std::pair<int, int>>();
+	std::vector<std::pair<int, int>>& open = slot->open;
+	open.clear();
+
+	slot->cost[origin] = 0;
+	slot->parent[origin] = -1;
+	slot->seen[origin] = stamp;
+	open.push_back(std::make_pair(EstimateCost(m, origin, target), origin));
+
+	int cells[8];
+	int costs[8];
+	bool found = false;
+
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), further);
+		int cell = open.back().second;
+		open.pop_back();
+
+		if (slot->closed[cell] == stamp)
+			continue; // stale entry, we've already expanded this one more cheaply
+		slot->closed[cell] = stamp;
+
+		if (cell == target)
+		{
+			found = true;
+			break;
+		}
+
+		int count = GetWalkableNeighbours(m, cell % m->width, cell / m->width, cells, costs);
+		for (int i = 0; i < count; i++)
+		{
+			int next = cells[i];
+			int c = slot->cost[cell] + costs[i];
+			if (slot->seen[next] != stamp || c < slot->cost[next])
+			{
+				slot->seen[next] = stamp;
+				slot->cost[next] = c;
+				slot->parent[next] = cell;
+				open.push_back(std::make_pair(c + EstimateCost(m, next, target), next));
+				std::push_heap(open.begin(), open.end(), further);
+			}
+		}
+	}
+
+	if (!found)
+		return false;
+
+	// walk back from the target, then turn it round
+	for (int cell = target; cell != origin; cell = slot->parent[cell])
+	{
+		steps.push_back(cell);
+	}
+	std::reverse(steps.begin(), steps.end());
+	return true;
+}
+
+bool PathPlanner::Plan(CachedPath& p, int mapID, int ox, int oy, int tx, int ty)
+{
+	Map* m = mapManager->getMap(mapID);
+
+	searches++;
+
+	p.mapID = mapID;
+	p.mapVersion = m->version;
+	p.targetX = tx;
+	p.targetY = ty;
+	p.next = 0;
+	p.lastCell = -1;
+	p.steps.clear();
+
+	if (!Search(m, GetSlot(mapID), oy * m->width + ox, ty * m->width + tx, p.steps))
+	{
+		p.mapID = -1;
+		return false;
+	}
+
+	return true;
+}
+
+PathResult PathPlanner::NextStep(int manager, int entityID, int mapID, int ox, int oy, int tx, int ty, int& nx, int& ny)
+{
+	if (ox == tx && oy == ty)
+		return PATH_ARRIVED;
+
+	Map* m = mapManager->getMap(mapID);
+	CachedPath& p = cache[PackOccupant(manager, entityID)];
+	int here = oy * m->width + ox;
+
+	bool valid = p.mapID == mapID && p.mapVersion == m->version && p.next < p.steps.size();
+	if (valid)
+	{
+		if (here == p.steps[p.next])
+		{
+			// the last step we gave out worked
+			p.next++;
+		}
+		else if (here != p.lastCell)
+		{
+			// something moved us that wasn't our path (knockback, map transition etc)
+			valid = false;
+		}
+	}
+
+	if (valid)
+	{
+		size_t remaining = p.steps.size() - p.next;
+		bool targetMoved = tx != p.targetX || ty != p.targetY;
+		if (remaining == 0 || (targetMoved && remaining <= CORRIDOR))
+		{
+			// we're at (or nearly at) where we planned to go, and the target isn't there
+			valid = false;
+		}
+		else if (abs(tx - p.targetX) > CORRIDOR || abs(ty - p.targetY) > CORRIDOR)
+		{
+			valid = false;
+		}
+	}
+
+	if (!valid)
+	{
+		if (!Plan(p, mapID, ox, oy, tx, ty))
+			return PATH_BLOCKED;
+
+		if (p.steps.empty())
+			return PATH_ARRIVED;
+	}
+
+	p.lastCell = here;
+	nx = p.steps[p.next] % m->width;
+	ny = p.steps[p.next] / m->width;
+	return PATH_STEP;
+}
+
+void PathPlanner::Forget(int manager, int entityID)
+{
+	cache.erase(PackOccupant(manager, entityID));
+}
+
+DistanceField* PathPlanner::FieldSlot(int mapID, int fieldType)
+{
+	size_t index = mapID * FIELD_MAX + fieldType;
+	if (index >= fields.size())
+	{
+		fields.resize(index + 1, NULL);
+	}
+	if (fields[index] == NULL)
+	{
+		fields[index] = new DistanceField();
+	}
+
+	return fields[index];
+}
+
+void PathPlanner::GatherSources(int mapID, int fieldType, DistanceField* field, std::vector<int>& out)
+{
+	Map* m = mapManager->getMap(mapID);
+	CharacterManager* cm = gGame->mCharacterManager;
+
+	out.clear();
+	switch (fieldType)
+	{
+	case FIELD_PARTY:
+		for (int c : cm->GetConditionCharactersOnMap(mapID, gGame->mConditionManager->UnconsciousIndex, false))
+		{
+			out.push_back(cm->GetPlayerY(c) * m->width + cm->GetPlayerX(c));
+		}
+		break;
+
+	case FIELD_PLAYER:
+		{
+			int c = gGame->GetSelectedCharacterID();
+			if (cm->GetPlayerMap(c) == mapID)
+			{
+				out.push_back(cm->GetPlayerY(c) * m->width + cm->GetPlayerX(c));
+			}
+		}
+		break;
+
+	case FIELD_ITEMS:
+		if (field->sourceVersion == m->itemVersion && !field->GetSources().empty())
+		{
+			// nothing dropped or picked up, so don't go looking through every cell
+			out = field->GetSources();
+		}
+		else
+		{
+			for (int cell = 0; cell < m->width * m->height; cell++)
+			{
+				if (!m->items[cell].empty())
+					out.push_back(cell);
+			}
+			field->sourceVersion = m->itemVersion;
+		}
+		break;
+	}
+}
+
+DistanceField* PathPlanner::GetField(int mapID, int fieldType)
+{
+	// gather up the sources. Update() works out whether anything actually changed.
+	DistanceField* field = FieldSlot(mapID, fieldType);
+	GatherSources(mapID, fieldType, field, sourceScratch);
+	field->Update(mapID, mapManager->getMap(mapID), sourceScratch);
+	return field;
+}
+
+void PathPlanner::UpdateFields(const std::vector<int>& mapIDs, const std::vector<int>& fieldTypes)
+{
+	// the sources come from all over the managers so they're gathered here, but each field only touches itself while it relaxes,
+	// so the rebuilds themselves can go side by side
+	size_t count = mapIDs.size() * fieldTypes.size();
+	if (batchSources.size() < count)
+		batchSources.resize(count);
+
+	std::vector<JobHandle> jobs;
+	for (size_t i = 0; i < count; i++)
+	{
+		int mapID = mapIDs[i / fieldTypes.size()];
+		int fieldType = fieldTypes[i % fieldTypes.size()];
+		Map* m = mapManager->getMap(mapID);
+		DistanceField* field = FieldSlot(mapID, fieldType);
+		std::vector<int>& sources = batchSources[i];
+		GatherSources(mapID, fieldType, field, sources);
+		jobs.push_back(gGame->mJobs->Submit([field, mapID, m, &sources](JobContext&) { field->Update(mapID, m, sources); }));
+	}
+
+	for (const JobHandle& job : jobs)
+	{
+		gGame->mJobs->Wait(job);
+	}
+}
+
+PathResult PathPlanner::NextStepOnField(int mapID, int fieldType, int ox, int oy, int& nx, int& ny)
+{
+	return GetField(mapID, fieldType)->NextStep(mapManager->getMap(mapID), ox, oy, nx, ny);
+}
+
+void PathPlanner::BenchmarkPathing(int pursuerCount, int mapType)
+{
+	// Pursuers chase a target doing a random walk on a big pillared map. Nobody blocks anybody, we only care what the searching costs.
+	// "fresh" is what MobManager used to do every turn (without the leak), "planner" goes through the cache, and "field" is one
+	// distance field update per turn with everyone stepping downhill.
+
+	typedef std::chrono::high_resolution_clock clock;
+
+	const int size = 200;
+	const int turns = 50;
+	MapManager* mm = gGame->mMapManager;
+	int mapID = mm->buildEmptyMap(size, size, mapType);
+	Map* m = mm->getMap(mapID);
+
+	for (int y = 4; y < size; y += 8)
+	{
+		for (int x = 4; x < size; x += 8)
+		{
+			m->setProperties(x, y, false, false);
+			m->setProperties(x + 1, y, false, false);
+		}
+	}
+
+	std::vector<int> startX(pursuerCount), startY(pursuerCount);
+	for (int i = 0; i < pursuerCount; i++)
+	{
+		do
+		{
+			startX[i] = gGame->randomiser->getInt(0, size - 1);
+			startY[i] = gGame->randomiser->getInt(0, size - 1);
+		} while (!m->map->isWalkable(startX[i], startY[i]));
+	}
+
+	std::vector<int> targetX(turns), targetY(turns);
+	int tx = size / 2, ty = size / 2;
+	for (int t = 0; t < turns; t++)
+	{
+		int nx = tx + gGame->randomiser->getInt(-1, 1);
+		int ny = ty + gGame->randomiser->getInt(-1, 1);
+		if (!mm->isOutOfBounds(mapID, nx, ny) && m->map->isWalkable(nx, ny))
+		{
+			tx = nx;
+			ty = ny;
+		}
+		targetX[t] = tx;
+		targetY[t] = ty;
+	}
+
+	// fresh search every turn
+	std::vector<int> px = startX, py = startY;
+	clock::time_point start = clock::now();
+	for (int t = 0; t < turns; t++)
+	{
+		for (int i = 0; i < pursuerCount; i++)
+		{
+			TCODPath* path = new TCODPath(m->width, m->height, mm, (void*)&mapID, 1.0f);
+			path->compute(px[i], py[i], targetX[t], targetY[t]);
+			int nx, ny;
+			if (!path->isEmpty() && path->walk(&nx, &ny, true))
+			{
+				px[i] = nx;
+				py[i] = ny;
+			}
+			delete path;
+		}
+	}
+	double freshCost = std::chrono::duration<double, std::milli>(clock::now() - start).count() / turns;
+
+	// through the planner
+	PathPlanner planner(mm);
+	px = startX;
+	py = startY;
+	start = clock::now();
+	for (int t = 0; t < turns; t++)
+	{
+		for (int i = 0; i < pursuerCount; i++)
+		{
+			int nx, ny;
+			if (planner.NextStep(MANAGER_MOB, i, mapID, px[i], py[i], targetX[t], targetY[t], nx, ny) == PATH_STEP)
+			{
+				px[i] = nx;
+				py[i] = ny;
+			}
+		}
+	}
+	double plannerCost = std::chrono::duration<double, std::milli>(clock::now() - start).count() / turns;
+
+	// down a shared field
+	DistanceField field;
+	std::vector<int> sources;
+	px = startX;
+	py = startY;
+	start = clock::now();
+	for (int t = 0; t < turns; t++)
+	{
+		sources.assign(1, targetY[t] * size + targetX[t]);
+		field.Update(mapID, m, sources);
+		for (int i = 0; i < pursuerCount; i++)
+		{
+			int nx, ny;
+			if (field.Descend(m, px[i], py[i], nx, ny))
+			{
+				px[i] = nx;
+				py[i] = ny;
+			}
+		}
+	}
+	double fieldCost = std::chrono::duration<double, std::milli>(clock::now() - start).count() / turns;
+
+	ReportLine(MapManager::LogCategory, "%d pursuers, %d turns on %dx%d %s: fresh %.2fms/turn (%d searches), planner %.2fms/turn (%d searches), field %.2fms/turn (%d updates)",
+		pursuerCount, turns, size, size, m->outdoor ? "hex" : "ortho", freshCost, pursuerCount * turns, plannerCost, planner.GetSearchCount(), fieldCost, field.GetRebuildCount());
+}
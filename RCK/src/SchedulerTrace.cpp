@@ -0,0 +1,262 @@
+#include "SchedulerTrace.h"
+
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// in ManagerType order (see Game.h)
+static const char* traceManagerNames[] = { "Character", "Mob", "Map", "Item", "Condition", "Mortal", "Party", "Base" };
+static const char* traceEventNames[] = { "SCHEDULE", "FIRE", "FIRE_END", "INTERRUPT", "DEREGISTER", "CLEAR", "ADVANCE" };
+
+static uint64_t TraceNow()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string TraceManagerName(int manager)
+{
+	if (manager == -1)
+		return "Game";
+	if (manager >= 0 && manager < (int)(sizeof(traceManagerNames) / sizeof(traceManagerNames[0])))
+		return traceManagerNames[manager];
+	return "Manager" + std::to_string(manager);
+}
+
+SchedulerTrace::SchedulerTrace() : header(NULL), records(NULL), mappedView(NULL), mappedSize(0), startNanos(0)
+{
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+SchedulerTrace::~SchedulerTrace()
+{
+	Close();
+}
+
+bool SchedulerTrace::Open(std::string filename, int capacity)
+{
+	Close();
+
+	if (capacity <= 0)
+		return false;
+
+	mappedSize = sizeof(TraceFileHeader) + sizeof(TraceRecord) * (size_t)capacity;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	size.QuadPart = (LONGLONG)mappedSize;
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, size.HighPart, size.LowPart, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, mappedSize);
+	if (view == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+#else
+	int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, (off_t)mappedSize) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	fileDescriptor = fd;
+#endif
+
+	mappedView = view;
+	header = (TraceFileHeader*)view;
+	records = (TraceRecord*)((char*)view + sizeof(TraceFileHeader));
+
+	memcpy(header->magic, "RCKTRACE", 8);
+	header->version = TRACE_VERSION;
+	header->recordSize = sizeof(TraceRecord);
+	header->capacity = (uint64_t)capacity;
+	header->nextIndex = 0;
+
+	startNanos = TraceNow();
+
+	return true;
+}
+
+void SchedulerTrace::Close()
+{
+	if (mappedView == NULL)
+		return;
+
+#ifdef _WIN32
+	FlushViewOfFile(mappedView, mappedSize);
+	UnmapViewOfFile(mappedView);
+	CloseHandle((HANDLE)mappingHandle);
+	CloseHandle((HANDLE)fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	msync(mappedView, mappedSize, MS_ASYNC);
+	munmap(mappedView, mappedSize);
+	close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+
+	mappedView = NULL;
+	mappedSize = 0;
+	header = NULL;
+	records = NULL;
+}
+
+void SchedulerTrace::Record(TraceEventType type, int manager, int entity, long double gameTime, long double eventTime)
+{
+	// the scheduler only runs on the game thread, so there's no need for anything cleverer than bumping the index
+	if (header == NULL)
+		return;
+
+	uint64_t index = header->nextIndex++;
+	TraceRecord& r = records[index % header->capacity];
+
+	r.index = index;
+	r.wallNanos = TraceNow() - startNanos;
+	r.gameTime = (double)gameTime;
+	r.eventTime = (double)eventTime;
+	r.entity = entity;
+	r.manager = (int16_t)manager;
+	r.type = (uint8_t)type;
+	r.reserved = 0;
+}
+
+bool SchedulerTrace::ConvertTrace(std::string inputFilename, std::string outputFilename, bool chrome)
+{
+	std::ifstream in(inputFilename, std::ios::in | std::ios::binary);
+	if (!in.is_open())
+	{
+		printf("Couldn't open trace %s\n", inputFilename.c_str());
+		return false;
+	}
+
+	TraceFileHeader h;
+	if (!in.read((char*)&h, sizeof(h)) || memcmp(h.magic, "RCKTRACE", 8) != 0)
+	{
+		printf("%s is not a scheduler trace\n", inputFilename.c_str());
+		return false;
+	}
+	if (h.version != TRACE_VERSION || h.recordSize != sizeof(TraceRecord))
+	{
+		printf("%s is trace version %u (record size %u), expected version %u (record size %u)\n", inputFilename.c_str(),
+			h.version, h.recordSize, TRACE_VERSION, (uint32_t)sizeof(TraceRecord));
+		return false;
+	}
+
+	std::vector<TraceRecord> ring((size_t)h.capacity);
+	in.read((char*)ring.data(), sizeof(TraceRecord) * ring.size());
+
+	std::ofstream out(outputFilename, std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+	{
+		printf("Couldn't write %s\n", outputFilename.c_str());
+		return false;
+	}
+
+	// once the ring has wrapped, the oldest surviving record is the one we'd overwrite next
+	uint64_t first = h.nextIndex > h.capacity ? h.nextIndex - h.capacity : 0;
+
+	char line[512];
+	if (chrome)
+	{
+		out << "{\"traceEvents\":[\n";
+	}
+	else
+	{
+		snprintf(line, sizeof(line), "# %llu records (%llu dropped to wrap-around)\n# index wall_us game_time event manager entity event_time\n",
+			(unsigned long long)(h.nextIndex - first), (unsigned long long)first);
+		out << line;
+	}
+
+	bool firstEvent = true;
+	for (uint64_t i = first; i < h.nextIndex; i++)
+	{
+		const TraceRecord& r = ring[(size_t)(i % h.capacity)];
+		if (r.index != i)
+			continue; // torn record - the game died mid-write
+
+		const char* eventName = r.type < TRACE_MAX ? traceEventNames[r.type] : "UNKNOWN";
+		std::string managerName = TraceManagerName(r.manager);
+		double wallMicros = r.wallNanos / 1000.0;
+
+		if (!chrome)
+		{
+			snprintf(line, sizeof(line), "%llu %.3f %.4f %s %s %d %.4f\n", (unsigned long long)r.index, wallMicros, r.gameTime, eventName,
+				managerName.c_str(), r.entity, r.eventTime);
+			out << line;
+			continue;
+		}
+
+		// turns become duration slices (one track per manager), the clock becomes a counter and everything else is an instant event
+		switch (r.type)
+		{
+		case TRACE_FIRE:
+		case TRACE_FIRE_END:
+			snprintf(line, sizeof(line), "{\"name\":\"%s #%d\",\"cat\":\"turn\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"gameTime\":%.4f,\"eventTime\":%.4f}}",
+				managerName.c_str(), r.entity, r.type == TRACE_FIRE ? "B" : "E", wallMicros, (int)r.manager, r.gameTime, r.eventTime);
+			break;
+		case TRACE_ADVANCE:
+			snprintf(line, sizeof(line), "{\"name\":\"masterTime\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"seconds\":%.4f}}",
+				wallMicros, r.eventTime);
+			break;
+		default:
+			snprintf(line, sizeof(line), "{\"name\":\"%s %s #%d\",\"cat\":\"scheduler\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"gameTime\":%.4f,\"eventTime\":%.4f}}",
+				eventName, managerName.c_str(), r.entity, wallMicros, (int)r.manager, r.gameTime, r.eventTime);
+			break;
+		}
+
+		if (!firstEvent)
+			out << ",\n";
+		out << line;
+		firstEvent = false;
+	}
+
+	if (chrome)
+	{
+		out << "\n]}\n";
+	}
+
+	printf("Wrote %llu records to %s\n", (unsigned long long)(h.nextIndex - first), outputFilename.c_str());
+	return true;
+}
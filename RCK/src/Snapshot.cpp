@@ -0,0 +1,83 @@
+#include "Snapshot.h"
+
+#include <cstdio>
+#include "vendor/zlib/zlib.h"
+
+static const char snapshotMagic[8] = { 'R','C','K','S','N','A','P','\0' };
+
+bool SnapshotWriter::SaveToFile(std::string filename, bool compress)
+{
+	SnapshotFileHeader header;
+	memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.flags = 0;
+	header.rawSize = buffer.size();
+	header.storedSize = buffer.size();
+
+	const char* payload = buffer.data();
+	std::vector<char> packed;
+	if (compress)
+	{
+		// level 1: most of the win on columns full of small ints, for a fraction of the time of the default level
+		uLongf packedSize = compressBound((uLong)buffer.size());
+		packed.resize(packedSize);
+		if (compress2((Bytef*)packed.data(), &packedSize, (const Bytef*)buffer.data(), (uLong)buffer.size(), 1) != Z_OK)
+			return false;
+
+		header.flags |= SNAPSHOT_COMPRESSED;
+		header.storedSize = packedSize;
+		payload = packed.data();
+	}
+
+	FILE* f = fopen(filename.c_str(), "wb");
+	if (f == NULL)
+		return false;
+
+	bool written = fwrite(&header, sizeof(header), 1, f) == 1
+		&& (header.storedSize == 0 || fwrite(payload, (size_t)header.storedSize, 1, f) == 1);
+	return fclose(f) == 0 && written;
+}
+
+bool SnapshotReader::LoadFromFile(std::string filename)
+{
+	buffer.clear();
+	position = 0;
+	ok = false;
+
+	FILE* f = fopen(filename.c_str(), "rb");
+	if (f == NULL)
+		return false;
+
+	SnapshotFileHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, snapshotMagic, sizeof(header.magic)) != 0
+		|| header.version != SnapshotWriter::SNAPSHOT_VERSION)
+	{
+		fclose(f);
+		return false;
+	}
+
+	// one read for the whole payload
+	std::vector<char> stored((size_t)header.storedSize);
+	bool read = header.storedSize == 0 || fread(stored.data(), (size_t)header.storedSize, 1, f) == 1;
+	fclose(f);
+	if (!read)
+		return false;
+
+	if (header.flags & SNAPSHOT_COMPRESSED)
+	{
+		buffer.resize((size_t)header.rawSize);
+		uLongf rawSize = (uLongf)header.rawSize;
+		if (uncompress((Bytef*)buffer.data(), &rawSize, (const Bytef*)stored.data(), (uLong)stored.size()) != Z_OK || rawSize != header.rawSize)
+		{
+			buffer.clear();
+			return false;
+		}
+	}
+	else
+	{
+		buffer.swap(stored);
+	}
+
+	ok = true;
+	return true;
+}
@@ -0,0 +1,47 @@
+#include "Symbols.h"
+
+SymbolTable& Symbols()
+{
+	// function static, so it exists before the TAG_ constants below are initialised whatever order the files start up in
+	static SymbolTable table;
+	return table;
+}
+
+const SymbolID TAG_ATTACK_MELEE = Symbols().Intern("Attack:Melee");
+const SymbolID TAG_ATTACK_MISSILE = Symbols().Intern("Attack:Missile");
+const SymbolID TAG_DAMAGE_MELEE = Symbols().Intern("Damage:Melee");
+const SymbolID TAG_DAMAGE_MISSILE = Symbols().Intern("Damage:Missile");
+const SymbolID TAG_DEFENCE_AC = Symbols().Intern("Defence:AC");
+const SymbolID TAG_HEALING_MORTAL_WOUND_BONUS = Symbols().Intern("Healing:MortalWound:Bonus");
+
+SymbolID SymbolTable::Intern(const std::string& name)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = ids.find(name);
+	if (it != ids.end())
+		return it->second;
+
+	SymbolID id = (SymbolID)names.size();
+	names.push_back(name);
+	ids[name] = id;
+	return id;
+}
+
+SymbolID SymbolTable::Find(const std::string& name) const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = ids.find(name);
+	return it != ids.end() ? it->second : SYMBOL_NONE;
+}
+
+std::string SymbolTable::GetName(SymbolID id) const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return id >= 0 && id < (SymbolID)names.size() ? names[id] : std::string();
+}
+
+int SymbolTable::Count() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return (int)names.size();
+}
@@ -0,0 +1,112 @@
+#include "Visibility.h"
+#include <algorithm>
+
+VisibilityService::~VisibilityService()
+{
+	for (ScratchMap& s : scratch)
+	{
+		delete s.map;
+	}
+}
+
+TCODMap* VisibilityService::GetScratchMap(int mapID)
+{
+	if (mapID >= (int)scratch.size())
+	{
+		scratch.resize(mapID + 1);
+	}
+
+	Map* m = mapManager->getMap(mapID);
+	ScratchMap& s = scratch[mapID];
+	if (s.map == NULL)
+	{
+		s.map = new TCODMap(m->width, m->height);
+		s.map->copy(m->map);
+		s.version = m->version;
+	}
+	else if (s.version != m->version)
+	{
+		s.map->copy(m->map);
+		s.version = m->version;
+	}
+
+	return s.map;
+}
+
+bool VisibilityService::CanSee(int manager, int entityID, int mapID, int x, int y, int tx, int ty, int range)
+{
+	Map* m = mapManager->getMap(mapID);
+	if (tx < 0 || ty < 0 || tx >= m->width || ty >= m->height)
+		return false;
+
+	ObserverFOV& o = observers[PackOccupant(manager, entityID)];
+	if (o.mapID != mapID || o.mapVersion != m->version || o.x != x || o.y != y || o.range != range)
+	{
+		TCODMap* fov = GetScratchMap(mapID);
+		fov->computeFov(x, y, range, true, FOV_BASIC);
+		computes++;
+
+		o.mapID = mapID;
+		o.mapVersion = m->version;
+		o.x = x;
+		o.y = y;
+		o.range = range;
+		o.bits.assign((m->width * m->height + 63) / 64, 0);
+
+		// only the cells the FOV can actually reach need looking at
+		int minX = 0, minY = 0, maxX = m->width - 1, maxY = m->height - 1;
+		if (range > 0)
+		{
+			minX = std::max(0, x - range);
+			minY = std::max(0, y - range);
+			maxX = std::min(m->width - 1, x + range);
+			maxY = std::min(m->height - 1, y + range);
+		}
+		for (int cy = minY; cy <= maxY; cy++)
+		{
+			for (int cx = minX; cx <= maxX; cx++)
+			{
+				if (fov->isInFov(cx, cy))
+				{
+					int cell = cy * m->width + cx;
+					o.bits[cell >> 6] |= (uint64_t)1 << (cell & 63);
+				}
+			}
+		}
+	}
+
+	int cell = ty * m->width + tx;
+	return (o.bits[cell >> 6] >> (cell & 63)) & 1;
+}
+
+bool VisibilityService::HasLineOfSight(int mapID, int x0, int y0, int x1, int y1, int range)
+{
+	Map* m = mapManager->getMap(mapID);
+	if (x1 < 0 || y1 < 0 || x1 >= m->width || y1 >= m->height)
+		return false;
+
+	// same circular range as FOV_BASIC
+	if (range > 0 && (x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0) > range * range)
+		return false;
+
+	TCOD_bresenham_data_t line;
+	TCOD_line_init_mt(x0, y0, x1, y1, &line);
+
+	int x, y;
+	while (!TCOD_line_step_mt(&x, &y, &line))
+	{
+		// we can see the wall that blocks us, just not past it
+		if (x == x1 && y == y1)
+			return true;
+
+		if (!m->map->isTransparent(x, y))
+			return false;
+	}
+
+	return true;
+}
+
+void VisibilityService::Forget(int manager, int entityID)
+{
+	observers.erase(PackOccupant(manager, entityID));
+}
@@ -23,6 +23,11 @@
 #include "Class.h"
 #include "Game.h"
 #include "OutputLog.h"
+#include "Pathing.h"
+#include "Headless.h"
+#include "Journal.h"
+#include "DataPack.h"
+#include <time.h>
 
 // sample screen position
 
@@ -299,6 +304,52 @@ void render_bsp(bool first, TCOD_key_t*key, TCOD_mouse_t *mouse) {
 }
 */
 
+// log filtering from the command line, applied whenever a mode opens the log
+static LogLevel logLevel = LOG_LEVEL_TRACE;
+static std::vector<std::pair<std::string, LogLevel>> logCategoryLevels;
+
+static void OpenLog() {
+	gLog = new OutputLog();
+	gLog->SetLevel(logLevel);
+	for (const std::pair<std::string, LogLevel>& c : logCategoryLevels) {
+		gLog->SetCategoryLevel(c.first, c.second);
+	}
+}
+
+// the -benchmark-* modes. Each opens the log, loads the managers if it says so (but never a window), runs and exits.
+struct BenchmarkMode {
+	const char* flag;
+	const char* help;
+	bool needsManagers;
+	void (*run)();
+};
+
+static const BenchmarkMode benchmarks[] = {
+	{ "-benchmark-scheduler", "time the turn scheduler at 10k and 100k entities", false,
+		[]() { TimeManager::BenchmarkScheduler(10000); TimeManager::BenchmarkScheduler(100000); } },
+	{ "-benchmark-occupancy", "spawn 10k goblins on a large map and time occupancy lookups", true,
+		[]() { MapManager::BenchmarkOccupancy(10000); } },
+	{ "-benchmark-pathing", "time 200 pursuers chasing a target on square and hex maps with fresh searches, the path planner and a distance field", true,
+		[]() { PathPlanner::BenchmarkPathing(200, MAP_DUNGEON); PathPlanner::BenchmarkPathing(200, MAP_WILDERNESS); } },
+	{ "-benchmark-startup", "time loading the scripts from text and from the data pack", false,
+		[]() { DataPack::BenchmarkStartup(10); } },
+	{ "-benchmark-snapshot", "save and load a world of 100k monsters, raw and compressed", true,
+		[]() { gGame->BenchmarkSnapshot(100000); } },
+	{ "-benchmark-creatures", "spawn 100k goblins and report the memory they use", true,
+		[]() { MobManager::BenchmarkCreatureMemory(100000); } },
+	{ "-benchmark-mob-turns", "time the monster decide phase for 2k and 20k goblins over two maps on one thread and on the job system", true,
+		[]() { MobManager::BenchmarkMobTurns(2000); MobManager::BenchmarkMobTurns(20000); } },
+	{ "-benchmark-map-detail", "time an hour of 2k goblins wandering eight maps, all at full detail and then with all but the party's abstracted", true,
+		[]() { MobManager::BenchmarkMapDetail(2000); } },
+};
+
+static const BenchmarkMode* FindBenchmark(const char* flag) {
+	for (const BenchmarkMode& b : benchmarks) {
+		if ( strcmp(flag, b.flag) == 0 ) return &b;
+	}
+	return NULL;
+}
+
 // ***************************
 // the main function
 // ***************************
@@ -319,6 +370,20 @@ int main( int argc, char *argv[] ) {
 	TCOD_renderer_t renderer=TCOD_RENDERER_SDL2;
 	//TCOD_renderer_t renderer = TCOD_RENDERER_OPENGL;
 	bool fullscreen=false;
+	const char* schedulerTraceFile = NULL;
+	bool headless = false;
+	const char* encounterFile = NULL;
+	int headlessTurns = 1000;
+	int headlessPlayer = HP_HUNT;
+	std::string headlessScript;
+	uint32_t seed = (uint32_t)time(NULL);
+	const char* recordFile = NULL;
+	const char* replayFile = NULL;
+	int checkpointInterval = 50;
+	const char* loadSnapshotFile = NULL;
+	const char* saveSnapshotFile = NULL;
+	const BenchmarkMode* benchmark = NULL;
+	const char* compileDataFile = NULL;
 	int fontFlags=TCOD_FONT_TYPE_GREYSCALE|TCOD_FONT_LAYOUT_TCOD, fontNewFlags=0;
 	
 	// initialize the root console (open the game window)
@@ -352,6 +417,77 @@ int main( int argc, char *argv[] ) {
 		} else if ( strcmp(argv[argn],"-font-tcod") == 0 ) {
 			fontNewFlags |= TCOD_FONT_LAYOUT_TCOD;
 			fontFlags=0;
+		} else if ( FindBenchmark(argv[argn]) != NULL ) {
+			benchmark = FindBenchmark(argv[argn]);
+		} else if ( strcmp(argv[argn],"-compile-data") == 0 ) {
+			compileDataFile = DataPack::DEFAULT_PACK;
+			if ( argn+1 < argc && argv[argn+1][0] != '-' ) {
+				argn++;
+				compileDataFile = argv[argn];
+			}
+		} else if ( strcmp(argv[argn],"-log-level") == 0 && argn+1 < argc ) {
+			argn++;
+			if ( !OutputLog::ParseLevel(argv[argn], logLevel) ) {
+				printf ("unknown log level %s\n", argv[argn]);
+			}
+		} else if ( strcmp(argv[argn],"-log-category") == 0 && argn+2 < argc ) {
+			LogLevel level;
+			if ( OutputLog::ParseLevel(argv[argn+2], level) ) {
+				logCategoryLevels.push_back(std::make_pair(std::string(argv[argn+1]), level));
+			} else {
+				printf ("unknown log level %s\n", argv[argn+2]);
+			}
+			argn += 2;
+		} else if ( strcmp(argv[argn],"-loader-threads") == 0 && argn+1 < argc ) {
+			argn++;
+			gGame->SetLoaderThreads(atoi(argv[argn]));
+		} else if ( strcmp(argv[argn],"-worker-threads") == 0 && argn+1 < argc ) {
+			argn++;
+			gGame->SetWorkerThreads(atoi(argv[argn]));
+		} else if ( strcmp(argv[argn],"-headless") == 0 ) {
+			headless=true;
+		} else if ( strcmp(argv[argn],"-encounter") == 0 && argn+1 < argc ) {
+			argn++;
+			encounterFile=argv[argn];
+		} else if ( strcmp(argv[argn],"-turns") == 0 && argn+1 < argc ) {
+			argn++;
+			headlessTurns=atoi(argv[argn]);
+		} else if ( strcmp(argv[argn],"-player") == 0 && argn+1 < argc ) {
+			argn++;
+			if ( strcmp(argv[argn],"idle") == 0 ) {
+				headlessPlayer=HP_IDLE;
+			} else if ( strcmp(argv[argn],"hunt") == 0 ) {
+				headlessPlayer=HP_HUNT;
+			} else {
+				// anything else is a move script
+				headlessPlayer=HP_SCRIPT;
+				headlessScript=argv[argn];
+			}
+		} else if ( strcmp(argv[argn],"-seed") == 0 && argn+1 < argc ) {
+			argn++;
+			seed=(uint32_t)strtoul(argv[argn],NULL,10);
+		} else if ( strcmp(argv[argn],"-record") == 0 && argn+1 < argc ) {
+			argn++;
+			recordFile=argv[argn];
+		} else if ( strcmp(argv[argn],"-checkpoint-every") == 0 && argn+1 < argc ) {
+			argn++;
+			checkpointInterval=atoi(argv[argn]);
+		} else if ( strcmp(argv[argn],"-replay") == 0 && argn+1 < argc ) {
+			argn++;
+			replayFile=argv[argn];
+		} else if ( strcmp(argv[argn],"-load-snapshot") == 0 && argn+1 < argc ) {
+			argn++;
+			loadSnapshotFile=argv[argn];
+		} else if ( strcmp(argv[argn],"-save-snapshot") == 0 && argn+1 < argc ) {
+			argn++;
+			saveSnapshotFile=argv[argn];
+		} else if ( strcmp(argv[argn],"-trace-scheduler") == 0 && argn+1 < argc ) {
+			argn++;
+			schedulerTraceFile=argv[argn];
+		} else if ( strcmp(argv[argn],"-convert-trace") == 0 && argn+2 < argc ) {
+			// offline: turn a scheduler trace into text (or Chrome trace JSON with a trailing "chrome") and quit
+			bool chrome = argn+3 < argc && strcmp(argv[argn+3],"chrome") == 0;
+			exit(SchedulerTrace::ConvertTrace(argv[argn+1], argv[argn+2], chrome) ? 0 : 1);
 		} else if ( strcmp(argv[argn],"-help") == 0 || strcmp(argv[argn],"-?") == 0) {
 			printf ("options :\n");
 			printf ("-font <filename> : use a custom font\n");
@@ -362,12 +498,105 @@ int main( int argc, char *argv[] ) {
 			printf ("-fullscreen : start in fullscreen\n");
 			printf ("-fullscreen-resolution <screen_width> <screen_height> : force fullscreen resolution\n");
 			printf ("-renderer <num> : set renderer. 0 : GLSL 1 : OPENGL 2 : SDL\n");
+			printf ("-trace-scheduler <filename> : record a binary trace of the turn scheduler\n");
+			printf ("-convert-trace <trace> <output> [text|chrome] : convert a scheduler trace to text or Chrome trace JSON, then exit\n");
+			printf ("-headless : run without a window at full speed, print a summary and exit\n");
+			printf ("-encounter <filename> : headless scenario from a JSON file instead of the test game\n");
+			printf ("-turns <n> : number of player turns to run headless (default 1000)\n");
+			printf ("-player <hunt|idle|moves> : headless player attacks the nearest hostile, waits, or repeats a move script (0-7 = direction, . = wait)\n");
+			printf ("-seed <n> : seed the random number generator (default is the clock)\n");
+			printf ("-record <filename> : record the seed and every key press to a session journal\n");
+			printf ("-checkpoint-every <n> : write a state hash to the journal every n keys (default 50)\n");
+			printf ("-replay <filename> : replay a session journal without a window, check its state hashes and exit\n");
+			printf ("-load-snapshot <filename> : headless run starts from a saved snapshot instead of the test game\n");
+			printf ("-save-snapshot <filename> : save a snapshot at the end of a headless run\n");
+			printf ("-log-level <trace|debug|info|warning|error|none> : skip log messages below this level (default trace)\n");
+			printf ("-log-category <category> <level> : a different level for one category, eg MobManager or \"Party Manager\"\n");
+			printf ("-loader-threads <n> : threads to load the game data on (default one per core, 1 loads it all on the main thread)\n");
+			printf ("-worker-threads <n> : threads for the in-game job system (default one per core, 1 runs every job inline on the main thread)\n");
+			printf ("-compile-data [filename] : check the scripts and compile them into a data pack (default RCK/scripts/data.pack), then exit\n");
+			for (const BenchmarkMode& b : benchmarks) {
+				printf ("%s : %s, then exit\n", b.flag, b.help);
+			}
 			exit(0);
 		} else {
 			// ignore parameter
 		}
 	}
 
+	if ( benchmark != NULL ) {
+		// no window, and everything it prints also goes in the log
+		OpenLog();
+		if ( benchmark->needsManagers ) {
+			gGame->StartGame();
+		}
+		benchmark->run();
+		gLog->Flush();
+		exit(0);
+	}
+
+	if ( compileDataFile != NULL ) {
+		// offline: check the scripts and build the data pack, then quit
+		OpenLog();
+		bool compiled = DataPack::Compile(compileDataFile);
+		gLog->Flush();
+		exit(compiled ? 0 : 1);
+	}
+
+	if ( replayFile != NULL ) {
+		// no window: feed a recorded session back through the key handlers
+		OpenLog();
+		OutputLog::InstallExitHandlers();
+		SessionJournal replay;
+		if ( !replay.OpenForReplay(replayFile) ) {
+			printf ("couldn't read journal %s\n", replayFile);
+			gLog->Flush();
+			exit(1);
+		}
+		gGame->SeedRandom(replay.GetSeed());
+		gGame->StartGame();
+		if ( schedulerTraceFile != NULL ) {
+			gGame->mTimeManager->EnableTrace(schedulerTraceFile);
+		}
+		bool matched = gGame->ReplayJournal(&replay);
+		gLog->Flush();
+		exit(matched ? 0 : 1);
+	}
+
+	gGame->SeedRandom(seed);
+
+	if ( headless ) {
+		// no window: build the scenario, run it flat out and report
+		OpenLog();
+		OutputLog::InstallExitHandlers();
+		gGame->StartGame();
+		if ( schedulerTraceFile != NULL ) {
+			gGame->mTimeManager->EnableTrace(schedulerTraceFile);
+		}
+		if ( loadSnapshotFile != NULL ) {
+			if ( !gGame->LoadSnapshot(loadSnapshotFile) ) {
+				printf ("couldn't load snapshot %s\n", loadSnapshotFile);
+				gLog->Flush();
+				exit(1);
+			}
+		} else if ( encounterFile != NULL ) {
+			if ( !gGame->CreateEncounter(encounterFile) ) {
+				printf ("couldn't load encounter %s\n", encounterFile);
+				gLog->Flush();
+				exit(1);
+			}
+		} else {
+			gGame->CreateTestGame();
+		}
+		HeadlessSummary summary = gGame->RunHeadless(headlessTurns, headlessPlayer, headlessScript);
+		printf ("%s\n", summary.ToString().c_str());
+		if ( saveSnapshotFile != NULL && !gGame->SaveSnapshot(saveSnapshotFile) ) {
+			printf ("couldn't save snapshot %s\n", saveSnapshotFile);
+		}
+		gLog->Flush();
+		exit(0);
+	}
+
 	if ( fontFlags == 0 ) fontFlags=fontNewFlags;
 	TCODConsole::setCustomFont(font,fontFlags,nbCharHoriz,nbCharVertic);
 	if ( fullscreenWidth > 0 ) {
@@ -375,8 +604,20 @@ int main( int argc, char *argv[] ) {
 	}
 	
 	TCODConsole::initRoot(80,50,"libtcod C++ sample",fullscreen,renderer);
-	gLog = new OutputLog();
+	OpenLog();
+	OutputLog::InstallExitHandlers();
 	gGame->StartGame();
+	if ( schedulerTraceFile != NULL ) {
+		gGame->mTimeManager->EnableTrace(schedulerTraceFile);
+	}
+	SessionJournal journal;
+	if ( recordFile != NULL ) {
+		if ( journal.OpenForRecord(recordFile, seed, checkpointInterval) ) {
+			gGame->SetJournal(&journal);
+		} else {
+			RCK_LOG_ERROR("Journal", std::string("Couldn't create journal ") + recordFile);
+		}
+	}
 	gGame->MainLoop();
 	return 0;
 }